@@ -1 +1,2 @@
+rem Apply the patches in bin\proto-patches to protobufs first, and revert them afterwards (see regen-protos.sh)
 cd protobufs && ..\nanopb-0.4.8\generator-bin\protoc.exe --experimental_allow_proto3_optional "--nanopb_out=-S.cpp -v:..\src\mesh\generated" -I=..\protobufs\ ..\protobufs\meshtastic\*.proto
@@ -8,4 +8,13 @@ echo "prebuilt binaries for your computer into nanopb-0.4.8"
 
 # the nanopb tool seems to require that the .options file be in the current directory!
 cd protobufs
+
+# Fields the firmware has which aren't in the protobufs repo yet are patched in for generation, and taken out again after
+applied=""
+trap 'for p in $applied; do patch -p1 -R -s <"$p"; done' EXIT
+for p in ../bin/proto-patches/*.patch; do
+	patch -p1 -s <"$p"
+	applied="$p $applied"
+done
+
 ../nanopb-0.4.8/generator-bin/protoc --experimental_allow_proto3_optional "--nanopb_out=-S.cpp -v:../src/mesh/generated/" -I=../protobufs meshtastic/*.proto
@@ -62,6 +62,15 @@ class AirTime : private concurrency::OSThread
     bool isTxAllowedChannelUtil(bool polite = false);
     bool isTxAllowedAirUtil();
 
+    /// The channel utilization above which we stop sending anything optional
+    uint8_t getMaxChannelUtilPercent() const { return max_channel_util_percent; }
+
+    /// The channel utilization above which we hold back traffic nobody is waiting for, like history replays
+    uint8_t getPoliteChannelUtilPercent() const { return polite_channel_util_percent; }
+
+    /// @return all the airtime of this type we have logged since boot, in msecs
+    uint64_t getTotalMsec(reportTypes reportType) const { return totalMsec[reportType]; }
+
   private:
     bool firstTime = true;
     uint8_t lastUtilPeriod = 0;
@@ -78,6 +87,8 @@ class AirTime : private concurrency::OSThread
         uint8_t lastPeriodIndex;
     } airtimes;
 
+    uint64_t totalMsec[RX_ALL_LOG + 1] = {0}; // indexed by reportTypes, never rotated
+
     uint8_t getPeriodUtilMinute();
     uint8_t getPeriodUtilHour();
     uint8_t currentPeriodIndex();
@@ -3,6 +3,10 @@
 
 #ifndef HAS_FREE_RTOS
 
+#if HAS_EPOLL_REACTOR
+#include "platform/portduino/EpollReactor.h"
+#endif
+
 namespace concurrency
 {
 
@@ -15,13 +19,26 @@ BinarySemaphorePosix::~BinarySemaphorePosix() {}
  */
 bool BinarySemaphorePosix::take(uint32_t msec)
 {
+#if HAS_EPOLL_REACTOR
+    // Sleep in the reactor, so that socket activity and give() can wake us early
+    return epollReactor.wait(msec);
+#else
     delay(msec); // FIXME
     return false;
+#endif
 }
 
-void BinarySemaphorePosix::give() {}
+void BinarySemaphorePosix::give()
+{
+#if HAS_EPOLL_REACTOR
+    epollReactor.interrupt();
+#endif
+}
 
-IRAM_ATTR void BinarySemaphorePosix::giveFromISR(BaseType_t *pxHigherPriorityTaskWoken) {}
+IRAM_ATTR void BinarySemaphorePosix::giveFromISR(BaseType_t *pxHigherPriorityTaskWoken)
+{
+    give();
+}
 
 } // namespace concurrency
 
@@ -82,7 +82,10 @@ void OSThread::run()
     auto heap = memGet.getFreeHeap();
 #endif
     currentThread = this;
+    uint32_t start = micros();
     auto newDelay = runOnce();
+    runtimeUsec += (uint32_t)(micros() - start);
+    runCount++;
 #ifdef DEBUG_HEAP
     auto newHeap = memGet.getFreeHeap();
     if (newHeap < heap)
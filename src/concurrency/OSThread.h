@@ -41,6 +41,10 @@ class OSThread : public Thread
     /// Show debugging info for threads we decide not to run;
     static bool showWaiting;
 
+    /// Time spent in runOnce() since boot, and how many times we ran it (for metrics)
+    uint64_t runtimeUsec = 0;
+    uint32_t runCount = 0;
+
   public:
     /// For debug printing only (might be null)
     static const OSThread *currentThread;
@@ -55,6 +59,9 @@ class OSThread : public Thread
 
     virtual int32_t disable();
 
+    uint64_t getRuntimeUsec() const { return runtimeUsec; }
+    uint32_t getRunCount() const { return runCount; }
+
     /**
      * Wait a specified number msecs starting from the current time (rather than the last time we were run)
      */
@@ -452,6 +452,32 @@ float GeoCoord::rangeRadiansToMeters(double range_radians)
     return distance_nm * 0.000539957;
 }
 
+/**
+ * Move a position (in 1e-7 degrees) as far as it gets in secs at speedKmph along trackE5 (in 1e-5 degrees, the units our GPS
+ * reports).  Treats the earth as flat, which is plenty for the few kilometers anyone extrapolates a position.
+ */
+void GeoCoord::deadReckon(int32_t &lat, int32_t &lon, uint32_t speedKmph, uint32_t trackE5, float secs)
+{
+    if (secs > DEAD_RECKONING_MAX_SECS)
+        secs = DEAD_RECKONING_MAX_SECS;
+    if (secs <= 0 || speedKmph == 0)
+        return;
+
+    const double metersPerDegree = 111320;
+    double meters = speedKmph / 3.6 * secs;
+    double track = toRadians(trackE5 * 1e-5);
+    double cosLat = cos(toRadians(lat * 1e-7));
+
+    double newLat = lat + meters * cos(track) / metersPerDegree * 1e7;
+    double newLon = lon + (cosLat > 0.01 ? meters * sin(track) / (metersPerDegree * cosLat) * 1e7 : 0);
+    lat = (int32_t)std::max(-900000000.0, std::min(900000000.0, newLat));
+    if (newLon > 1800000000.0)
+        newLon -= 3600000000.0;
+    else if (newLon < -1800000000.0)
+        newLon += 3600000000.0;
+    lon = (int32_t)newLon;
+}
+
 // Find distance from point to passed in point
 int32_t GeoCoord::distanceTo(const GeoCoord &pointB)
 {
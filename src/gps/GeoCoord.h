@@ -13,6 +13,9 @@
 #define OLC_CODE_LEN 11
 #define DEG_CONVERT (180 / PI)
 
+// Nobody extrapolates a position further ahead than this, whatever the sender promised
+#define DEAD_RECKONING_MAX_SECS (15 * 60)
+
 // Helper functions
 // Raises a number to an exponent, handling negative exponents.
 static inline double pow_neg(double base, double exponent)
@@ -117,6 +120,7 @@ class GeoCoord
     static float bearing(double lat1, double lon1, double lat2, double lon2);
     static float rangeRadiansToMeters(double range_radians);
     static float rangeMetersToRadians(double range_meters);
+    static void deadReckon(int32_t &lat, int32_t &lon, uint32_t speedKmph, uint32_t trackE5, float secs);
 
     // Point to point conversions
     int32_t distanceTo(const GeoCoord &pointB);
@@ -1524,7 +1524,8 @@ static void drawNodeInfo(OLEDDisplay *display, OLEDDisplayUiState *state, int16_
         if (hasValidPosition(node)) {
             // display direction toward node
             hasNodeHeading = true;
-            const meshtastic_PositionLite &p = node->position;
+            // Where it should be by now, if it is moving and told us how
+            const meshtastic_PositionLite p = nodeDB->getEstimatedPosition(node);
             float d =
                 GeoCoord::latLongToMeter(DegD(p.latitude_i), DegD(p.longitude_i), DegD(op.latitude_i), DegD(op.longitude_i));
 
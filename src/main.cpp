@@ -4,6 +4,7 @@
 #endif
 #include "MeshRadio.h"
 #include "MeshService.h"
+#include "MeshTopology.h"
 #include "NodeDB.h"
 #include "PowerFSM.h"
 #include "ReliableRouter.h"
@@ -83,6 +84,7 @@ NRF52Bluetooth *nrf52Bluetooth;
 #include "linux/LinuxHardwareI2C.h"
 #include "mesh/raspihttp/PiWebServer.h"
 #include "platform/portduino/PortduinoGlue.h"
+#include "platform/portduino/UnixSocketAPI.h"
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -566,10 +568,11 @@ void setup()
     // We do this as early as possible because this loads preferences from flash
     // but we need to do this after main cpu init (esp32setup), because we need the random seed set
     nodeDB = new NodeDB;
+    meshTopology = new MeshTopology();
 
     // If we're taking on the repeater role, use flood router and turn off 3V3_S rail because peripherals are not needed
     if (config.device.role == meshtastic_Config_DeviceConfig_Role_REPEATER) {
-        router = new FloodingRouter();
+        router = new NextHopRouter();
 #ifdef PIN_3V3_EN
         digitalWrite(PIN_3V3_EN, LOW);
 #endif
@@ -934,6 +937,9 @@ void setup()
     }
 #endif
     initApiServer(TCPPort);
+#if HAS_UNIX_SOCKET_API
+    initLocalApi();
+#endif
 #endif
 
     // Start airtime logger thread.
@@ -188,10 +188,13 @@ void Channels::initDefaults()
     for (int i = 0; i < channelFile.channels_count; i++)
         fixupChannel(i);
     initDefaultChannel(0);
+    generation++;
 }
 
 void Channels::onConfigChanged()
 {
+    generation++;
+
     // Make sure the phone hasn't mucked anything up
     for (int i = 0; i < channelFile.channels_count; i++) {
         const meshtastic_Channel &ch = fixupChannel(i);
@@ -247,6 +250,7 @@ void Channels::setChannel(const meshtastic_Channel &c)
                 channelFile.channels[i].role = meshtastic_Channel_Role_SECONDARY;
 
     old = c; // slam in the new settings/role
+    generation++;
 }
 
 bool Channels::anyMqttEnabled()
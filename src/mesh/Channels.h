@@ -28,6 +28,9 @@ class Channels
     /// the precomputed hashes for each of our channels, or -1 for invalid
     int16_t hashes[MAX_NUM_CHANNELS] = {};
 
+    /// Bumped whenever the channel table changes, so anything derived from it can tell when to recompute
+    uint32_t generation = 0;
+
   public:
     Channels() {}
 
@@ -61,6 +64,8 @@ class Channels
 
     ChannelIndex getNumChannels() { return channelFile.channels_count; }
 
+    uint32_t getGeneration() const { return generation; }
+
     /// Called by NodeDB on initial boot when the radio config settings are unset.  Set a default single channel config.
     void initDefaults();
 
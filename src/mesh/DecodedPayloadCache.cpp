@@ -0,0 +1,26 @@
+#include "DecodedPayloadCache.h"
+
+const meshtastic_MeshPacket *DecodedPayloadCache::current;
+uint8_t DecodedPayloadCache::depth;
+uint8_t DecodedPayloadCache::suspended;
+uint32_t DecodedPayloadCache::generation;
+
+void DecodedPayloadCache::begin(const meshtastic_MeshPacket *mp)
+{
+    if (depth++ == 0) {
+        current = mp;
+        generation++; // whatever is cached belongs to some earlier packet
+    } else if (mp != current) {
+        suspended++;
+    }
+}
+
+void DecodedPayloadCache::end(const meshtastic_MeshPacket *mp)
+{
+    if (mp != current)
+        suspended--;
+    if (--depth == 0) {
+        current = NULL;
+        generation++;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "mesh-pb-constants.h"
+#include <string.h>
+
+/**
+ * Decodes the protobuf payload of the packet we are currently handing around at most once per message type.
+ *
+ * Several modules often look at the same packet (all the telemetry modules, position and serial, ...), and MQTT then turns it
+ * into JSON, each of them used to run pb_decode_from_bytes on the same payload again.  While a DecodedPayloadScope is open
+ * for a packet, decode() keeps what it decoded for that packet in one static struct per message type, so there is no heap
+ * allocation and the later callers just get a pointer to it.
+ *
+ * Anything else (a packet we send to ourself while handling this one, or no open scope at all) is decoded into the
+ * caller's scratch as before, so a struct handed out for the current packet is never overwritten underneath its user.
+ *
+ * Callers must treat what they get as read only, unless they also re-encode it into the payload and call invalidate().
+ */
+class DecodedPayloadCache
+{
+    static const meshtastic_MeshPacket *current;
+    static uint8_t depth;     // how many scopes are open
+    static uint8_t suspended; // how many of those are for some other packet
+    static uint32_t generation;
+
+    friend class DecodedPayloadScope;
+    static void begin(const meshtastic_MeshPacket *mp);
+    static void end(const meshtastic_MeshPacket *mp);
+
+  public:
+    /// Forget everything decoded so far, because someone has rewritten the payload of the current packet
+    static void invalidate() { generation++; }
+
+    /**
+     * Decode the payload of mp as fields (which must describe T)
+     * @return the decoded message, from the cache or in scratch, or NULL if the payload didn't decode
+     */
+    template <class T> static T *decode(const meshtastic_MeshPacket &mp, const pb_msgdesc_t *fields, T &scratch)
+    {
+        static T cached;
+        static const pb_msgdesc_t *cachedFields;
+        static uint32_t cachedGeneration;
+        static bool cachedOk;
+
+        if (&mp != current || suspended) {
+            memset(&scratch, 0, sizeof(scratch));
+            return pb_decode_from_bytes(mp.decoded.payload.bytes, mp.decoded.payload.size, fields, &scratch) ? &scratch : NULL;
+        }
+
+        if (cachedGeneration != generation || cachedFields != fields) {
+            memset(&cached, 0, sizeof(cached));
+            cachedOk = pb_decode_from_bytes(mp.decoded.payload.bytes, mp.decoded.payload.size, fields, &cached);
+            cachedFields = fields;
+            cachedGeneration = generation;
+        }
+        return cachedOk ? &cached : NULL;
+    }
+};
+
+/**
+ * Lets DecodedPayloadCache keep what it decodes for mp until we go out of scope
+ */
+class DecodedPayloadScope
+{
+    const meshtastic_MeshPacket *mp;
+
+  public:
+    explicit DecodedPayloadScope(const meshtastic_MeshPacket &_mp) : mp(&_mp) { DecodedPayloadCache::begin(mp); }
+    ~DecodedPayloadScope() { DecodedPayloadCache::end(mp); }
+};
@@ -43,6 +43,8 @@ class FloodingRouter : public Router, protected PacketHistory
      */
     virtual ErrorCode send(meshtastic_MeshPacket *p) override;
 
+    virtual bool isDuplicate(const meshtastic_MeshPacket *p) override { return wasSeenRecently(p, false); }
+
   protected:
     /**
      * Should this incoming filter be dropped?
@@ -56,4 +58,14 @@ class FloodingRouter : public Router, protected PacketHistory
      * Look for broadcasts we need to rebroadcast
      */
     virtual void sniffReceived(const meshtastic_MeshPacket *p, const meshtastic_Routing *c) override;
+
+    /**
+     * @return false if p, which we would otherwise rebroadcast, is better left to someone else
+     */
+    virtual bool shouldRebroadcast(const meshtastic_MeshPacket *p) { return true; }
+
+    /**
+     * Send tosend, our copy of a packet we are rebroadcasting (with the hop limit already bumped down)
+     */
+    virtual void rebroadcast(meshtastic_MeshPacket *tosend) { Router::send(tosend); }
 };
\ No newline at end of file
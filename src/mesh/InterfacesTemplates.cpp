@@ -24,4 +24,10 @@ template class APIServerPort<ethServerAPI, EthernetServer>;
 #include "api/WiFiServerAPI.h"
 template class ServerAPI<WiFiClient>;
 template class APIServerPort<WiFiServerAPI, WiFiServer>;
+#endif
+
+#if HAS_UNIX_SOCKET_API
+#include "platform/portduino/UnixSocketAPI.h"
+template class ServerAPI<UnixClient>;
+template class APIServerPort<UnixServerAPI, UnixServer>;
 #endif
\ No newline at end of file
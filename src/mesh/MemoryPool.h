@@ -2,6 +2,7 @@
 
 #include <Arduino.h>
 #include <assert.h>
+#include <atomic>
 
 #include "PointerQueue.h"
 
@@ -46,9 +47,26 @@ template <class T> class Allocator
     /// Return a buffer for use by others
     virtual void release(T *p) = 0;
 
+    /// How many objects are allocated right now, and the most there have ever been at once
+    uint32_t getInUse() const { return inUse; }
+    uint32_t getMaxInUse() const { return maxInUse; }
+
   protected:
+    // Packets are allocated and released from more than one thread (and ISRs), so these are atomic
+    std::atomic<uint32_t> inUse{0}, maxInUse{0};
+
     // Alloc some storage
     virtual T *alloc(TickType_t maxWait) = 0;
+
+    /// Subclasses call these to keep getInUse() and getMaxInUse() current
+    void countAlloc()
+    {
+        uint32_t n = ++inUse;
+        uint32_t max = maxInUse;
+        while (n > max && !maxInUse.compare_exchange_weak(max, n))
+            ;
+    }
+    void countRelease() { inUse--; }
 };
 
 /**
@@ -62,6 +80,7 @@ template <class T> class MemoryDynamic : public Allocator<T>
     {
         assert(p);
         free(p);
+        this->countRelease();
     }
 
   protected:
@@ -70,6 +89,8 @@ template <class T> class MemoryDynamic : public Allocator<T>
     {
         T *p = (T *)malloc(sizeof(T));
         assert(p);
+        if (p)
+            this->countAlloc();
         return p;
     }
 };
@@ -1,5 +1,6 @@
 #include "MeshModule.h"
 #include "Channels.h"
+#include "DecodedPayloadCache.h"
 #include "MeshService.h"
 #include "NodeDB.h"
 #include "configuration.h"
@@ -8,6 +9,8 @@
 
 std::vector<MeshModule *> *MeshModule::modules;
 
+MeshModule::DispatchTable *MeshModule::dispatch;
+
 const meshtastic_MeshPacket *MeshModule::currentRequest;
 
 /**
@@ -22,6 +25,7 @@ MeshModule::MeshModule(const char *_name) : name(_name)
     if (!modules)
         modules = new std::vector<MeshModule *>();
 
+    moduleIndex = modules->size();
     modules->push_back(this);
 }
 
@@ -69,11 +73,49 @@ meshtastic_MeshPacket *MeshModule::allocErrorResponse(meshtastic_Routing_Error e
     return r;
 }
 
+void MeshModule::buildDispatchTable()
+{
+    if (!dispatch)
+        dispatch = new DispatchTable();
+    else
+        *dispatch = DispatchTable();
+
+    for (auto m : *modules) {
+        int port = m->getDispatchPortNum();
+        if (port == ANY_PORTNUM)
+            dispatch->anyPort.push_back(m);
+        else
+            dispatch->byPort[port].push_back(m);
+
+        if (m->encryptedOk)
+            dispatch->encrypted.push_back(m);
+        if (m->isPromiscuous)
+            dispatch->promiscuous.push_back(m);
+    }
+    dispatch->numModules = modules->size();
+}
+
+bool MeshModule::isBoundChannel(ChannelIndex chIndex)
+{
+    if (!boundChannelsResolved || boundChannelsGeneration != channels.getGeneration()) {
+        boundChannelMask = 0;
+        for (ChannelIndex i = 0; i < channels.getNumChannels() && i < 32; i++)
+            if (strcasecmp(channels.getByIndex(i).settings.name, boundChannel) == 0)
+                boundChannelMask |= 1UL << i;
+        boundChannelsGeneration = channels.getGeneration();
+        boundChannelsResolved = true;
+    }
+    return chIndex < 32 && (boundChannelMask & (1UL << chIndex));
+}
+
 void MeshModule::callModules(meshtastic_MeshPacket &mp, RxSource src)
 {
     // LOG_DEBUG("In call modules\n");
     bool moduleFound = false;
 
+    // Every module for this portnum gets the same decoded payload
+    DecodedPayloadScope payloadScope(mp);
+
     // We now allow **encrypted** packets to pass through the modules
     bool isDecoded = mp.which_payload_variant == meshtastic_MeshPacket_decoded_tag;
 
@@ -85,8 +127,28 @@ void MeshModule::callModules(meshtastic_MeshPacket &mp, RxSource src)
     auto ourNodeNum = nodeDB->getNodeNum();
     bool toUs = mp.to == NODENUM_BROADCAST || mp.to == ourNodeNum;
 
-    for (auto i = modules->begin(); i != modules->end(); ++i) {
-        auto &pi = **i;
+    // Modules are registered during setup, but be safe if one shows up later
+    if (!dispatch || dispatch->numModules != modules->size())
+        buildDispatchTable();
+
+    // Only the modules which could possibly want this packet: those that take encrypted packets if we couldn't decode it, the
+    // promiscuous ones if it isn't for us, otherwise the ones for its portnum plus those that want any portnum.  The last
+    // two lists are merged as we go, to keep calling modules in the order they were registered
+    static const std::vector<MeshModule *> none;
+    const std::vector<MeshModule *> *first, *second = &none;
+    if (!isDecoded) {
+        first = &dispatch->encrypted;
+    } else if (!toUs) {
+        first = &dispatch->promiscuous;
+    } else {
+        auto found = dispatch->byPort.find(mp.decoded.portnum);
+        first = found != dispatch->byPort.end() ? &found->second : &none;
+        second = &dispatch->anyPort;
+    }
+
+    for (size_t i1 = 0, i2 = 0; i1 < first->size() || i2 < second->size();) {
+        bool takeFirst = i2 >= second->size() || (i1 < first->size() && (*first)[i1]->moduleIndex < (*second)[i2]->moduleIndex);
+        auto &pi = takeFirst ? *(*first)[i1++] : *(*second)[i2++];
 
         pi.currentRequest = &mp;
 
@@ -105,16 +167,13 @@ void MeshModule::callModules(meshtastic_MeshPacket &mp, RxSource src)
 
             moduleFound = true;
 
-            /// received channel (or NULL if not decoded)
-            meshtastic_Channel *ch = isDecoded ? &channels.getByIndex(mp.channel) : NULL;
-
             /// Is the channel this packet arrived on acceptable? (security check)
             /// Note: we can't know channel names for encrypted packets, so those are NEVER sent to boundChannel modules
 
             /// Also: if a packet comes in on the local PC interface, we don't check for bound channels, because it is TRUSTED and
             /// it needs to to be able to fetch the initial admin packets without yet knowing any channels.
 
-            bool rxChannelOk = !pi.boundChannel || (mp.from == 0) || (strcasecmp(ch->settings.name, pi.boundChannel) == 0);
+            bool rxChannelOk = !pi.boundChannel || (mp.from == 0) || (isDecoded && pi.isBoundChannel(mp.channel));
 
             if (!rxChannelOk) {
                 // no one should have already replied!
@@ -2,6 +2,7 @@
 
 #include "mesh/Channels.h"
 #include "mesh/MeshTypes.h"
+#include <unordered_map>
 #include <vector>
 
 #if HAS_SCREEN
@@ -54,7 +55,35 @@ class MeshModule
 {
     static std::vector<MeshModule *> *modules;
 
+    /** Which modules callModules needs to offer a packet to, built from modules.  Each list is in registration order, which is
+     * the order modules get to see packets in
+     */
+    struct DispatchTable {
+        std::unordered_map<int, std::vector<MeshModule *>> byPort; // modules which only want one portnum
+        std::vector<MeshModule *> anyPort;                         // modules which may want any portnum
+        std::vector<MeshModule *> encrypted;                       // modules which want packets we couldn't decode
+        std::vector<MeshModule *> promiscuous;                     // modules which want packets not meant for us
+        size_t numModules = 0;                                     // modules->size() when we were built
+    };
+    static DispatchTable *dispatch;
+
+    static void buildDispatchTable();
+
+    /// Our position in modules
+    size_t moduleIndex;
+
+    /// The channels named boundChannel (bit n set for channel index n), valid while boundChannelsGeneration is current
+    uint32_t boundChannelMask = 0;
+    uint32_t boundChannelsGeneration = 0;
+    bool boundChannelsResolved = false;
+
+    /// @return true if a packet which arrived on this channel index may be handled by us
+    bool isBoundChannel(ChannelIndex chIndex);
+
   public:
+    /// Returned by getDispatchPortNum() by modules which may want packets with any portnum
+    static const int ANY_PORTNUM = -1;
+
     /** Constructor
      * name is for debugging output
      */
@@ -127,6 +156,13 @@ class MeshModule
      */
     virtual bool wantPacket(const meshtastic_MeshPacket *p) = 0;
 
+    /**
+     * @return the one portnum wantPacket() can return true for, or ANY_PORTNUM.  callModules only asks modules registered for
+     * a packet's portnum (and ANY_PORTNUM modules) whether they want it, so a module whose wantPacket() accepts more than one
+     * portnum must return ANY_PORTNUM
+     */
+    virtual int getDispatchPortNum() { return ANY_PORTNUM; }
+
     /** Called to handle a particular incoming message
 
     @return ProcessMessage::STOP if you've guaranteed you've handled this message and no other handlers should be considered for
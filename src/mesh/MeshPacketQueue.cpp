@@ -54,6 +54,7 @@ bool MeshPacketQueue::enqueue(meshtastic_MeshPacket *p)
 
     // no space - try to replace a lower priority packet in the queue
     if (queue.size() >= maxLen) {
+        dropped++; // either p or the packet it replaces
         return replaceLowerPriorityPacket(p);
     }
 
@@ -31,6 +31,12 @@ class MeshPacketQueue
     /** return total size of the Queue */
     size_t getMaxLen() { return maxLen; }
 
+    /** return number of packets in the Queue */
+    size_t numUsed() { return queue.size(); }
+
+    /** number of packets we dropped (or refused) because the queue was full */
+    uint32_t dropped = 0;
+
     meshtastic_MeshPacket *dequeue();
 
     meshtastic_MeshPacket *getFront();
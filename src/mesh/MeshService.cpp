@@ -15,6 +15,9 @@
 #include "mesh-pb-constants.h"
 #include "modules/NodeInfoModule.h"
 #include "modules/PositionModule.h"
+#if !MESHTASTIC_EXCLUDE_TRACEROUTE
+#include "modules/TraceRouteModule.h"
+#endif
 #include "power.h"
 #include <assert.h>
 #include <string>
@@ -23,6 +26,10 @@
 #include "nimble/NimbleBluetooth.h"
 #endif
 
+#if HAS_UNIX_SOCKET_API
+#include "platform/portduino/SharedPacketRing.h"
+#endif
+
 /*
 receivedPacketQueue - this is a queue of messages we've received from the mesh, which we are keeping to deliver to the phone.
 It is implemented with a FreeRTos queue (wrapped with a little RTQueue class) of pointers to MeshPacket protobufs (which were
@@ -193,6 +200,7 @@ void MeshService::handleToRadio(meshtastic_MeshPacket &p)
     }
 #endif
     p.from = 0; // We don't let phones assign nodenums to their sent messages
+    p.next_hop = p.relay_node = 0; // nor pick routes
 
     if (p.id == 0)
         p.id = generatePacketId(); // If the phone didn't supply one, then pick one
@@ -200,6 +208,12 @@ void MeshService::handleToRadio(meshtastic_MeshPacket &p)
     p.rx_time = getValidTime(RTCQualityFromNet); // Record the time the packet arrived from the phone
                                                  // (so we update our nodedb for the local node)
 
+#if !MESHTASTIC_EXCLUDE_TRACEROUTE
+    // Apps send traceroutes over and over when someone is looking into a link, a recent one answers them without any airtime
+    if (traceRouteModule && traceRouteModule->answerFromCache(p))
+        return;
+#endif
+
     // Send the packet into the mesh
 
     sendToMesh(packetPool.allocCopy(p), RX_SRC_USER);
@@ -289,15 +303,23 @@ void MeshService::sendToPhone(meshtastic_MeshPacket *p)
 {
     perhapsDecode(p);
 
+#if HAS_UNIX_SOCKET_API
+    // Local consumers get every packet, whether or not a client is draining toPhoneQueue
+    if (sharedPacketRing)
+        sharedPacketRing->publish(*p);
+#endif
+
     if (toPhoneQueue.numFree() == 0) {
         if (p->decoded.portnum == meshtastic_PortNum_TEXT_MESSAGE_APP ||
             p->decoded.portnum == meshtastic_PortNum_RANGE_TEST_APP) {
             LOG_WARN("ToPhone queue is full, discarding oldest\n");
+            toPhoneDropped++;
             meshtastic_MeshPacket *d = toPhoneQueue.dequeuePtr(0);
             if (d)
                 releaseToPool(d);
         } else {
             LOG_WARN("ToPhone queue is full, dropping packet.\n");
+            toPhoneDropped++;
             releaseToPool(p);
             return;
         }
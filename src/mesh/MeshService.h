@@ -45,6 +45,9 @@ class MeshService
     /// The current nonce for the newest packet which has been queued for the phone
     uint32_t fromNum = 0;
 
+    /// How many packets we threw away because the phone wasn't draining toPhoneQueue
+    uint32_t toPhoneDropped = 0;
+
     /// Updated in loop() to detect when fromNum changes
     uint32_t oldFromNum = 0;
 
@@ -74,6 +77,9 @@ class MeshService
     /// last few packets if needs to.
     meshtastic_MeshPacket *getForPhone() { return toPhoneQueue.dequeuePtr(0); }
 
+    int getToPhoneQueueDepth() { return toPhoneQueue.numUsed(); }
+    uint32_t getToPhoneDropped() const { return toPhoneDropped; }
+
     /// Allows the bluetooth handler to free packets after they have been sent
     void releaseToPool(meshtastic_MeshPacket *p) { packetPool.release(p); }
 
@@ -129,6 +135,9 @@ class MeshService
     /// Send an MQTT message to the phone for client proxying
     void sendMqttMessageToClientProxy(meshtastic_MqttClientProxyMessage *m);
 
+    /// @return true if the phone isn't fetching the MQTT messages we give it to proxy, and we have no room for another
+    bool isMqttProxyQueueFull() { return toPhoneMqttProxyQueue.numFree() == 0; }
+
     bool isToPhoneQueueEmpty();
 
     ErrorCode sendQueueStatusToPhone(const meshtastic_QueueStatus &qs, ErrorCode res, uint32_t mesh_packet_id);
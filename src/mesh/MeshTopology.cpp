@@ -0,0 +1,404 @@
+#include "MeshTopology.h"
+#include "NodeDB.h"
+#include "concurrency/LockGuard.h"
+#include <queue>
+
+// What a hop costs on a fresh link with a good SNR, the penalties below are on top of this
+#define TOPOLOGY_HOP_COST 16
+// What a link costs extra for every dB its SNR is below 0, up to TOPOLOGY_MAX_SNR_PENALTY
+#define TOPOLOGY_MAX_SNR_PENALTY 20
+// What a link we only know from a traceroute costs extra, as we don't know how good it is
+#define TOPOLOGY_UNKNOWN_SNR_PENALTY 8
+// What a link costs extra just before it expires, less as it is fresher
+#define TOPOLOGY_MAX_AGE_PENALTY 16
+
+MeshTopology *meshTopology;
+
+MeshTopology::MeshTopology()
+{
+    // Indexes are 16 bits, with NO_NODE kept back
+    maxNodes = MAX_NUM_NODES < NO_NODE ? MAX_NUM_NODES : NO_NODE - 1;
+    maxEdges = maxNodes * TOPOLOGY_EDGES_PER_NODE < NO_NODE ? maxNodes * TOPOLOGY_EDGES_PER_NODE : NO_NODE - 1;
+
+    nodes.assign(maxNodes, 0);
+    nodeDegree.assign(maxNodes, 0);
+    nodeLastHeard.assign(maxNodes, 0);
+    freeNodes.reserve(maxNodes);
+    nodeIndex.reserve(maxNodes);
+    edges.reserve(maxEdges);
+    edgeIndex.reserve(maxEdges);
+}
+
+static uint32_t edgeKey(uint16_t a, uint16_t b)
+{
+    return (uint32_t)a << 16 | b;
+}
+
+uint16_t MeshTopology::findNode(NodeNum n) const
+{
+    auto found = nodeIndex.find(n);
+    return found != nodeIndex.end() ? found->second : NO_NODE;
+}
+
+uint16_t MeshTopology::getOrAddNode(NodeNum n)
+{
+    uint16_t i = findNode(n);
+    if (i != NO_NODE)
+        return i;
+
+    if (freeNodes.empty() && nodeIndex.size() < maxNodes) {
+        i = nodeIndex.size();
+    } else {
+        if (freeNodes.empty()) {
+            // Every slot has a node with links, drop the one we heard of longest ago along with its links
+            uint16_t stalest = 0;
+            for (uint16_t j = 1; j < maxNodes; j++)
+                if ((int32_t)(nodeLastHeard[j] - nodeLastHeard[stalest]) < 0)
+                    stalest = j;
+            for (size_t e = 0; e < edges.size();) {
+                if (edges[e].a == stalest || edges[e].b == stalest)
+                    removeEdge(e);
+                else
+                    e++;
+            }
+        }
+        if (freeNodes.empty())
+            return NO_NODE;
+        i = freeNodes.back();
+        freeNodes.pop_back();
+    }
+
+    nodes[i] = n;
+    nodeDegree[i] = 0;
+    nodeLastHeard[i] = millis();
+    nodeIndex[n] = i;
+    return i;
+}
+
+void MeshTopology::releaseIfUnlinked(uint16_t i)
+{
+    if (nodes[i] && nodeDegree[i] == 0) {
+        nodeIndex.erase(nodes[i]);
+        nodes[i] = 0;
+        freeNodes.push_back(i);
+    }
+}
+
+size_t MeshTopology::oldestEdge() const
+{
+    size_t oldest = 0;
+    for (size_t e = 1; e < edges.size(); e++)
+        if ((int32_t)(edges[e].lastHeard - edges[oldest].lastHeard) < 0)
+            oldest = e;
+    return oldest;
+}
+
+void MeshTopology::removeEdge(size_t i)
+{
+    Edge e = edges[i];
+    edgeIndex.erase(edgeKey(e.a, e.b));
+    if (i != edges.size() - 1) {
+        edges[i] = edges.back();
+        edgeIndex[edgeKey(edges[i].a, edges[i].b)] = i;
+    }
+    edges.pop_back();
+
+    nodeDegree[e.a]--;
+    nodeDegree[e.b]--;
+    releaseIfUnlinked(e.a);
+    releaseIfUnlinked(e.b);
+    generation++;
+}
+
+void MeshTopology::expire()
+{
+    uint32_t now = millis();
+    for (size_t i = 0; i < edges.size();) {
+        if (now - edges[i].lastHeard > TOPOLOGY_EDGE_MAX_AGE_SECS * 1000UL)
+            removeEdge(i); // moves the last edge here, so look at i again
+        else
+            i++;
+    }
+}
+
+void MeshTopology::addLink(NodeNum from, NodeNum to, float snr, bool snrKnown)
+{
+    if (!from || !to || from == to || from == NODENUM_BROADCAST || to == NODENUM_BROADCAST)
+        return;
+
+    uint16_t f = findNode(from), t = findNode(to);
+    auto found = edgeIndex.end();
+    if (f != NO_NODE && t != NO_NODE)
+        found = edgeIndex.find(f < t ? edgeKey(f, t) : edgeKey(t, f));
+
+    if (found == edgeIndex.end()) {
+        if (edges.size() >= maxEdges)
+            removeEdge(oldestEdge());
+
+        f = getOrAddNode(from);
+        if (f == NO_NODE)
+            return;
+        t = getOrAddNode(to);
+        // Making room for to may have dropped from again
+        if (t == NO_NODE || nodes[f] != from) {
+            releaseIfUnlinked(f);
+            if (t != NO_NODE)
+                releaseIfUnlinked(t);
+            return;
+        }
+
+        Edge e = {f < t ? f : t, f < t ? t : f, SNR_UNKNOWN, SNR_UNKNOWN, 0};
+        found = edgeIndex.emplace(edgeKey(e.a, e.b), edges.size()).first;
+        edges.push_back(e);
+        nodeDegree[f]++;
+        nodeDegree[t]++;
+        generation++;
+    }
+
+    Edge &e = edges[found->second];
+    e.lastHeard = nodeLastHeard[f] = nodeLastHeard[t] = millis();
+    if (snrKnown) {
+        int q = (int)(snr * 4);
+        int8_t quarters = q < -127 ? -127 : q > 127 ? 127 : q;
+        // to is the one which heard from
+        if (t == e.a)
+            e.snrAtA = quarters;
+        else
+            e.snrAtB = quarters;
+    }
+}
+
+void MeshTopology::onPacketHeard(const meshtastic_MeshPacket &mp)
+{
+    // Only a packet which took no hops came straight from its sender, unless someone else sent it for them (like a traceroute
+    // answered from a cache)
+    if (mp.via_mqtt || mp.hop_start == 0 || mp.hop_start != mp.hop_limit ||
+        (mp.relay_node && mp.relay_node != (mp.from & 0xff)))
+        return;
+
+    concurrency::LockGuard guard(&lock);
+    addLink(mp.from, nodeDB->getNodeNum(), mp.rx_snr, true);
+}
+
+void MeshTopology::addNeighborInfo(const meshtastic_NeighborInfo &ni)
+{
+    concurrency::LockGuard guard(&lock);
+    for (pb_size_t i = 0; i < ni.neighbors_count; i++)
+        addLink(ni.neighbors[i].node_id, ni.node_id, ni.neighbors[i].snr, true);
+}
+
+void MeshTopology::addRoute(NodeNum origin, const meshtastic_RouteDiscovery &r, NodeNum dest)
+{
+    concurrency::LockGuard guard(&lock);
+    NodeNum prev = origin;
+    for (pb_size_t i = 0; i < r.route_count; i++) {
+        addLink(prev, r.route[i], 0, false);
+        prev = r.route[i];
+    }
+    if (dest)
+        addLink(prev, dest, 0, false);
+}
+
+void MeshTopology::clear()
+{
+    concurrency::LockGuard guard(&lock);
+    std::fill(nodes.begin(), nodes.end(), 0);
+    std::fill(nodeDegree.begin(), nodeDegree.end(), 0);
+    freeNodes.clear();
+    nodeIndex.clear();
+    edges.clear();
+    edgeIndex.clear();
+    generation++;
+}
+
+uint32_t MeshTopology::edgeCost(const Edge &e, uint32_t now) const
+{
+    uint32_t cost = TOPOLOGY_HOP_COST;
+
+    // A link is only as good as its weaker direction, as the ACK has to come back over it
+    int8_t worst = e.snrAtA == SNR_UNKNOWN ? e.snrAtB : e.snrAtB == SNR_UNKNOWN ? e.snrAtA : min(e.snrAtA, e.snrAtB);
+    if (worst == SNR_UNKNOWN)
+        cost += TOPOLOGY_UNKNOWN_SNR_PENALTY;
+    else if (worst < 0)
+        cost += min(-worst / 4, TOPOLOGY_MAX_SNR_PENALTY);
+
+    uint32_t age = now - e.lastHeard;
+    cost += (uint64_t)TOPOLOGY_MAX_AGE_PENALTY * min(age, (uint32_t)(TOPOLOGY_EDGE_MAX_AGE_SECS * 1000UL)) /
+            (TOPOLOGY_EDGE_MAX_AGE_SECS * 1000UL);
+    return cost;
+}
+
+void MeshTopology::buildAdjacency()
+{
+    if (adjGeneration == generation)
+        return;
+
+    size_t n = maxNodes;
+    adjStart.assign(n + 1, 0);
+    for (const Edge &e : edges) {
+        adjStart[e.a + 1]++;
+        adjStart[e.b + 1]++;
+    }
+    for (size_t i = 0; i < n; i++)
+        adjStart[i + 1] += adjStart[i];
+
+    adjEdge.resize(edges.size() * 2);
+    std::vector<uint32_t> fill(adjStart.begin(), adjStart.end() - 1);
+    for (size_t i = 0; i < edges.size(); i++) {
+        adjEdge[fill[edges[i].a]++] = i;
+        adjEdge[fill[edges[i].b]++] = i;
+    }
+    adjGeneration = generation;
+}
+
+void MeshTopology::computePaths(uint16_t source, Paths &paths)
+{
+    buildAdjacency();
+
+    size_t n = maxNodes;
+    paths.cost.assign(n, UINT32_MAX);
+    paths.prev.assign(n, NO_NODE);
+    paths.firstHop.assign(n, NO_NODE);
+    paths.hops.assign(n, 0);
+
+    uint32_t now = millis();
+    typedef std::pair<uint32_t, uint16_t> Entry; // cost, node
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+    paths.cost[source] = 0;
+    queue.push(Entry(0, source));
+    while (!queue.empty()) {
+        Entry top = queue.top();
+        queue.pop();
+        uint16_t u = top.second;
+        if (top.first != paths.cost[u])
+            continue; // we found a cheaper way since this was queued
+
+        for (uint32_t i = adjStart[u]; i < adjStart[u + 1]; i++) {
+            const Edge &e = edges[adjEdge[i]];
+            uint16_t v = e.a == u ? e.b : e.a;
+            uint32_t c = top.first + edgeCost(e, now);
+            if (c < paths.cost[v]) {
+                paths.cost[v] = c;
+                paths.prev[v] = u;
+                paths.firstHop[v] = u == source ? v : paths.firstHop[u];
+                paths.hops[v] = paths.hops[u] + 1;
+                queue.push(Entry(c, v));
+            }
+        }
+    }
+}
+
+const MeshTopology::Paths *MeshTopology::getOurPaths()
+{
+    // Checking every link for age on every packet would cost more than it saves
+    if (millis() - expiredAt > 1000) {
+        expire();
+        expiredAt = millis();
+    }
+
+    uint16_t us = findNode(nodeDB->getNodeNum());
+    if (us == NO_NODE)
+        return NULL;
+
+    if (us != ourPathsSource || ourPathsGeneration != generation || millis() - ourPathsAt > TOPOLOGY_RECOMPUTE_SECS * 1000UL) {
+        computePaths(us, ourPaths);
+        ourPathsSource = us;
+        ourPathsGeneration = generation;
+        ourPathsAt = millis();
+    }
+    return &ourPaths;
+}
+
+int MeshTopology::getHops(NodeNum dest)
+{
+    concurrency::LockGuard guard(&lock);
+    const Paths *paths = getOurPaths();
+    uint16_t d = findNode(dest);
+    if (!paths || d == NO_NODE || paths->cost[d] == UINT32_MAX)
+        return -1;
+    return paths->hops[d];
+}
+
+NodeNum MeshTopology::getNextHop(NodeNum dest)
+{
+    concurrency::LockGuard guard(&lock);
+    const Paths *paths = getOurPaths();
+    uint16_t d = findNode(dest);
+    if (!paths || d == NO_NODE || paths->firstHop[d] == NO_NODE)
+        return 0;
+    return nodes[paths->firstHop[d]];
+}
+
+size_t MeshTopology::findPath(NodeNum from, NodeNum to, NodeNum *path, size_t max)
+{
+    concurrency::LockGuard guard(&lock);
+    const Paths *paths;
+    if (from == nodeDB->getNodeNum()) {
+        paths = getOurPaths();
+    } else {
+        expire();
+        uint16_t f = findNode(from);
+        if (f == NO_NODE)
+            return 0;
+        computePaths(f, scratchPaths);
+        paths = &scratchPaths;
+    }
+
+    uint16_t t = findNode(to);
+    if (!paths || t == NO_NODE || paths->cost[t] == UINT32_MAX || paths->hops[t] == 0 || paths->hops[t] > max)
+        return 0;
+
+    size_t len = paths->hops[t];
+    for (uint16_t i = t, at = len; at > 0; i = paths->prev[i])
+        path[--at] = nodes[i];
+    return len;
+}
+
+void MeshTopology::writeJson(Print &out, NodeNum dest)
+{
+    NodeNum path[HOP_MAX * 2];
+    size_t pathLen = dest ? findPath(nodeDB->getNodeNum(), dest, path, sizeof(path) / sizeof(path[0])) : 0;
+
+    concurrency::LockGuard guard(&lock);
+    const Paths *paths = getOurPaths();
+    uint32_t now = millis();
+    char buf[96];
+
+    snprintf(buf, sizeof(buf), "{\"generation\":%u,\"self\":%u,\"links\":[", generation, nodeDB->getNodeNum());
+    out.print(buf);
+    // [a, b, SNR at a, SNR at b, seconds since we last heard of it], SNRs are null if we don't know them
+    for (size_t i = 0; i < edges.size(); i++) {
+        const Edge &e = edges[i];
+        char snrA[12] = "null", snrB[12] = "null";
+        if (e.snrAtA != SNR_UNKNOWN)
+            snprintf(snrA, sizeof(snrA), "%.2f", e.snrAtA / 4.0);
+        if (e.snrAtB != SNR_UNKNOWN)
+            snprintf(snrB, sizeof(snrB), "%.2f", e.snrAtB / 4.0);
+        snprintf(buf, sizeof(buf), "%s[%u,%u,%s,%s,%u]", i ? "," : "", nodes[e.a], nodes[e.b], snrA, snrB,
+                 (unsigned)((now - e.lastHeard) / 1000));
+        out.print(buf);
+    }
+
+    // [destination, next hop, hops] for every node we can reach
+    out.print("],\"routes\":[");
+    bool first = true;
+    for (size_t i = 0; paths && i < maxNodes; i++) {
+        if (!nodes[i] || paths->firstHop[i] == NO_NODE)
+            continue;
+        snprintf(buf, sizeof(buf), "%s[%u,%u,%u]", first ? "" : ",", nodes[i], nodes[paths->firstHop[i]], paths->hops[i]);
+        out.print(buf);
+        first = false;
+    }
+    out.print(']');
+
+    if (dest) {
+        out.print(",\"path\":[");
+        for (size_t i = 0; i < pathLen; i++) {
+            snprintf(buf, sizeof(buf), "%s%u", i ? "," : "", path[i]);
+            out.print(buf);
+        }
+        out.print(']');
+    }
+    out.print('}');
+}
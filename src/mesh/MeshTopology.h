@@ -0,0 +1,132 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include "concurrency/Lock.h"
+#include "mesh-pb-constants.h"
+#include <Arduino.h>
+#include <unordered_map>
+#include <vector>
+
+// How many links we keep on average per node we know, so the graph never grows past MAX_NUM_NODES * this
+#define TOPOLOGY_EDGES_PER_NODE 4
+
+// A link nobody has reported for this long is dropped, and one that is getting old costs more to route over
+#define TOPOLOGY_EDGE_MAX_AGE_SECS (12 * 60 * 60)
+
+// Routes from us are recomputed at most this often when only SNRs and ages changed, a link coming or going does it at once
+#define TOPOLOGY_RECOMPUTE_SECS 30
+
+/**
+ * A link state graph of the mesh, built from what we learn about who hears whom: packets we hear directly, NeighborInfo
+ * reports and the routes RouteDiscovery (traceroute) packets took.
+ *
+ * Links are undirected, with the SNR each end last reported for the other (if we know it), and the time we last heard of the
+ * link.  Both nodes and links are kept in arrays sized from MAX_NUM_NODES.  When there are too many links the oldest goes,
+ * when there are too many nodes the one we heard of longest ago goes with its links, and a node goes with its last link.
+ *
+ * Shortest paths from us to every node are computed once (Dijkstra, where a hop costs more the weaker and older the link is)
+ * and kept until the graph changes, so asking for the next hop or hop count to a node costs a hash lookup and can be done
+ * for every packet.  Paths between any two other nodes are computed on demand.
+ *
+ * May be used from the HTTP threads on portduino, so every public method takes our lock.
+ */
+class MeshTopology
+{
+  public:
+    MeshTopology();
+
+    /// We heard mp from whoever sent it, if it came straight to us that is a link between us
+    void onPacketHeard(const meshtastic_MeshPacket &mp);
+
+    /// A NeighborInfo report: its sender heard each of its neighbors at the given SNR
+    void addNeighborInfo(const meshtastic_NeighborInfo &ni);
+
+    /// A RouteDiscovery which went from origin through r.route to dest (0 if it hasn't got there yet, the last hop is then
+    /// whoever appended itself last)
+    void addRoute(NodeNum origin, const meshtastic_RouteDiscovery &r, NodeNum dest);
+
+    /// Forget everything, e.g. when the NodeDB is reset
+    void clear();
+
+    /// @return how many hops the best path from us to dest takes, or -1 if we don't know of any
+    int getHops(NodeNum dest);
+
+    bool isReachable(NodeNum dest) { return getHops(dest) >= 0; }
+
+    /// @return the first node on our best path to dest (dest itself if it's a neighbor), or 0 if we don't know of any
+    NodeNum getNextHop(NodeNum dest);
+
+    /**
+     * Find the best path between two nodes (from may be us)
+     * @return how many nodes were written to path, starting with the first hop after from and ending with to, 0 if there is
+     * no path or it is longer than max
+     */
+    size_t findPath(NodeNum from, NodeNum to, NodeNum *path, size_t max);
+
+    /// Bumped every time a link is added or removed
+    uint32_t getGeneration() const { return generation; }
+
+    /// Write the graph and our routes as JSON, with the path from us to dest as well if dest isn't 0
+    void writeJson(Print &out, NodeNum dest = 0);
+
+  private:
+    enum : uint16_t { NO_NODE = 0xffff };
+    enum : int8_t { SNR_UNKNOWN = INT8_MIN };
+
+    struct Edge {
+        uint16_t a, b;      // node indexes, a < b
+        int8_t snrAtA;      // how well a hears b, in quarter dB, or SNR_UNKNOWN
+        int8_t snrAtB;      // and the other way round
+        uint32_t lastHeard; // millis()
+    };
+
+    /// Best path from a source to every node
+    struct Paths {
+        std::vector<uint32_t> cost;
+        std::vector<uint16_t> prev;     // the node before this one on the path, NO_NODE for the source and unreachable nodes
+        std::vector<uint16_t> firstHop; // the node after the source on the path
+        std::vector<uint8_t> hops;
+    };
+
+    concurrency::Lock lock;
+
+    size_t maxNodes, maxEdges;
+    std::vector<NodeNum> nodes;          // 0 for a free slot
+    std::vector<uint16_t> nodeDegree;    // how many links each node has
+    std::vector<uint32_t> nodeLastHeard; // millis() when we last heard of any of its links
+    std::vector<uint16_t> freeNodes;     // slots which were used and are free again
+    std::unordered_map<NodeNum, uint16_t> nodeIndex;
+    std::vector<Edge> edges;
+    std::unordered_map<uint32_t, uint16_t> edgeIndex; // keyed by a << 16 | b
+
+    // The graph as adjacency lists (CSR), rebuilt when it changes
+    std::vector<uint32_t> adjStart;
+    std::vector<uint16_t> adjEdge;
+
+    uint32_t generation = 1;
+    uint32_t adjGeneration = 0;
+    uint32_t ourPathsGeneration = 0;
+    uint32_t ourPathsAt = 0; // millis()
+    uint32_t expiredAt = 0;  // millis()
+    uint16_t ourPathsSource = NO_NODE;
+    Paths ourPaths, scratchPaths;
+
+    uint16_t findNode(NodeNum n) const;
+    uint16_t getOrAddNode(NodeNum n);
+    void releaseIfUnlinked(uint16_t i);
+    size_t oldestEdge() const;
+    void removeEdge(size_t i);
+    void expire();
+
+    /// Add or refresh the link between a and b, snr (in dB) is how well b heard a if known
+    void addLink(NodeNum a, NodeNum b, float snr, bool snrKnown);
+
+    uint32_t edgeCost(const Edge &e, uint32_t now) const;
+    void buildAdjacency();
+    void computePaths(uint16_t source, Paths &paths);
+
+    /// Our paths, recomputed if they are out of date.  NULL if we aren't in the graph
+    const Paths *getOurPaths();
+};
+
+extern MeshTopology *meshTopology;
@@ -0,0 +1,227 @@
+#include "NextHopRouter.h"
+#include "configuration.h"
+#include "mesh-pb-constants.h"
+
+NextHopRouter::NextHopRouter()
+{
+    routes.reserve(MAX_NUM_NODES); // Prealloc the worst case, to prevent heap fragmentation
+}
+
+ErrorCode NextHopRouter::send(meshtastic_MeshPacket *p)
+{
+    p->next_hop = 0; // the route is ours to pick, not the client's
+
+    // ReliableRouter floods its own retransmissions of want_ack packets, so we only have to resend the others
+    if (p->to != NODENUM_BROADCAST && p->hop_limit > 0)
+        direct(p, 0, !p->want_ack);
+
+    return FloodingRouter::send(p);
+}
+
+uint8_t NextHopRouter::getNextHop(NodeNum dest)
+{
+    auto found = routes.find(dest);
+    if (found == routes.end())
+        return 0;
+    if (millis() - found->second.lastOkMsec > NEXT_HOP_EXPIRE_MSEC) {
+        routes.erase(found);
+        return 0;
+    }
+    return found->second.nextHop;
+}
+
+void NextHopRouter::direct(meshtastic_MeshPacket *p, uint8_t cameFrom, bool resend)
+{
+    p->next_hop = 0;
+    if (!iface)
+        return;
+
+    uint8_t hop = getNextHop(p->to);
+    if (!hop || hop == cameFrom || hop == ourRelayByte())
+        return;
+
+    // Only the destination itself doesn't relay, so unless it acks we couldn't tell whether the packet got there
+    bool hopIsDest = hop == (p->to & 0xff);
+    if ((hopIsDest && !p->want_ack) || (!hopIsDest && p->hop_limit == 0))
+        return;
+
+    uint64_t key = packetKey(getFrom(p), p->id);
+    auto old = pending.find(key);
+    if (old != pending.end()) {
+        packetPool.release(old->second.packet);
+        pending.erase(old);
+    } else if (pending.size() >= NEXT_HOP_MAX_PENDING) {
+        return; // too busy to watch another one, flood it
+    }
+
+    p->next_hop = hop;
+    Pending rec;
+    rec.packet = packetPool.allocCopy(*p);
+    rec.nextHop = hop;
+    rec.resend = resend;
+    rec.deadlineMsec = millis() + iface->getRetransmissionMsec(p);
+    pending[key] = rec;
+    stats.directed++;
+
+    LOG_DEBUG("Sending fr=0x%x,to=0x%x,id=0x%x through next hop 0x%x\n", p->from, p->to, p->id, hop);
+    setReceivedMessage(); // Run ASAP, so we can figure out our correct sleep time
+}
+
+void NextHopRouter::learn(NodeNum dest, uint8_t nextHop)
+{
+    if (!nextHop || nextHop == ourRelayByte())
+        return;
+
+    auto found = routes.find(dest);
+    if (found == routes.end() && routes.size() >= MAX_NUM_NODES) {
+        auto oldest = routes.begin();
+        for (auto i = routes.begin(); i != routes.end(); ++i)
+            if ((int32_t)(i->second.lastOkMsec - oldest->second.lastOkMsec) < 0)
+                oldest = i;
+        routes.erase(oldest);
+    }
+
+    if (found == routes.end() || found->second.nextHop != nextHop)
+        LOG_DEBUG("Learned next hop 0x%x towards 0x%x\n", nextHop, dest);
+
+    Route &r = routes[dest];
+    r.nextHop = nextHop;
+    r.misses = 0;
+    r.lastOkMsec = millis();
+}
+
+void NextHopRouter::resolve(uint64_t key, bool ok)
+{
+    auto found = pending.find(key);
+    if (found == pending.end())
+        return;
+    Pending rec = found->second;
+    pending.erase(found);
+
+    auto route = routes.find(rec.packet->to);
+    bool sameRoute = route != routes.end() && route->second.nextHop == rec.nextHop;
+
+    if (ok) {
+        if (sameRoute) {
+            route->second.misses = 0;
+            route->second.lastOkMsec = millis();
+        }
+        packetPool.release(rec.packet);
+        return;
+    }
+
+    if (sameRoute && ++route->second.misses >= NEXT_HOP_MAX_MISSES) {
+        LOG_INFO("Next hop 0x%x towards 0x%x missed %d times, flooding until we learn another\n", rec.nextHop,
+                 rec.packet->to, NEXT_HOP_MAX_MISSES);
+        routes.erase(route);
+    }
+
+    if (rec.resend) {
+        LOG_INFO("Next hop 0x%x didn't relay fr=0x%x,to=0x%x,id=0x%x, flooding it\n", rec.nextHop, rec.packet->from,
+                 rec.packet->to, rec.packet->id);
+        rec.packet->next_hop = 0;
+        stats.directedFallbacks++;
+        Router::send(rec.packet);
+    } else {
+        packetPool.release(rec.packet);
+    }
+}
+
+int32_t NextHopRouter::runOnce()
+{
+    uint32_t now = millis();
+    int32_t d = INT32_MAX;
+
+    for (auto it = pending.begin(); it != pending.end();) {
+        int32_t left = it->second.deadlineMsec - now;
+        uint64_t key = it->first;
+        ++it; // resolve() erases key, which leaves it alone
+        if (left <= 0)
+            resolve(key, false);
+        else
+            d = min(left, d);
+    }
+
+    int32_t r = FloodingRouter::runOnce();
+    return min(d, r);
+}
+
+bool NextHopRouter::shouldFilterReceived(const meshtastic_MeshPacket *p)
+{
+    uint64_t key = packetKey(getFrom(p), p->id);
+
+    // The next hop relaying a directed packet we sent is as good as an ack for it
+    auto found = pending.find(key);
+    if (found != pending.end() && p->relay_node == found->second.nextHop)
+        resolve(key, true);
+
+    // A directed packet we left to its next hop, coming back as a flood because that didn't get it through.  The next hop
+    // itself sends it on without a next hop when it's one hop from the destination, which is no reason to relay it
+    auto skipped = skippedRelays.find(key);
+    if (skipped != skippedRelays.end() && (p->next_hop == 0 || p->next_hop == ourRelayByte()) &&
+        p->relay_node != skipped->second.nextHop) {
+        skippedRelays.erase(skipped);
+        if (p->hop_limit > 0 && config.device.role != meshtastic_Config_DeviceConfig_Role_CLIENT_MUTE) {
+            printPacket("Relaying a directed packet after all", p);
+            meshtastic_MeshPacket *tosend = packetPool.allocCopy(*p);
+            tosend->hop_limit--; // bump down the hop count
+            rebroadcast(tosend);
+        }
+        return true; // we handled it the first time round
+    }
+
+    return FloodingRouter::shouldFilterReceived(p);
+}
+
+void NextHopRouter::sniffReceived(const meshtastic_MeshPacket *p, const meshtastic_Routing *c)
+{
+    bool isAckOrReply = p->which_payload_variant == meshtastic_MeshPacket_decoded_tag && p->decoded.request_id != 0;
+    if (isAckOrReply && p->to != NODENUM_BROADCAST && p->from != getNodeNum()) {
+        // An ack means a directed packet got there, whichever way it went
+        resolve(packetKey(p->to, p->decoded.request_id), true);
+
+        // If we saw what this answers, whoever handed us the answer is on a working path back to its sender
+        meshtastic_MeshPacket original = meshtastic_MeshPacket_init_zero;
+        original.from = p->to;
+        original.id = p->decoded.request_id;
+        if (!p->via_mqtt && wasSeenRecently(&original, false)) {
+            bool fromNeighbor = p->hop_start != 0 && p->hop_start == p->hop_limit;
+            learn(p->from, p->relay_node ? p->relay_node : fromNeighbor ? (p->from & 0xff) : 0);
+        }
+    }
+
+    FloodingRouter::sniffReceived(p, c);
+}
+
+bool NextHopRouter::shouldRebroadcast(const meshtastic_MeshPacket *p)
+{
+    if (p->to == NODENUM_BROADCAST || p->next_hop == 0 || p->next_hop == ourRelayByte())
+        return true;
+
+    uint32_t now = millis();
+    if (skippedRelays.size() >= NEXT_HOP_MAX_SKIPPED) {
+        auto oldest = skippedRelays.begin();
+        for (auto i = skippedRelays.begin(); i != skippedRelays.end(); ++i)
+            if ((int32_t)(i->second.atMsec - oldest->second.atMsec) < 0)
+                oldest = i;
+        skippedRelays.erase(oldest);
+    }
+    Skipped &rec = skippedRelays[packetKey(getFrom(p), p->id)];
+    rec.nextHop = p->next_hop;
+    rec.atMsec = now;
+
+    stats.relaysSkipped++;
+    stats.relayAirtimeSavedMsec += iface->getPacketTime(p);
+    LOG_DEBUG("Leaving fr=0x%x,to=0x%x,id=0x%x to next hop 0x%x (%u relays skipped, %u ms of airtime saved)\n", p->from,
+              p->to, p->id, p->next_hop, stats.relaysSkipped, stats.relayAirtimeSavedMsec);
+    return false;
+}
+
+void NextHopRouter::rebroadcast(meshtastic_MeshPacket *tosend)
+{
+    // relay_node is still whoever we heard it from, until Router::send puts ours in
+    if (tosend->to != NODENUM_BROADCAST)
+        direct(tosend, tosend->relay_node, true);
+
+    FloodingRouter::rebroadcast(tosend);
+}
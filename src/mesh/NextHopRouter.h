@@ -0,0 +1,109 @@
+#pragma once
+
+#include "FloodingRouter.h"
+#include <unordered_map>
+
+// Once a route has failed this many times in a row we forget it and flood again until we learn a new one
+#define NEXT_HOP_MAX_MISSES 2
+
+// A route we haven't used successfully for this long is forgotten
+#define NEXT_HOP_EXPIRE_MSEC (60 * 60 * 1000UL)
+
+// How many directed packets we watch at once, any more are flooded
+#define NEXT_HOP_MAX_PENDING 8
+
+// How many directed packets we remember not relaying, in case they come back as a flood
+#define NEXT_HOP_MAX_SKIPPED 32
+
+/**
+ * This is a mixin that extends FloodingRouter with next-hop routing for unicast packets.
+ *
+ * Every packet we transmit carries the last byte of our node number in the relay_node byte of the radio header.  When an
+ * ack or a reply comes back for a unicast packet we have seen, whoever relayed it to us (or its sender, if it took no hops)
+ * is a node which can reach the sender of the ack, so we remember it as the next hop towards that node.
+ *
+ * A unicast packet to a node we have a next hop for is sent with that next hop in the next_hop byte of the header, and only
+ * the node whose number ends with it relays the packet; everyone else leaves it alone instead of flooding it through the
+ * whole mesh.  Whoever sent a directed packet listens for the next hop relaying it (or for the ack, if the next hop is the
+ * destination).  If that doesn't happen in time, the route counts a miss and the packet is sent again as a normal flood,
+ * which nodes that skipped it the first time do relay.
+ *
+ * Older firmware sends 0 in both bytes, which we treat as a flood and learn nothing from, and it ignores them, so it floods
+ * directed packets as it always did.
+ */
+class NextHopRouter : public FloodingRouter
+{
+  public:
+    NextHopRouter();
+
+    /**
+     * Send a packet on a suitable interface.  This routine will
+     * later free() the packet to pool.  This routine is not allowed to stall.
+     * If the txmit queue is full it might return an error
+     */
+    virtual ErrorCode send(meshtastic_MeshPacket *p) override;
+
+    /** Look for directed packets whose next hop didn't relay them */
+    virtual int32_t runOnce() override;
+
+    /// @return the last byte of the node we would send a packet to dest through, or 0 to flood it
+    uint8_t getNextHop(NodeNum dest);
+
+  protected:
+    /**
+     * Should this incoming filter be dropped?
+     *
+     * Called immediately on reception, before any further processing.
+     * @return true to abandon the packet
+     */
+    virtual bool shouldFilterReceived(const meshtastic_MeshPacket *p) override;
+
+    /**
+     * Learn routes from acks and replies, and look for the acks of directed packets
+     */
+    virtual void sniffReceived(const meshtastic_MeshPacket *p, const meshtastic_Routing *c) override;
+
+    virtual bool shouldRebroadcast(const meshtastic_MeshPacket *p) override;
+
+    virtual void rebroadcast(meshtastic_MeshPacket *tosend) override;
+
+  private:
+    struct Route {
+        uint8_t nextHop;
+        uint8_t misses;
+        uint32_t lastOkMsec;
+    };
+
+    /// A directed packet we sent, waiting for its next hop to relay it
+    struct Pending {
+        meshtastic_MeshPacket *packet; // our copy, to flood if the next hop doesn't relay it
+        uint8_t nextHop;
+        bool resend; // false if someone else (ReliableRouter) takes care of sending it again
+        uint32_t deadlineMsec;
+    };
+
+    /// A directed packet we left to its next hop
+    struct Skipped {
+        uint8_t nextHop;
+        uint32_t atMsec;
+    };
+
+    std::unordered_map<NodeNum, Route> routes;
+    std::unordered_map<uint64_t, Pending> pending;       // keyed by from << 32 | id
+    std::unordered_map<uint64_t, Skipped> skippedRelays; // keyed like pending
+
+    static uint64_t packetKey(NodeNum from, PacketId id) { return (uint64_t)from << 32 | id; }
+
+    uint8_t ourRelayByte() { return getNodeNum() & 0xff; }
+
+    /**
+     * Pick the next hop for p, a unicast packet we are about to send or relay, and watch for it relaying p
+     * @param cameFrom the last byte of whoever we got p from, which we don't send it back to
+     */
+    void direct(meshtastic_MeshPacket *p, uint8_t cameFrom, bool resend);
+
+    void learn(NodeNum dest, uint8_t nextHop);
+
+    /// The directed packet key reached its next hop (or its destination), or not
+    void resolve(uint64_t key, bool ok);
+};
@@ -8,6 +8,7 @@
 #include "Default.h"
 #include "FSCommon.h"
 #include "MeshRadio.h"
+#include "MeshTopology.h"
 #include "NodeDB.h"
 #include "PacketHistory.h"
 #include "PowerFSM.h"
@@ -15,6 +16,7 @@
 #include "Router.h"
 #include "TypeConversions.h"
 #include "error.h"
+#include "gps/GeoCoord.h"
 #include "main.h"
 #include "mesh-pb-constants.h"
 #include "modules/NeighborInfoModule.h"
@@ -101,6 +103,13 @@ NodeDB::NodeDB()
     loadFromDisk();
     cleanupMeshDB();
 
+    // Carry on after the generations previous boots handed out, so clients can't mistake an old token for a current one.
+    // If we never saved any, start somewhere random, which at least makes that unlikely
+    generation = minSyncGeneration = loadReservedGeneration();
+    if (!generation)
+        generation = minSyncGeneration = random(1, NODEDB_GENERATION_MASK / 2);
+    reserveGenerations();
+
     uint32_t devicestateCRC = crc32Buffer(&devicestate, sizeof(devicestate));
     uint32_t configCRC = crc32Buffer(&config, sizeof(config));
     uint32_t channelFileCRC = crc32Buffer(&channelFile, sizeof(channelFile));
@@ -443,10 +452,17 @@ void NodeDB::resetNodes()
 {
     numMeshNodes = 1;
     std::fill(devicestate.node_db_lite.begin() + 1, devicestate.node_db_lite.end(), meshtastic_NodeInfoLite());
+    // Too many removals to track individually, force all clients to do a full sync
+    nodeGenerations.clear();
+    removedNodes.clear();
+    positionStates.clear();
+    minSyncGeneration = nextGeneration();
     clearLocalPosition();
     saveDeviceStateToDisk();
     if (neighborInfoModule && moduleConfig.neighbor_info.enabled)
         neighborInfoModule->resetNeighbors();
+    if (meshTopology)
+        meshTopology->clear();
 }
 
 void NodeDB::removeNodeByNum(NodeNum nodeNum)
@@ -461,6 +477,8 @@ void NodeDB::removeNodeByNum(NodeNum nodeNum)
     numMeshNodes -= removed;
     std::fill(devicestate.node_db_lite.begin() + numMeshNodes, devicestate.node_db_lite.begin() + numMeshNodes + 1,
               meshtastic_NodeInfoLite());
+    if (removed)
+        markNodeRemoved(nodeNum);
     LOG_DEBUG("NodeDB::removeNodeByNum purged %d entries. Saving changes...\n", removed);
     saveDeviceStateToDisk();
 }
@@ -472,6 +490,7 @@ void NodeDB::clearLocalPosition()
     node->position.longitude_i = 0;
     node->position.altitude = 0;
     node->position.time = 0;
+    markNodeChanged(node->num);
     setLocalPosition(meshtastic_Position_init_default);
 }
 
@@ -479,10 +498,12 @@ void NodeDB::cleanupMeshDB()
 {
     int newPos = 0, removed = 0;
     for (int i = 0; i < numMeshNodes; i++) {
-        if (meshNodes->at(i).has_user)
+        if (meshNodes->at(i).has_user) {
             meshNodes->at(newPos++) = meshNodes->at(i);
-        else
+        } else {
+            markNodeRemoved(meshNodes->at(i).num);
             removed++;
+        }
     }
     numMeshNodes -= removed;
     std::fill(devicestate.node_db_lite.begin() + numMeshNodes, devicestate.node_db_lite.begin() + numMeshNodes + removed,
@@ -547,6 +568,7 @@ static const char *configFileName = "/prefs/config.proto";
 static const char *moduleConfigFileName = "/prefs/module.proto";
 static const char *channelFileName = "/prefs/channels.proto";
 static const char *oemConfigFile = "/oem/oem.proto";
+static const char *syncGenerationFileName = "/prefs/syncgen.bin";
 
 /** Load a protobuf from a file, return LoadFileResult */
 LoadFileResult NodeDB::loadProto(const char *filename, size_t protoSize, size_t objSize, const pb_msgdesc_t *fields,
@@ -769,6 +791,101 @@ const meshtastic_NodeInfoLite *NodeDB::readNextMeshNode(uint32_t &readIndex)
         return NULL;
 }
 
+const meshtastic_NodeInfoLite *NodeDB::readNextChangedMeshNode(uint32_t &readIndex, uint32_t since)
+{
+    while (readIndex < numMeshNodes) {
+        const meshtastic_NodeInfoLite *node = &meshNodes->at(readIndex++);
+        auto it = nodeGenerations.find(node->num);
+        if (it != nodeGenerations.end() && it->second > since)
+            return node;
+    }
+    return NULL;
+}
+
+NodeNum NodeDB::readNextRemovedMeshNode(uint32_t &readIndex, uint32_t since)
+{
+    while (readIndex < removedNodes.size()) {
+        const auto &removal = removedNodes[readIndex++];
+        // Skip nodes which were removed and then heard from again, they will be sent as changed nodes instead
+        if (removal.second > since && !getMeshNode(removal.first))
+            return removal.first;
+    }
+    return 0;
+}
+
+uint32_t NodeDB::nextGeneration()
+{
+    generation = (generation + 1) & NODEDB_GENERATION_MASK;
+    if (generation == 0) {
+        // We wrapped, any tokens handed out so far are meaningless now
+        LOG_DEBUG("NodeDB generation wrapped, clients will need a full sync\n");
+        generation = minSyncGeneration = 1;
+        nodeGenerations.clear();
+        removedNodes.clear();
+        reserveGenerations();
+    } else if (generation >= reservedGeneration) {
+        reserveGenerations();
+    }
+    return generation;
+}
+
+uint32_t NodeDB::loadReservedGeneration()
+{
+    uint32_t reserved = 0;
+#ifdef FSCom
+    if (!FSCom.exists(syncGenerationFileName))
+        return 0;
+    auto f = FSCom.open(syncGenerationFileName, FILE_O_READ);
+    if (f) {
+        if (f.read((uint8_t *)&reserved, sizeof(reserved)) != sizeof(reserved))
+            reserved = 0;
+        f.close();
+    }
+#endif
+    return reserved & NODEDB_GENERATION_MASK;
+}
+
+void NodeDB::reserveGenerations()
+{
+    reservedGeneration = std::min<uint32_t>(generation + NODEDB_GENERATION_RESERVE, NODEDB_GENERATION_MASK);
+#ifdef FSCom
+    FSCom.mkdir("/prefs");
+    String filenameTmp = syncGenerationFileName;
+    filenameTmp += ".tmp";
+    if (FSCom.exists(filenameTmp.c_str()))
+        FSCom.remove(filenameTmp.c_str()); // some filesystems append to what is there
+    auto f = FSCom.open(filenameTmp.c_str(), FILE_O_WRITE);
+    if (!f) {
+        LOG_ERROR("Can't save the NodeDB generation, clients may get a wrong incremental sync after a reboot\n");
+        return;
+    }
+    f.write((const uint8_t *)&reservedGeneration, sizeof(reservedGeneration));
+    f.flush();
+    f.close();
+    if (FSCom.exists(syncGenerationFileName) && !FSCom.remove(syncGenerationFileName))
+        LOG_WARN("Can't remove old NodeDB generation file\n");
+    if (!renameFile(filenameTmp.c_str(), syncGenerationFileName))
+        LOG_ERROR("Error: can't rename new NodeDB generation file\n");
+#endif
+}
+
+void NodeDB::markNodeChanged(NodeNum n)
+{
+    nodeGenerations[n] = nextGeneration();
+}
+
+void NodeDB::markNodeRemoved(NodeNum n)
+{
+    nodeGenerations.erase(n);
+    positionStates.erase(n);
+    removedNodes.push_back(std::make_pair(n, nextGeneration()));
+    if (removedNodes.size() > NODEDB_REMOVED_LOG_SIZE) {
+        // Clients which haven't seen this removal yet can no longer be given a correct delta
+        minSyncGeneration = removedNodes.front().second;
+        removedNodes.erase(removedNodes.begin());
+    }
+}
+
 /// Given a node, return how many seconds in the past (vs now) that we last heard from it
 uint32_t sinceLastSeen(const meshtastic_NodeInfoLite *n)
 {
@@ -809,12 +926,69 @@ size_t NodeDB::getNumOnlineMeshNodes(bool localOnly)
     return numseen;
 }
 
+bool NodeDB::updatePosition(uint32_t nodeId, const PositionDelta &d, meshtastic_Position *reconstructed)
+{
+#if POSITION_COMPACT_DELTAS
+    // If we missed the keyframe we can't tell where this is, but the node sends a new keyframe every so often
+    PositionState *s = getPositionState(nodeId, false);
+    if (!s || !s->hasKeyframe || s->keyframe != d.keyframe) {
+        LOG_DEBUG("Compact position from 0x%x is relative to keyframe %u, which we missed, waiting for the next one\n", nodeId,
+                  d.keyframe);
+        return false;
+    }
+
+    meshtastic_Position p;
+    if (!applyPositionDelta(s->keyframePos, s->keyframePrecision, d, p)) {
+        LOG_WARN("Compact position from 0x%x is off the map, ignoring it\n", nodeId);
+        return false;
+    }
+    updatePosition(nodeId, p);
+    if (reconstructed)
+        *reconstructed = p;
+    return true;
+#else
+    return false;
+#endif
+}
+
+NodeDB::PositionState *NodeDB::getPositionState(NodeNum n, bool create)
+{
+    auto found = positionStates.find(n);
+    if (found != positionStates.end())
+        return &found->second;
+    if (!create)
+        return NULL;
+
+    if (positionStates.size() >= MAX_NUM_NODES) {
+        auto oldest = positionStates.begin();
+        for (auto i = positionStates.begin(); i != positionStates.end(); ++i)
+            if ((int32_t)(i->second.receivedMsec - oldest->second.receivedMsec) < 0)
+                oldest = i;
+        positionStates.erase(oldest);
+    }
+    PositionState &s = positionStates[n];
+    memset(&s, 0, sizeof(s));
+    return &s;
+}
+
+meshtastic_PositionLite NodeDB::getEstimatedPosition(const meshtastic_NodeInfoLite *node)
+{
+    meshtastic_PositionLite pos = node->position;
+    auto found = positionStates.find(node->num);
+    if (found != positionStates.end() && found->second.speed) {
+        const PositionState &m = found->second;
+        float secs = std::min((millis() - m.receivedMsec) / 1000.0f, (float)m.horizonSecs);
+        GeoCoord::deadReckon(pos.latitude_i, pos.longitude_i, m.speed, m.track, secs);
+    }
+    return pos;
+}
+
 #include "MeshModule.h"
 #include "Throttle.h"
 
 /** Update position info for this node based on received position data
  */
-void NodeDB::updatePosition(uint32_t nodeId, const meshtastic_Position &p, RxSource src)
+void NodeDB::updatePosition(uint32_t nodeId, const meshtastic_Position &p, RxSource src, bool onPrimary)
 {
     meshtastic_NodeInfoLite *info = getOrCreateMeshNode(nodeId);
     if (!info) {
@@ -850,8 +1024,30 @@ void NodeDB::updatePosition(uint32_t nodeId, const meshtastic_Position &p, RxSou
         // Last, restore any fields that may have been overwritten
         if (!info->position.time)
             info->position.time = tmp_time;
+
+        // A node which sends its velocity with a promise of when it will update (dead reckoning) moves in between, and one
+        // which numbers its positions may send the next ones relative to this one (compact positions), but only to those on
+        // the primary channel, the positions it sends elsewhere may be of another precision
+        bool moving = p.ground_speed && p.next_update;
+        bool keyframe = POSITION_COMPACT_DELTAS && onPrimary && p.seq_number;
+        PositionState *s = getPositionState(nodeId, moving || keyframe);
+        if (s) {
+            s->speed = moving ? p.ground_speed : 0;
+            s->track = p.ground_track;
+            s->horizonSecs = p.next_update;
+            s->receivedMsec = millis();
+#if POSITION_COMPACT_DELTAS
+            if (keyframe) {
+                s->hasKeyframe = true;
+                s->keyframe = p.seq_number & 0xff;
+                s->keyframePos = TypeConversions::ConvertToPositionLite(p);
+                s->keyframePrecision = p.precision_bits;
+            }
+#endif
+        }
     }
     info->has_position = true;
+    markNodeChanged(info->num);
     updateGUIforNode = info;
     notifyObservers(true); // Force an update whether or not our node counts have changed
 }
@@ -875,6 +1071,7 @@ void NodeDB::updateTelemetry(uint32_t nodeId, const meshtastic_Telemetry &t, RxS
     }
     info->device_metrics = t.variant.device_metrics;
     info->has_device_metrics = true;
+    markNodeChanged(info->num);
     updateGUIforNode = info;
     notifyObservers(true); // Force an update whether or not our node counts have changed
 }
@@ -901,6 +1098,7 @@ bool NodeDB::updateUser(uint32_t nodeId, const meshtastic_User &p, uint8_t chann
     info->has_user = true;
 
     if (changed) {
+        markNodeChanged(info->num);
         updateGUIforNode = info;
         powerFSM.trigger(EVENT_NODEDB_UPDATED);
         notifyObservers(true); // Force an update whether or not our node counts have changed
@@ -937,6 +1135,8 @@ void NodeDB::updateFrom(const meshtastic_MeshPacket &mp)
         // If hopStart was set and there wasn't someone messing with the limit in the middle, add hopsAway
         if (mp.hop_start != 0 && mp.hop_limit <= mp.hop_start)
             info->hops_away = mp.hop_start - mp.hop_limit;
+
+        markNodeChanged(info->num);
     }
 }
 
@@ -979,6 +1179,8 @@ meshtastic_NodeInfoLite *NodeDB::getOrCreateMeshNode(NodeNum n)
                     oldestIndex = i;
                 }
             }
+            if (oldestIndex >= 0)
+                markNodeRemoved(meshNodes->at(oldestIndex).num);
             // Shove the remaining nodes down the chain
             for (int i = oldestIndex; i < numMeshNodes - 1; i++) {
                 meshNodes->at(i) = meshNodes->at(i + 1);
@@ -991,6 +1193,7 @@ meshtastic_NodeInfoLite *NodeDB::getOrCreateMeshNode(NodeNum n)
         // everything is missing except the nodenum
         memset(lite, 0, sizeof(*lite));
         lite->num = n;
+        markNodeChanged(n);
     }
 
     return lite;
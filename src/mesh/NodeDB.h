@@ -3,10 +3,12 @@
 #include "Observer.h"
 #include <Arduino.h>
 #include <assert.h>
+#include <unordered_map>
 #include <vector>
 
 #include "MeshTypes.h"
 #include "NodeStatus.h"
+#include "PositionDelta.h"
 #include "mesh-pb-constants.h"
 #include "mesh/generated/meshtastic/mesh.pb.h" // For CriticalErrorCode
 
@@ -23,6 +25,16 @@ DeviceState versions used to be defined in the .proto file but really only this
 #define DEVICESTATE_CUR_VER 22
 #define DEVICESTATE_MIN_VER DEVICESTATE_CUR_VER
 
+/*
+NodeDB generations are used as sync tokens for incremental client syncs, so they have to fit in the low bits of a
+config_complete_id (see PhoneAPI).  We remember this many removed nodes; clients that synced before the oldest
+forgotten removal get a full sync instead.  Generations are reserved on flash NODEDB_GENERATION_RESERVE at a time, and each
+boot carries on after the last reservation, so a token from before a reboot is never taken for a current one.
+*/
+#define NODEDB_GENERATION_MASK 0x00ffffff
+#define NODEDB_REMOVED_LOG_SIZE 32
+#define NODEDB_GENERATION_RESERVE 1024
+
 extern meshtastic_DeviceState devicestate;
 extern meshtastic_ChannelFile channelFile;
 extern meshtastic_MyNodeInfo &myNodeInfo;
@@ -88,8 +100,15 @@ class NodeDB
     void updateFrom(const meshtastic_MeshPacket &p);
 
     /** Update position info for this node based on received position data
+     * @param onPrimary whether p came on the primary channel, where compact positions are relative to the full ones
      */
-    void updatePosition(uint32_t nodeId, const meshtastic_Position &p, RxSource src = RX_SRC_RADIO);
+    void updatePosition(uint32_t nodeId, const meshtastic_Position &p, RxSource src = RX_SRC_RADIO, bool onPrimary = false);
+
+    /** Update position info for this node from a compact position, relative to the last full position it sent
+     * @param reconstructed if not NULL, gets the position we made of it
+     * @return false if we don't have the full position it is relative to (always, unless POSITION_COMPACT_DELTAS)
+     */
+    bool updatePosition(uint32_t nodeId, const PositionDelta &d, meshtastic_Position *reconstructed = NULL);
 
     /** Update telemetry info for this node based on received metrics
      */
@@ -136,6 +155,21 @@ class NodeDB
 
     const meshtastic_NodeInfoLite *readNextMeshNode(uint32_t &readIndex);
 
+    /// @return the current NodeDB generation, which is bumped every time a node is created, modified or removed
+    uint32_t getGeneration() { return generation; }
+
+    /// @return true if a client that last synced at generation `since` can be sent only the nodes changed after it
+    bool canSyncSince(uint32_t since) { return since >= minSyncGeneration && since <= generation; }
+
+    /// Like readNextMeshNode, but skips nodes that have not changed after generation `since`
+    const meshtastic_NodeInfoLite *readNextChangedMeshNode(uint32_t &readIndex, uint32_t since);
+
+    /// @return the next node removed after generation `since`, or 0 once all removals have been read
+    NodeNum readNextRemovedMeshNode(uint32_t &readIndex, uint32_t since);
+
+    /// Record that a node entry was modified outside of the update* functions, so incremental syncs will include it
+    void markNodeChanged(NodeNum n);
+
     meshtastic_NodeInfoLite *getMeshNodeByIndex(size_t x)
     {
         assert(x < numMeshNodes);
@@ -145,6 +179,9 @@ class NodeDB
     meshtastic_NodeInfoLite *getMeshNode(NodeNum n);
     size_t getNumMeshNodes() { return numMeshNodes; }
 
+    /// @return where node is, extrapolated from its last position if it told us its velocity (see PositionModule)
+    meshtastic_PositionLite getEstimatedPosition(const meshtastic_NodeInfoLite *node);
+
     void clearLocalPosition();
 
     void setLocalPosition(meshtastic_Position position, bool timeOnly = false)
@@ -162,6 +199,50 @@ class NodeDB
 
   private:
     uint32_t lastNodeDbSave = 0; // when we last saved our db to flash
+
+    /// Change counter for incremental client syncs.  Starts after every generation handed out before a reboot, so that
+    /// canSyncSince() rejects their tokens
+    uint32_t generation = 0;
+    /// The oldest sync token we can still serve a correct delta for
+    uint32_t minSyncGeneration = 0;
+    /// Generations up to this one are reserved on flash for this boot
+    uint32_t reservedGeneration = 0;
+    /// The generation at which each node was last changed.  Nodes missing here have not changed since boot
+    std::unordered_map<NodeNum, uint32_t> nodeGenerations;
+    /// The most recently removed nodes and the generation at which they were removed, oldest first
+    std::vector<std::pair<NodeNum, uint32_t>> removedNodes;
+
+    /// What we keep about the positions a node sends, beyond what fits in its NodeInfoLite
+    struct PositionState {
+        // The velocity it sent with its last position, which it vouched for until its next update (dead reckoning)
+        uint32_t speed;        // km/h, 0 if it didn't send one
+        uint32_t track;        // 1e-5 degrees
+        uint32_t horizonSecs;  // how long we may extrapolate for
+        uint32_t receivedMsec; // millis() when we got its last position
+#if POSITION_COMPACT_DELTAS
+        // The last numbered full position it sent on the primary channel, which its compact positions are relative to
+        bool hasKeyframe;
+        uint8_t keyframe; // low byte of its seq_number
+        meshtastic_PositionLite keyframePos;
+        uint32_t keyframePrecision; // precision_bits, which PositionLite doesn't keep
+#endif
+    };
+    std::unordered_map<NodeNum, PositionState> positionStates;
+
+    /// @return what we know about n's positions, a new record (replacing the oldest if there are too many) if create
+    PositionState *getPositionState(NodeNum n, bool create);
+
+    /// Advance our generation counter, returns the new value
+    uint32_t nextGeneration();
+
+    /// @return the first generation no previous boot can have handed out, or 0 if we don't know
+    uint32_t loadReservedGeneration();
+
+    /// Reserve the next NODEDB_GENERATION_RESERVE generations on flash, so no later boot hands them out again
+    void reserveGenerations();
+
+    /// Record that a node was removed from the DB, so incremental syncs can tell clients to drop it
+    void markNodeRemoved(NodeNum n);
     /// Find a node in our DB, create an empty NodeInfoLite if missing
     meshtastic_NodeInfoLite *getOrCreateMeshNode(NodeNum n);
 
@@ -0,0 +1,151 @@
+#include "NodeDBExport.h"
+#include "NodeDB.h"
+#include "TypeConversions.h"
+#include "mqtt/JSONWriter.h"
+#include <pb_encode.h>
+
+uint32_t nodeDBExportBase(uint32_t since)
+{
+    return since && nodeDB->canSyncSince(since) ? since : 0;
+}
+
+void nodeDBExportETag(char *buf, size_t bufSize, bool json, uint32_t base)
+{
+    snprintf(buf, bufSize, "\"%u-%s-%u\"", nodeDB->getGeneration(), json ? "json" : "pb", base);
+}
+
+static const meshtastic_NodeInfoLite *nextNode(uint32_t &readIndex, uint32_t base)
+{
+    return base ? nodeDB->readNextChangedMeshNode(readIndex, base) : nodeDB->readNextMeshNode(readIndex);
+}
+
+static bool printCallback(pb_ostream_t *stream, const pb_byte_t *buf, size_t count)
+{
+    return ((Print *)stream->state)->write(buf, count) == count;
+}
+
+void writeNodeDBProtobuf(Print &out, uint32_t base)
+{
+    pb_ostream_t stream = {&printCallback, &out, SIZE_MAX, 0};
+
+    uint32_t readIndex = 0;
+    while (const meshtastic_NodeInfoLite *node = nextNode(readIndex, base)) {
+        meshtastic_NodeInfo info = TypeConversions::ConvertToNodeInfo(node);
+        if (!pb_encode_delimited(&stream, meshtastic_NodeInfo_fields, &info))
+            return; // the client went away
+    }
+
+    if (base) {
+        readIndex = 0;
+        while (NodeNum removed = nodeDB->readNextRemovedMeshNode(readIndex, base)) {
+            meshtastic_NodeInfo info = meshtastic_NodeInfo_init_zero;
+            info.num = removed;
+            if (!pb_encode_delimited(&stream, meshtastic_NodeInfo_fields, &info))
+                return;
+        }
+    }
+}
+
+/// The fields we export as JSON columns, in the order we write them
+enum JsonColumn {
+    COL_NUM,
+    COL_LONG_NAME,
+    COL_SHORT_NAME,
+    COL_HW_MODEL,
+    COL_ROLE,
+    COL_LAST_HEARD,
+    COL_SNR,
+    COL_HOPS_AWAY,
+    COL_VIA_MQTT,
+    COL_IS_FAVORITE,
+    COL_LATITUDE_I,
+    COL_LONGITUDE_I,
+    COL_ALTITUDE,
+    COL_BATTERY_LEVEL,
+    COL_VOLTAGE,
+    NUM_JSON_COLUMNS
+};
+
+static const char *jsonColumnNames[NUM_JSON_COLUMNS] = {
+    "num",      "long_name",   "short_name", "hw_model",    "role",     "last_heard",    "snr",    "hops_away",
+    "via_mqtt", "is_favorite", "latitude_i", "longitude_i", "altitude", "battery_level", "voltage"};
+
+/// Write one node's value for a column, or null if the node doesn't have it
+static void writeJsonCell(JSONWriter &w, const meshtastic_NodeInfoLite *node, JsonColumn col)
+{
+    const bool user = node->has_user, pos = node->has_position, metrics = node->has_device_metrics;
+
+    switch (col) {
+    case COL_NUM:
+        return w.value(node->num);
+    case COL_LONG_NAME:
+        return user ? w.value(node->user.long_name) : w.null();
+    case COL_SHORT_NAME:
+        return user ? w.value(node->user.short_name) : w.null();
+    case COL_HW_MODEL:
+        return user ? w.value((uint32_t)node->user.hw_model) : w.null();
+    case COL_ROLE:
+        return user ? w.value((uint32_t)node->user.role) : w.null();
+    case COL_LAST_HEARD:
+        return w.value(node->last_heard);
+    case COL_SNR:
+        return w.value((double)node->snr);
+    case COL_HOPS_AWAY:
+        return w.value((uint32_t)node->hops_away);
+    case COL_VIA_MQTT:
+        return w.value(node->via_mqtt);
+    case COL_IS_FAVORITE:
+        return w.value(node->is_favorite);
+    case COL_LATITUDE_I:
+        return pos ? w.value(node->position.latitude_i) : w.null();
+    case COL_LONGITUDE_I:
+        return pos ? w.value(node->position.longitude_i) : w.null();
+    case COL_ALTITUDE:
+        return pos ? w.value(node->position.altitude) : w.null();
+    case COL_BATTERY_LEVEL:
+        return metrics ? w.value(node->device_metrics.battery_level) : w.null();
+    case COL_VOLTAGE:
+        return metrics ? w.value((double)node->device_metrics.voltage) : w.null();
+    default:
+        return w.null();
+    }
+}
+
+void writeNodeDBJson(Print &out, uint32_t base)
+{
+    // Each cell is escaped into this scratch buffer and printed straight away, so the size of the NodeDB doesn't matter
+    char cell[sizeof(meshtastic_User::long_name) * 6 + 8];
+
+    snprintf(cell, sizeof(cell), "{\"generation\":%u,\"since\":%u", nodeDB->getGeneration(), base);
+    out.print(cell);
+
+    for (int col = 0; col < NUM_JSON_COLUMNS; col++) {
+        out.print(",\"");
+        out.print(jsonColumnNames[col]);
+        out.print("\":[");
+        uint32_t readIndex = 0;
+        bool first = true;
+        while (const meshtastic_NodeInfoLite *node = nextNode(readIndex, base)) {
+            JSONWriter w(cell, sizeof(cell));
+            writeJsonCell(w, node, (JsonColumn)col);
+            if (!first)
+                out.print(',');
+            out.print(cell);
+            first = false;
+        }
+        out.print(']');
+    }
+
+    out.print(",\"removed\":[");
+    if (base) {
+        uint32_t readIndex = 0;
+        bool first = true;
+        while (NodeNum removed = nodeDB->readNextRemovedMeshNode(readIndex, base)) {
+            if (!first)
+                out.print(',');
+            out.print(removed);
+            first = false;
+        }
+    }
+    out.print("]}");
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**
+ * Dumps of the NodeDB for dashboards which poll the node list over HTTP, either as a stream of length delimited NodeInfo
+ * protobufs or as columnar JSON (one array per field, which is far smaller than an object per node).
+ *
+ * Exports are tied to the NodeDB generation: it is sent in the NODEDB_EXPORT_GENERATION_HEADER, and a client which passes the
+ * generation it last saw as since= gets only the nodes which changed after it, plus the nodes which were removed (as a
+ * NodeInfo with only num set, or in the JSON "removed" array).  The ETag covers the generation, the format and what the
+ * export is relative to, so an unchanged NodeDB costs a 304 and no body.
+ */
+
+/// The response header with the generation an export is of, to pass as since= next time
+#define NODEDB_EXPORT_GENERATION_HEADER "X-NodeDB-Generation"
+
+/// Big enough for any nodeDBExportETag()
+#define NODEDB_EXPORT_ETAG_SIZE 32
+
+/// @return the generation we will export changes after: since itself if we can still serve a delta from it, otherwise 0,
+/// meaning the client gets everything
+uint32_t nodeDBExportBase(uint32_t since);
+
+/// Write the quoted ETag for an export of the current NodeDB, in JSON or protobufs, of the changes after generation base
+void nodeDBExportETag(char *buf, size_t bufSize, bool json, uint32_t base);
+
+/// Write the nodes changed after generation base (all of them if base is 0) as length delimited NodeInfo protobufs
+void writeNodeDBProtobuf(Print &out, uint32_t base);
+
+/// Write the nodes changed after generation base (all of them if base is 0) as columnar JSON
+void writeNodeDBJson(Print &out, uint32_t base);
@@ -0,0 +1,158 @@
+#include "OpenMetrics.h"
+#include "MeshService.h"
+#include "NodeDB.h"
+#include "RadioLibInterface.h"
+#include "Router.h"
+#include "airtime.h"
+#include "concurrency/OSThread.h"
+#include "configuration.h"
+#include "memGet.h"
+#if !MESHTASTIC_EXCLUDE_MQTT
+#include "mqtt/MQTT.h"
+#endif
+#if !MESHTASTIC_EXCLUDE_GPS
+#include "modules/PositionModule.h"
+#endif
+#include <stdarg.h>
+
+static void printMetric(Print &out, const char *format, ...)
+{
+    char buf[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    out.print(buf);
+}
+
+/// The TYPE and HELP lines which come before the samples of a metric
+static void describe(Print &out, const char *name, const char *type, const char *help)
+{
+    printMetric(out, "# TYPE meshtastic_%s %s\n# HELP meshtastic_%s %s\n", name, type, name, help);
+}
+
+static void counter(Print &out, const char *name, const char *help, unsigned long long value)
+{
+    describe(out, name, "counter", help);
+    printMetric(out, "meshtastic_%s_total %llu\n", name, value);
+}
+
+static void gauge(Print &out, const char *name, const char *help, unsigned long long value)
+{
+    describe(out, name, "gauge", help);
+    printMetric(out, "meshtastic_%s %llu\n", name, value);
+}
+
+static void gauge(Print &out, const char *name, const char *help, double value, int decimals)
+{
+    describe(out, name, "gauge", help);
+    printMetric(out, "meshtastic_%s %.*f\n", name, decimals, value);
+}
+
+static void threadMetrics(Print &out, ThreadController &controller)
+{
+    int n = controller.size(false);
+    for (int i = 0; i < n; i++) {
+        // Only OSThreads ever add themselves to our controllers
+        auto *t = static_cast<concurrency::OSThread *>(controller.get(i));
+        if (!t)
+            continue;
+        printMetric(out, "meshtastic_thread_runtime_seconds_total{thread=\"%s\"} %.6f\n", t->ThreadName.c_str(),
+                    t->getRuntimeUsec() / 1e6);
+    }
+}
+
+void writeOpenMetrics(Print &out)
+{
+    if (airTime) {
+        gauge(out, "uptime_seconds", "Seconds since boot", airTime->getSecondsSinceBoot());
+        describe(out, "airtime_seconds", "counter", "Time on air by kind (tx, rx of mesh packets, rx of anything)");
+        printMetric(out, "meshtastic_airtime_seconds_total{kind=\"tx\"} %.3f\n", airTime->getTotalMsec(TX_LOG) / 1000.0);
+        printMetric(out, "meshtastic_airtime_seconds_total{kind=\"rx\"} %.3f\n", airTime->getTotalMsec(RX_LOG) / 1000.0);
+        printMetric(out, "meshtastic_airtime_seconds_total{kind=\"rx_all\"} %.3f\n",
+                    airTime->getTotalMsec(RX_ALL_LOG) / 1000.0);
+        gauge(out, "channel_utilization_ratio", "Share of the last minute the channel was busy",
+              airTime->channelUtilizationPercent() / 100, 4);
+        gauge(out, "tx_utilization_ratio", "Share of the last hour we spent transmitting", airTime->utilizationTXPercent() / 100,
+              4);
+    }
+
+    RadioLibInterface *radio = RadioLibInterface::instance;
+    if (radio) {
+        counter(out, "radio_rx_good", "Packets received and decoded", radio->rxGood);
+        counter(out, "radio_rx_bad", "Packets received with errors", radio->rxBad);
+        counter(out, "radio_tx_good", "Packets transmitted", radio->txGood);
+        gauge(out, "tx_queue_depth", "Packets waiting to be transmitted", radio->txQueue.numUsed());
+        counter(out, "tx_queue_dropped", "Packets dropped because the transmit queue was full", radio->txQueue.dropped);
+    }
+
+    gauge(out, "to_phone_queue_depth", "Packets waiting for a client to fetch them", service.getToPhoneQueueDepth());
+    counter(out, "to_phone_queue_dropped", "Packets dropped because no client was fetching them", service.getToPhoneDropped());
+
+    if (router) {
+        const Router::Stats &stats = router->getStats();
+        counter(out, "router_duplicates", "Received packets ignored because we had already seen them", stats.duplicates);
+        counter(out, "router_retransmissions", "Reliable packets sent again because no ack came", stats.retransmissions);
+        counter(out, "router_directed", "Unicast packets sent or relayed to a single next hop", stats.directed);
+        counter(out, "router_directed_fallbacks", "Directed packets flooded after all because the next hop didn't relay them",
+                stats.directedFallbacks);
+        counter(out, "router_relays_skipped", "Directed packets we left to their next hop instead of relaying them",
+                stats.relaysSkipped);
+        describe(out, "router_relay_airtime_saved_seconds", "counter", "Airtime the relays we skipped would have taken");
+        printMetric(out, "meshtastic_router_relay_airtime_saved_seconds_total %.3f\n", stats.relayAirtimeSavedMsec / 1000.0);
+    }
+
+#if !MESHTASTIC_EXCLUDE_MQTT
+    if (mqtt) {
+        const MQTTUplinkStats &up = mqtt->getUplinkStats();
+        gauge(out, "mqtt_uplink_queue_depth", "Messages waiting for the MQTT broker", mqtt->getUplinkQueueDepth());
+        counter(out, "mqtt_uplink_queued", "Messages which had to wait for the MQTT broker", up.queued);
+        counter(out, "mqtt_uplink_published", "Queued messages published to the MQTT broker", up.published);
+        counter(out, "mqtt_uplink_dropped", "Messages dropped before reaching the MQTT broker", up.dropped);
+        gauge(out, "mqtt_uplink_max_latency_seconds", "Longest any queued message has waited for the MQTT broker",
+              up.maxLatencyMsec / 1000.0, 3);
+
+        describe(out, "mqtt_downlink_packets", "counter", "Packets from the MQTT broker by channel and what we did with them");
+        for (int i = 0; i < MAX_NUM_CHANNELS; i++) {
+            const MQTTDownlinkCounters &c = mqtt->getDownlinkCounters(i);
+            if (!c.injected && !c.duplicates && !c.shaped)
+                continue;
+            printMetric(out, "meshtastic_mqtt_downlink_packets_total{channel=\"%d\",result=\"injected\"} %u\n", i, c.injected);
+            printMetric(out, "meshtastic_mqtt_downlink_packets_total{channel=\"%d\",result=\"duplicate\"} %u\n", i,
+                        c.duplicates);
+            printMetric(out, "meshtastic_mqtt_downlink_packets_total{channel=\"%d\",result=\"shaped\"} %u\n", i, c.shaped);
+        }
+    }
+#endif
+
+#if !MESHTASTIC_EXCLUDE_GPS && (POSITION_DEAD_RECKONING || POSITION_COMPACT_DELTAS)
+    if (positionModule) {
+        const PositionModule::Stats &ps = positionModule->getStats();
+#if POSITION_DEAD_RECKONING
+        counter(out, "position_smart_sends", "Smart position broadcasts sent with dead reckoning", ps.smartSends);
+        counter(out, "position_distance_sends", "Smart position broadcasts going by distance alone would have sent",
+                ps.distanceSends);
+#endif
+#if POSITION_COMPACT_DELTAS
+        counter(out, "position_compact_keyframes", "Full positions compact positions are relative to", ps.keyframes);
+        counter(out, "position_compact_deltas", "Compact position broadcasts", ps.deltas);
+        counter(out, "position_compact_bytes_saved", "Payload bytes compact positions saved over full ones",
+                ps.deltaBytesSaved);
+#endif
+    }
+#endif
+
+    if (nodeDB)
+        gauge(out, "nodedb_nodes", "Nodes in our node database", nodeDB->getNumMeshNodes());
+
+    gauge(out, "heap_free_bytes", "Free heap", memGet.getFreeHeap());
+    gauge(out, "heap_size_bytes", "Total heap", memGet.getHeapSize());
+    gauge(out, "packet_pool_in_use", "Mesh packets allocated right now", packetPool.getInUse());
+    gauge(out, "packet_pool_in_use_max", "Most mesh packets ever allocated at once", packetPool.getMaxInUse());
+
+    describe(out, "thread_runtime_seconds", "counter", "Time each thread has spent running since boot");
+    threadMetrics(out, concurrency::mainController);
+    threadMetrics(out, concurrency::timerController);
+
+    out.print("# EOF\n");
+}
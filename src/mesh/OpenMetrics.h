@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Arduino.h>
+
+// What to send as the Content-Type of writeOpenMetrics() output
+#define OPENMETRICS_CONTENT_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/**
+ * Write our metrics (airtime, radio, queues, routing, memory and per thread runtime) in the OpenMetrics text format, for
+ * the /metrics endpoint of the web servers.
+ *
+ * Every value is a counter or gauge which the code it describes keeps up to date anyway, so a scrape only reads them and
+ * doesn't walk any tables.  It does walk our thread lists though, so it may only be called from the main thread.
+ */
+void writeOpenMetrics(Print &out);
@@ -35,7 +35,7 @@ PhoneAPI::~PhoneAPI()
     close();
 }
 
-void PhoneAPI::handleStartConfig()
+void PhoneAPI::handleStartConfig(bool wantSync, uint32_t since)
 {
     // Must be before setting state (because state is how we know !connected)
     if (!isConnected()) {
@@ -48,6 +48,11 @@ void PhoneAPI::handleStartConfig()
     state = STATE_SEND_MY_INFO;
 
     LOG_INFO("Starting API client config\n");
+    sendSyncToken = wantSync;
+    syncSince = wantSync && since && nodeDB->canSyncSince(since) ? since : 0;
+    syncGeneration = nodeDB->getGeneration();
+    if (syncSince)
+        LOG_INFO("Client wants nodes changed since generation %u (now %u)\n", syncSince, syncGeneration);
     nodeInfoForPhone.num = 0; // Don't keep returning old nodeinfos
     resetReadIndex();
 }
@@ -100,6 +105,11 @@ bool PhoneAPI::handleToRadio(const uint8_t *buf, size_t bufLength)
             LOG_INFO("Client wants config, nonce=%u\n", config_nonce);
             handleStartConfig();
             break;
+        case meshtastic_ToRadio_want_config_since_tag:
+            config_nonce = 0;
+            LOG_INFO("Client wants config, NodeDB changes since %u\n", toRadioScratch.want_config_since);
+            handleStartConfig(true, toRadioScratch.want_config_since & NODEDB_GENERATION_MASK);
+            break;
         case meshtastic_ToRadio_disconnect_tag:
             LOG_INFO("Disconnecting from phone\n");
             close();
@@ -349,7 +359,10 @@ size_t PhoneAPI::getFromRadio(uint8_t *buf)
     case STATE_SEND_COMPLETE_ID:
         LOG_INFO("getFromRadio=STATE_SEND_COMPLETE_ID\n");
         fromRadioScratch.which_payload_variant = meshtastic_FromRadio_config_complete_id_tag;
-        fromRadioScratch.config_complete_id = config_nonce;
+        if (sendSyncToken)
+            fromRadioScratch.config_complete_id = (syncSince ? NODEDB_SYNC_DELTA : 0) | syncGeneration;
+        else
+            fromRadioScratch.config_complete_id = config_nonce;
         config_nonce = 0;
         state = STATE_SEND_PACKETS;
         break;
@@ -401,10 +414,20 @@ void PhoneAPI::handleDisconnect()
     LOG_INFO("PhoneAPI disconnect\n");
 }
 
+meshtastic_MeshPacket *PhoneAPI::getPacketForPhone()
+{
+    return service.getForPhone();
+}
+
+void PhoneAPI::releasePacketForPhone(meshtastic_MeshPacket *p)
+{
+    service.releaseToPool(p);
+}
+
 void PhoneAPI::releasePhonePacket()
 {
     if (packetForPhone) {
-        service.releaseToPool(packetForPhone); // we just copied the bytes, so don't need this buffer anymore
+        releasePacketForPhone(packetForPhone); // we just copied the bytes, so don't need this buffer anymore
         packetForPhone = NULL;
     }
 }
@@ -444,12 +467,20 @@ bool PhoneAPI::available()
 
     case STATE_SEND_OTHER_NODEINFOS:
         if (nodeInfoForPhone.num == 0) {
-            auto nextNode = nodeDB->readNextMeshNode(readIndex);
+            auto nextNode =
+                syncSince ? nodeDB->readNextChangedMeshNode(readIndex, syncSince) : nodeDB->readNextMeshNode(readIndex);
             if (nextNode) {
                 nodeInfoForPhone = TypeConversions::ConvertToNodeInfo(nextNode);
                 nodeInfoForPhone.hops_away = nodeInfoForPhone.num == nodeDB->getNodeNum() ? 0 : nodeInfoForPhone.hops_away;
                 nodeInfoForPhone.is_favorite =
                     nodeInfoForPhone.is_favorite || nodeInfoForPhone.num == nodeDB->getNodeNum(); // Our node is always a favorite
+            } else if (syncSince) {
+                // Once the changed nodes are out, tell the client which nodes it should forget about
+                NodeNum removed = nodeDB->readNextRemovedMeshNode(removedReadIndex, syncSince);
+                if (removed) {
+                    nodeInfoForPhone = meshtastic_NodeInfo_init_default;
+                    nodeInfoForPhone.num = removed;
+                }
             }
         }
         return true; // Always say we have something, because we might need to advance our state machine
@@ -471,7 +502,7 @@ bool PhoneAPI::available()
         }
 
         if (!packetForPhone)
-            packetForPhone = service.getForPhone();
+            packetForPhone = getPacketForPhone();
         hasPacket = !!packetForPhone;
         // LOG_DEBUG("available hasPacket=%d\n", hasPacket);
         return hasPacket;
@@ -8,6 +8,16 @@
 #define MAX_TO_FROM_RADIO_SIZE 512
 #define SPECIAL_NONCE 69420
 
+/*
+Clients that want an incremental NodeDB sync send want_config_since instead of want_config_id, with the token from the
+low bits of the config_complete_id they got at the end of their last sync (or 0 to ask for a full sync plus a token).  If
+the token is still usable we only send the nodeinfos that changed since then, followed by a nodeinfo with nothing but the
+node number set for each node that was removed, and set NODEDB_SYNC_DELTA in the config_complete_id.  If the token is
+stale (e.g. we rebooted) they get a full sync, without NODEDB_SYNC_DELTA.  Either way the rest of it is the new token.
+Clients sending want_config_id get a full sync and their nonce back, as always.
+*/
+#define NODEDB_SYNC_DELTA 0x01000000
+
 /**
  * Provides our protobuf based API which phone/PC clients can use to talk to our device
  * over UDP, bluetooth or serial.
@@ -65,7 +75,17 @@ class PhoneAPI
     uint32_t config_nonce = 0;
     uint32_t readIndex = 0;
 
-    void resetReadIndex() { readIndex = 0; }
+    /// Incremental NodeDB sync state, see NODEDB_SYNC_DELTA
+    bool sendSyncToken = false;
+    uint32_t syncSince = 0;      // Only send nodes changed after this NodeDB generation, 0 to send all of them
+    uint32_t syncGeneration = 0; // The NodeDB generation when this config download started
+    uint32_t removedReadIndex = 0;
+
+    void resetReadIndex()
+    {
+        readIndex = 0;
+        removedReadIndex = 0;
+    }
 
   public:
     PhoneAPI();
@@ -126,6 +146,11 @@ class PhoneAPI
      */
     virtual void handleDisconnect();
 
+    /// Where we get mesh packets destined for the phone from.  Subclasses which share the phone queue between several clients
+    /// can override these.
+    virtual meshtastic_MeshPacket *getPacketForPhone();
+    virtual void releasePacketForPhone(meshtastic_MeshPacket *p);
+
   private:
     void releasePhonePacket();
 
@@ -133,8 +158,8 @@ class PhoneAPI
 
     void releaseMqttClientProxyPhonePacket();
 
-    /// begin a new connection
-    void handleStartConfig();
+    /// begin a new connection, wantSync if the client asked for an incremental NodeDB sync since that token
+    void handleStartConfig(bool wantSync = false, uint32_t since = 0);
 
     /**
      * Handle a packet that the phone wants us to send.  We can write to it but can not keep a reference to it
@@ -0,0 +1,115 @@
+#include "PositionDelta.h"
+#include <string.h>
+
+static size_t putVarint(uint8_t *buf, size_t pos, size_t bufSize, int32_t value)
+{
+    uint32_t v = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); // zigzag, so small negative numbers stay small
+    do {
+        if (pos >= bufSize)
+            return 0;
+        buf[pos++] = (v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+        v >>= 7;
+    } while (v);
+    return pos;
+}
+
+static size_t getVarint(const uint8_t *buf, size_t pos, size_t len, int32_t &value)
+{
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= len)
+            return 0;
+        uint8_t b = buf[pos++];
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            value = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+            return pos;
+        }
+    }
+    return 0;
+}
+
+bool makePositionDelta(const meshtastic_Position &keyframe, const meshtastic_Position &p, PositionDelta &d)
+{
+    if (!keyframe.seq_number || p.precision_bits != keyframe.precision_bits)
+        return false;
+
+    int64_t dLat = (int64_t)p.latitude_i - keyframe.latitude_i;
+    int64_t dLon = (int64_t)p.longitude_i - keyframe.longitude_i;
+    if (dLat > POSITION_DELTA_MAX || dLat < -POSITION_DELTA_MAX || dLon > POSITION_DELTA_MAX || dLon < -POSITION_DELTA_MAX)
+        return false;
+
+    memset(&d, 0, sizeof(d));
+    d.keyframe = keyframe.seq_number & 0xff;
+    d.latitude = dLat;
+    d.longitude = dLon;
+    if (p.altitude || keyframe.altitude) {
+        d.flags |= POSITION_DELTA_HAS_ALTITUDE;
+        d.altitude = p.altitude - keyframe.altitude;
+    }
+    if (p.time && keyframe.time) {
+        d.flags |= POSITION_DELTA_HAS_TIME;
+        d.time = p.time - keyframe.time;
+    }
+    return true;
+}
+
+bool applyPositionDelta(const meshtastic_PositionLite &keyframe, uint32_t precisionBits, const PositionDelta &d,
+                        meshtastic_Position &p)
+{
+    // In 1e-7 degrees
+    int64_t lat = (int64_t)keyframe.latitude_i + d.latitude;
+    int64_t lon = (int64_t)keyframe.longitude_i + d.longitude;
+    if (lat > 900000000 || lat < -900000000 || lon > 1800000000 || lon < -1800000000)
+        return false;
+
+    p = meshtastic_Position_init_default;
+    p.latitude_i = lat;
+    p.longitude_i = lon;
+    p.altitude = keyframe.altitude + d.altitude;
+    if (d.flags & POSITION_DELTA_HAS_TIME)
+        p.time = keyframe.time + d.time;
+    p.location_source = keyframe.location_source;
+    p.precision_bits = precisionBits;
+    return true;
+}
+
+size_t encodePositionDelta(const PositionDelta &d, uint8_t *buf, size_t bufSize)
+{
+    if (bufSize < 2)
+        return 0;
+    buf[0] = d.keyframe;
+    buf[1] = d.flags;
+
+    size_t pos = putVarint(buf, 2, bufSize, d.latitude);
+    if (pos)
+        pos = putVarint(buf, pos, bufSize, d.longitude);
+    if (pos && (d.flags & POSITION_DELTA_HAS_ALTITUDE))
+        pos = putVarint(buf, pos, bufSize, d.altitude);
+    if (pos && (d.flags & POSITION_DELTA_HAS_TIME))
+        pos = putVarint(buf, pos, bufSize, d.time);
+    return pos;
+}
+
+bool decodePositionDelta(const uint8_t *buf, size_t len, PositionDelta &d)
+{
+    memset(&d, 0, sizeof(d));
+    if (len < 2 || (buf[1] & ~(POSITION_DELTA_HAS_ALTITUDE | POSITION_DELTA_HAS_TIME)))
+        return false;
+    d.keyframe = buf[0];
+    d.flags = buf[1];
+
+    size_t pos = getVarint(buf, 2, len, d.latitude);
+    if (pos)
+        pos = getVarint(buf, pos, len, d.longitude);
+    if (pos && (d.flags & POSITION_DELTA_HAS_ALTITUDE))
+        pos = getVarint(buf, pos, len, d.altitude);
+    if (pos && (d.flags & POSITION_DELTA_HAS_TIME))
+        pos = getVarint(buf, pos, len, d.time);
+    if (pos != len)
+        return false;
+
+    // makePositionDelta() never goes further than this, anything else is garbage
+    return d.latitude <= POSITION_DELTA_MAX && d.latitude >= -POSITION_DELTA_MAX && d.longitude <= POSITION_DELTA_MAX &&
+           d.longitude >= -POSITION_DELTA_MAX;
+}
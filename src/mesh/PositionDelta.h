@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mesh-pb-constants.h"
+
+// Position broadcasts between the periodic ones are sent as compact positions (PositionDelta) relative to the last full one
+// where they can be, and NodeDB keeps the keyframes of the nodes which send them.  Off unless enabled in the build, because
+// older firmware only understands the full ones
+#ifndef POSITION_COMPACT_DELTAS
+#define POSITION_COMPACT_DELTAS 0
+#endif
+
+// The port compact positions go out on.  It has no upstream PortNum yet, so it sits in the private range (>= 256)
+#define POSITION_DELTA_PORTNUM ((meshtastic_PortNum)300)
+
+// How far (in 1e-7 degrees, about 10 km) a compact position may be from its keyframe, so each delta fits in three bytes
+#define POSITION_DELTA_MAX ((1 << 20) - 1)
+
+/**
+ * A compact position, sent on POSITION_DELTA_PORTNUM instead of a full Position by a node which tracks something that moves a
+ * little at a time.  It only holds the difference from the last full Position the node sent on the primary channel (the
+ * keyframe), which is all NodeDB needs to know where the node is now.  The position rebuilt from it has the keyframe's
+ * precision and location source, but none of the rest (DOP, satellites, speed...), which the keyframe's may no longer match.
+ *
+ * On the wire: the low byte of the keyframe's seq_number, a flags byte, then the differences as zigzag varints: latitude,
+ * longitude, altitude if POSITION_DELTA_HAS_ALTITUDE and seconds since the keyframe's time if POSITION_DELTA_HAS_TIME.
+ */
+struct PositionDelta {
+    uint8_t keyframe;
+    uint8_t flags;
+    int32_t latitude;
+    int32_t longitude;
+    int32_t altitude;
+    int32_t time;
+};
+
+#define POSITION_DELTA_HAS_ALTITUDE 0x01
+#define POSITION_DELTA_HAS_TIME 0x02
+
+/// @return false if p can't be sent relative to keyframe (it is too far off, or of another precision), send it in full then
+bool makePositionDelta(const meshtastic_Position &keyframe, const meshtastic_Position &p, PositionDelta &d);
+
+/**
+ * Apply d to the keyframe it was made from, which was sent with precisionBits
+ * @return false if that doesn't give a valid latitude and longitude
+ */
+bool applyPositionDelta(const meshtastic_PositionLite &keyframe, uint32_t precisionBits, const PositionDelta &d,
+                        meshtastic_Position &p);
+
+/// @return how many bytes d took in buf, 0 if it didn't fit
+size_t encodePositionDelta(const PositionDelta &d, uint8_t *buf, size_t bufSize);
+
+/// @return false if buf isn't a compact position we understand
+bool decodePositionDelta(const uint8_t *buf, size_t len, PositionDelta &d);
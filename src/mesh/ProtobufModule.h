@@ -1,4 +1,5 @@
 #pragma once
+#include "DecodedPayloadCache.h"
 #include "SinglePortModule.h"
 
 /**
@@ -78,10 +79,8 @@ template <class T> class ProtobufModule : protected SinglePortModule
         T scratch;
         T *decoded = NULL;
         if (mp.which_payload_variant == meshtastic_MeshPacket_decoded_tag && mp.decoded.portnum == ourPortNum) {
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(p.payload.bytes, p.payload.size, fields, &scratch)) {
-                decoded = &scratch;
-            } else {
+            decoded = DecodedPayloadCache::decode(mp, fields, scratch);
+            if (!decoded) {
                 LOG_ERROR("Error decoding protobuf module!\n");
                 // if we can't decode it, nobody can process it!
                 return ProcessMessage::STOP;
@@ -98,17 +97,16 @@ template <class T> class ProtobufModule : protected SinglePortModule
         T scratch;
         T *decoded = NULL;
         if (mp.which_payload_variant == meshtastic_MeshPacket_decoded_tag && mp.decoded.portnum == ourPortNum) {
-            memset(&scratch, 0, sizeof(scratch));
-            auto &p = mp.decoded;
-            if (pb_decode_from_bytes(p.payload.bytes, p.payload.size, fields, &scratch)) {
-                decoded = &scratch;
-            } else {
+            decoded = DecodedPayloadCache::decode(mp, fields, scratch);
+            if (!decoded) {
                 LOG_ERROR("Error decoding protobuf module!\n");
                 // if we can't decode it, nobody can process it!
                 return;
             }
 
-            return alterReceivedProtobuf(mp, decoded);
+            alterReceivedProtobuf(mp, decoded);
+            // We may have changed the payload, or the message we decoded it into
+            DecodedPayloadCache::invalidate();
         }
     }
 };
\ No newline at end of file
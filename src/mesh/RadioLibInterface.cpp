@@ -394,6 +394,8 @@ void RadioLibInterface::handleReceiveInterrupt()
             mp->hop_start = (h->flags & PACKET_FLAGS_HOP_START_MASK) >> PACKET_FLAGS_HOP_START_SHIFT;
             mp->want_ack = !!(h->flags & PACKET_FLAGS_WANT_ACK_MASK);
             mp->via_mqtt = !!(h->flags & PACKET_FLAGS_VIA_MQTT_MASK);
+            mp->next_hop = h->next_hop;
+            mp->relay_node = h->relay_node;
 
             addReceiveMetadata(mp);
 
@@ -33,7 +33,7 @@ ErrorCode ReliableRouter::send(meshtastic_MeshPacket *p)
         }
     }
 
-    return FloodingRouter::send(p);
+    return NextHopRouter::send(p);
 }
 
 bool ReliableRouter::shouldFilterReceived(const meshtastic_MeshPacket *p)
@@ -83,7 +83,7 @@ bool ReliableRouter::shouldFilterReceived(const meshtastic_MeshPacket *p)
         Router::send(tosend);
     }
 
-    return FloodingRouter::shouldFilterReceived(p);
+    return NextHopRouter::shouldFilterReceived(p);
 }
 
 /**
@@ -134,7 +134,7 @@ void ReliableRouter::sniffReceived(const meshtastic_MeshPacket *p, const meshtas
     }
 
     // handle the packet as normal
-    FloodingRouter::sniffReceived(p, c);
+    NextHopRouter::sniffReceived(p, c);
 }
 
 #define NUM_RETRANSMISSIONS 3
@@ -227,9 +227,10 @@ int32_t ReliableRouter::doRetransmissions()
                 LOG_DEBUG("Sending reliable retransmission fr=0x%x,to=0x%x,id=0x%x, tries left=%d\n", p.packet->from,
                           p.packet->to, p.packet->id, p.numRetransmissions);
 
-                // Note: we call the superclass version because we don't want to have our version of send() add a new
-                // retransmission record
+                // Note: we call the FloodingRouter version because we don't want to have our version of send() add a new
+                // retransmission record, nor NextHopRouter direct it again: the copy has no next hop, so the retry is a flood
                 FloodingRouter::send(packetPool.allocCopy(*p.packet));
+                stats.retransmissions++;
 
                 // Queue again
                 --p.numRetransmissions;
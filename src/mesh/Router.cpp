@@ -1,7 +1,9 @@
 #include "Router.h"
 #include "Channels.h"
 #include "CryptoEngine.h"
+#include "DecodedPayloadCache.h"
 #include "MeshRadio.h"
+#include "MeshTopology.h"
 #include "NodeDB.h"
 #include "RTC.h"
 #include "configuration.h"
@@ -238,6 +240,9 @@ ErrorCode Router::send(meshtastic_MeshPacket *p)
     // the lora we need to make sure we have replaced it with our local address
     p->from = getFrom(p);
 
+    // Whoever hears this knows it came from us, even if we are only relaying it
+    p->relay_node = getNodeNum() & 0xff;
+
     // If we are the original transmitter, set the hop limit with which we start
     if (p->from == getNodeNum())
         p->hop_start = p->hop_limit;
@@ -261,6 +266,7 @@ ErrorCode Router::send(meshtastic_MeshPacket *p)
 #if !MESHTASTIC_EXCLUDE_MQTT
         // Only publish to MQTT if we're the original transmitter of the packet
         if (moduleConfig.mqtt.enabled && p->from == nodeDB->getNodeNum() && mqtt) {
+            DecodedPayloadScope payloadScope(*p_decoded);
             mqtt->onSend(*p, *p_decoded, chIndex);
         }
 #endif
@@ -460,6 +466,9 @@ void Router::handleReceived(meshtastic_MeshPacket *p, RxSource src)
         else
             printPacket("handleReceived(REMOTE)", p);
 
+        if (src == RX_SRC_RADIO && meshTopology)
+            meshTopology->onPacketHeard(*p);
+
         // Neighbor info module is disabled, ignore expensive neighbor info packets
         if (p->which_payload_variant == meshtastic_MeshPacket_decoded_tag &&
             p->decoded.portnum == meshtastic_PortNum_NEIGHBORINFO_APP &&
@@ -474,6 +483,8 @@ void Router::handleReceived(meshtastic_MeshPacket *p, RxSource src)
 
     // call modules here
     if (!skipHandle) {
+        // Let MQTT reuse whatever the modules decoded
+        DecodedPayloadScope payloadScope(*p);
         MeshModule::callModules(*p, src);
 
 #if !MESHTASTIC_EXCLUDE_MQTT
@@ -82,9 +82,29 @@ class Router : protected concurrency::OSThread
      */
     virtual ErrorCode send(meshtastic_MeshPacket *p);
 
+    /**
+     * @return true if we have already seen this packet, so it would be dropped as a duplicate.  Doesn't record the packet, so
+     * it is cheap to ask before bothering to allocate or decode a copy
+     */
+    virtual bool isDuplicate(const meshtastic_MeshPacket *p) { return false; }
+
+    /// Counters for metrics, kept up to date as packets pass through
+    struct Stats {
+        uint32_t duplicates;            // received packets dropped because we had already seen them
+        uint32_t retransmissions;       // reliable packets we had to send again because no ack came
+        uint32_t directed;              // unicast packets we sent or relayed to a single next hop instead of flooding them
+        uint32_t directedFallbacks;     // directed packets we flooded after all, because their next hop didn't relay them
+        uint32_t relaysSkipped;         // directed packets we didn't relay, because they were for another next hop
+        uint32_t relayAirtimeSavedMsec; // the airtime those relays would have taken
+    };
+
+    const Stats &getStats() const { return stats; }
+
   protected:
     friend class RoutingModule;
 
+    Stats stats = {};
+
     /**
      * Should this incoming filter be dropped?
      *
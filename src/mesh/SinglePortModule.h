@@ -23,6 +23,9 @@ class SinglePortModule : public MeshModule
      */
     virtual bool wantPacket(const meshtastic_MeshPacket *p) override { return p->decoded.portnum == ourPortNum; }
 
+    /// Subclasses which override wantPacket() to accept other portnums as well must return ANY_PORTNUM instead
+    virtual int getDispatchPortNum() override { return ourPortNum; }
+
     /**
      * Return a mesh packet which has been preinited as a data packet with a particular port number.
      * You can then send this packet (after customizing any of the payload fields you might need) with
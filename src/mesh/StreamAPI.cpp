@@ -1,6 +1,7 @@
 #include "StreamAPI.h"
 #include "PowerFSM.h"
 #include "configuration.h"
+#include <algorithm>
 
 #define START1 0x94
 #define START2 0xc3
@@ -14,6 +15,15 @@ int32_t StreamAPI::runOncePart()
     return result;
 }
 
+/// Fill in the 4 byte framing header for a packet of len bytes
+static void writeHeader(uint8_t *buf, size_t len)
+{
+    buf[0] = START1;
+    buf[1] = START2;
+    buf[2] = (len >> 8) & 0xff;
+    buf[3] = len & 0xff;
+}
+
 /**
  * Read any rx chars from the link and call handleToRadio
  */
@@ -25,48 +35,15 @@ int32_t StreamAPI::readStream()
         bool recentRx = (now - lastRxMsec) < 2000;
         return recentRx ? 5 : 250;
     } else {
-        while (stream->available()) { // Currently we never want to block
-            int cInt = stream->read();
-            if (cInt < 0)
+        uint8_t chunk[STREAM_RX_CHUNK_SIZE];
+        int avail;
+        while ((avail = stream->available()) > 0) { // Currently we never want to block, so never ask for more than is available
+            size_t n = stream->readBytes((char *)chunk, std::min((size_t)avail, sizeof(chunk)));
+            if (n == 0)
                 break; // We ran out of characters (even though available said otherwise) - this can happen on rf52 adafruit
                        // arduino
 
-            uint8_t c = (uint8_t)cInt;
-
-            // Use the read pointer for a little state machine, first look for framing, then length bytes, then payload
-            size_t ptr = rxPtr;
-
-            rxPtr++;        // assume we will probably advance the rxPtr
-            rxBuf[ptr] = c; // store all bytes (including framing)
-
-            // console->printf("rxPtr %d ptr=%d c=0x%x\n", rxPtr, ptr, c);
-
-            if (ptr == 0) { // looking for START1
-                if (c != START1)
-                    rxPtr = 0;     // failed to find framing
-            } else if (ptr == 1) { // looking for START2
-                if (c != START2)
-                    rxPtr = 0;                             // failed to find framing
-            } else if (ptr >= HEADER_LEN - 1) {            // we have at least read our 4 byte framing
-                uint32_t len = (rxBuf[2] << 8) + rxBuf[3]; // big endian 16 bit length follows framing
-
-                // console->printf("len %d\n", len);
-
-                if (ptr == HEADER_LEN - 1) {
-                    // we _just_ finished our 4 byte header, validate length now (note: a length of zero is a valid
-                    // protobuf also)
-                    if (len > MAX_TO_FROM_RADIO_SIZE)
-                        rxPtr = 0; // length is bogus, restart search for framing
-                }
-
-                if (rxPtr != 0)                        // Is packet still considered 'good'?
-                    if (ptr + 1 >= len + HEADER_LEN) { // have we received all of the payload?
-                        rxPtr = 0;                     // start over again on the next packet
-
-                        // If we didn't just fail the packet and we now have the right # of bytes, parse it
-                        handleToRadio(rxBuf + HEADER_LEN, len);
-                    }
-            }
+            handleRxBytes(chunk, n);
         }
 
         // we had bytes available this time, so assume we might have them next time also
@@ -75,6 +52,55 @@ int32_t StreamAPI::readStream()
     }
 }
 
+/**
+ * A little state machine, first look for framing, then length bytes, then payload.  rxPtr is how much of the current packet
+ * (including framing) we have in rxBuf.
+ */
+void StreamAPI::handleRxBytes(const uint8_t *buf, size_t len)
+{
+    while (len) {
+        if (rxPtr == 0) {
+            // Looking for START1, skip any junk (i.e. debug output or line noise) in one go
+            const uint8_t *start = (const uint8_t *)memchr(buf, START1, len);
+            if (!start)
+                return; // no framing anywhere in this chunk
+
+            len -= (start - buf) + 1;
+            buf = start + 1;
+            rxBuf[rxPtr++] = START1;
+        } else if (rxPtr < HEADER_LEN) {
+            uint8_t c = *buf++;
+            len--;
+            rxBuf[rxPtr++] = c; // store all bytes (including framing)
+
+            if (rxPtr == 2 && c != START2) {
+                rxPtr = 0; // failed to find framing
+            } else if (rxPtr == HEADER_LEN) {
+                // we _just_ finished our 4 byte header, validate length now (note: a length of zero is a valid
+                // protobuf also)
+                uint32_t pktLen = (rxBuf[2] << 8) + rxBuf[3]; // big endian 16 bit length follows framing
+                if (pktLen > MAX_TO_FROM_RADIO_SIZE)
+                    rxPtr = 0; // length is bogus, restart search for framing
+            }
+        }
+
+        if (rxPtr >= HEADER_LEN) {
+            // Copy as much of the payload as this chunk holds
+            uint32_t pktLen = (rxBuf[2] << 8) + rxBuf[3];
+            size_t n = std::min((size_t)(pktLen + HEADER_LEN - rxPtr), len);
+            memcpy(rxBuf + rxPtr, buf, n);
+            rxPtr += n;
+            buf += n;
+            len -= n;
+
+            if (rxPtr == pktLen + HEADER_LEN) { // have we received all of the payload?
+                rxPtr = 0;                      // start over again on the next packet
+                handleToRadio(rxBuf + HEADER_LEN, pktLen);
+            }
+        }
+    }
+}
+
 /**
  * call getFromRadio() and deliver encapsulated packets to the Stream
  */
@@ -82,11 +108,26 @@ void StreamAPI::writeStream()
 {
     if (canWrite) {
         uint32_t len;
+        size_t batchLen = 0;
+        bool wrote = false;
         do {
-            // Send every packet we can
-            len = getFromRadio(txBuf + HEADER_LEN);
-            emitTxBuffer(len);
+            // Send every packet we can, packing as many framed packets into each write as txBuf holds
+            len = getFromRadio(txBuf + batchLen + HEADER_LEN);
+            if (len != 0) {
+                writeHeader(txBuf + batchLen, len);
+                batchLen += len + HEADER_LEN;
+            }
+
+            if (batchLen != 0 && (len == 0 || batchLen + MAX_STREAM_BUF_SIZE > sizeof(txBuf))) {
+                stream->write(txBuf, batchLen);
+                batchLen = 0;
+                wrote = true;
+            }
         } while (len);
+
+        // Only flush once per batch of packets, not for every packet
+        if (wrote)
+            stream->flush();
     }
 }
 
@@ -97,10 +138,7 @@ void StreamAPI::emitTxBuffer(size_t len)
 {
     if (len != 0) {
         // LOG_DEBUG("emit tx %d\n", len);
-        txBuf[0] = START1;
-        txBuf[1] = START2;
-        txBuf[2] = (len >> 8) & 0xff;
-        txBuf[3] = len & 0xff;
+        writeHeader(txBuf, len);
 
         auto totalLen = len + HEADER_LEN;
         stream->write(txBuf, totalLen);
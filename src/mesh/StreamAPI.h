@@ -7,6 +7,21 @@
 // A To/FromRadio packet + our 32 bit header
 #define MAX_STREAM_BUF_SIZE (MAX_TO_FROM_RADIO_SIZE + sizeof(uint32_t))
 
+// How many FromRadio packets we try to pack into each write/flush of the stream.  Each one costs MAX_STREAM_BUF_SIZE of RAM
+// per StreamAPI instance, so only batch on targets with RAM to spare.
+#ifndef STREAM_TX_BATCH_PACKETS
+#if defined(ARCH_PORTDUINO) || defined(ARCH_ESP32)
+#define STREAM_TX_BATCH_PACKETS 4
+#else
+#define STREAM_TX_BATCH_PACKETS 1
+#endif
+#endif
+
+// How many bytes we pull from the stream with each bulk read
+#ifndef STREAM_RX_CHUNK_SIZE
+#define STREAM_RX_CHUNK_SIZE 128
+#endif
+
 /**
  * A version of our 'phone' API that talks over a Stream.  So therefore well suited to use with serial links
  * or TCP connections.
@@ -41,6 +56,9 @@ class StreamAPI : public PhoneAPI
     /// time of last rx, used, to slow down our polling if we haven't heard from anyone
     uint32_t lastRxMsec = 0;
 
+    /// Run a chunk of received bytes through our framing state machine, calling handleToRadio for each complete packet
+    void handleRxBytes(const uint8_t *buf, size_t len);
+
   public:
     StreamAPI(Stream *_stream) : stream(_stream) {}
 
@@ -80,6 +98,6 @@ class StreamAPI : public PhoneAPI
     /// Are we allowed to write packets to our output stream (subclasses can turn this off - i.e. SerialConsole)
     bool canWrite = true;
 
-    /// Subclasses can use this scratch buffer if they wish
-    uint8_t txBuf[MAX_STREAM_BUF_SIZE] = {0};
+    /// Subclasses can use this scratch buffer if they wish.  writeStream() also uses it to batch several framed packets
+    uint8_t txBuf[MAX_STREAM_BUF_SIZE * STREAM_TX_BATCH_PACKETS] = {0};
 };
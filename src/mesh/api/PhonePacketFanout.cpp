@@ -0,0 +1,99 @@
+#include "PhonePacketFanout.h"
+#include "MeshService.h"
+#include "configuration.h"
+
+PhonePacketFanout apiPacketFanout;
+
+int PhonePacketFanout::attach()
+{
+    for (int slot = 0; slot < API_FANOUT_SLOTS; slot++) {
+        if (!attached[slot]) {
+            attached[slot] = true;
+            cursors[slot] = head;
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void PhonePacketFanout::detach(int slot)
+{
+    if (slot < 0 || !attached[slot])
+        return;
+
+    // Give up our claim on everything we haven't read yet
+    for (uint32_t seq = cursors[slot]; seq != head; seq++)
+        unref(seq);
+    attached[slot] = false;
+    trim();
+}
+
+meshtastic_MeshPacket *PhonePacketFanout::get(int slot)
+{
+    fill();
+
+    if (cursors[slot] == head)
+        return NULL;
+
+    return ring[cursors[slot]++ % MAX_RX_TOPHONE].p;
+}
+
+void PhonePacketFanout::release(meshtastic_MeshPacket *p)
+{
+    for (uint32_t seq = tail; seq != head; seq++) {
+        if (ring[seq % MAX_RX_TOPHONE].p == p) {
+            unref(seq);
+            trim();
+            return;
+        }
+    }
+    LOG_ERROR("Released a packet which isn't in the API fanout\n");
+}
+
+void PhonePacketFanout::fill()
+{
+    while (!service.isToPhoneQueueEmpty()) {
+        if (head - tail == MAX_RX_TOPHONE) {
+            // Our ring is full, skip any client which still hasn't read the oldest packet so it can't stall the others
+            for (int slot = 0; slot < API_FANOUT_SLOTS; slot++) {
+                if (attached[slot] && cursors[slot] == tail) {
+                    LOG_WARN("API client %d is too slow, dropping its oldest packet\n", slot);
+                    cursors[slot]++;
+                    unref(tail);
+                }
+            }
+            trim();
+            if (head - tail == MAX_RX_TOPHONE)
+                break; // the oldest packet is still being sent to some client
+        }
+
+        meshtastic_MeshPacket *p = service.getForPhone();
+        if (!p)
+            break;
+        ring[head++ % MAX_RX_TOPHONE] = {p, numAttached()};
+    }
+}
+
+void PhonePacketFanout::unref(uint32_t seq)
+{
+    Entry &e = ring[seq % MAX_RX_TOPHONE];
+    assert(e.refs > 0);
+    e.refs--;
+}
+
+void PhonePacketFanout::trim()
+{
+    while (tail != head && ring[tail % MAX_RX_TOPHONE].refs == 0) {
+        service.releaseToPool(ring[tail % MAX_RX_TOPHONE].p);
+        ring[tail++ % MAX_RX_TOPHONE].p = NULL;
+    }
+}
+
+uint8_t PhonePacketFanout::numAttached()
+{
+    uint8_t n = 0;
+    for (int slot = 0; slot < API_FANOUT_SLOTS; slot++)
+        if (attached[slot])
+            n++;
+    return n;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include "configuration.h"
+#include "mesh-pb-constants.h"
+
+// How many TCP API clients may be connected at once, beyond that the oldest connection gets kicked
+#ifndef MAX_API_CLIENTS
+#ifdef ARCH_PORTDUINO
+#define MAX_API_CLIENTS 4
+#else
+#define MAX_API_CLIENTS 1
+#endif
+#endif
+
+// How many websocket clients the Pi web server may have connected at once
+#ifndef MAX_WEBSOCKET_CLIENTS
+#define MAX_WEBSOCKET_CLIENTS 4
+#endif
+
+// Every API server which shares the fanout (TCP, and on portduino the local Unix socket and the web server's websockets) needs
+// a slot for each client it may have
+#if HAS_UNIX_SOCKET_API
+#define API_FANOUT_UNIX_SLOTS MAX_API_CLIENTS
+#else
+#define API_FANOUT_UNIX_SLOTS 0
+#endif
+#ifdef PORTDUINO_LINUX_HARDWARE
+#define API_FANOUT_WEBSOCKET_SLOTS MAX_WEBSOCKET_CLIENTS
+#else
+#define API_FANOUT_WEBSOCKET_SLOTS 0
+#endif
+#define API_FANOUT_SLOTS (MAX_API_CLIENTS + API_FANOUT_UNIX_SLOTS + API_FANOUT_WEBSOCKET_SLOTS)
+
+/**
+ * Shares the packets destined for the phone between several simultaneously connected API clients.
+ *
+ * Each packet is pulled from MeshService once and handed to every attached client by pointer, it goes back to the packet pool
+ * once every client has sent (or skipped) it.  Every client has its own read position, so a slow client only holds up
+ * itself: if it falls MAX_RX_TOPHONE packets behind it misses the oldest ones instead of stalling everyone else.
+ */
+class PhonePacketFanout
+{
+    struct Entry {
+        meshtastic_MeshPacket *p;
+        uint8_t refs; // number of clients which have not yet released (or skipped) this packet
+    };
+
+    Entry ring[MAX_RX_TOPHONE] = {};
+
+    /// Sequence numbers of the oldest packet we still hold and of the next packet we will add, index = seq % MAX_RX_TOPHONE
+    uint32_t tail = 0, head = 0;
+
+    /// The sequence number of the next packet each client will read
+    uint32_t cursors[API_FANOUT_SLOTS] = {};
+    bool attached[API_FANOUT_SLOTS] = {};
+
+  public:
+    /// Register a new client, it will see packets which arrive from now on.  @return its slot, or -1 if we are full
+    int attach();
+
+    /// Unregister a client, releasing any packets it has not read yet
+    void detach(int slot);
+
+    /// @return the next packet for this client, or NULL if there is none.  Must be given back with release()
+    meshtastic_MeshPacket *get(int slot);
+
+    /// The client is done with a packet returned by get()
+    void release(meshtastic_MeshPacket *p);
+
+  private:
+    /// Pull any new packets from MeshService into our ring
+    void fill();
+
+    /// Drop one reference to the packet with this sequence number
+    void unref(uint32_t seq);
+
+    /// Return packets nobody needs anymore to the pool
+    void trim();
+
+    uint8_t numAttached();
+};
+
+extern PhonePacketFanout apiPacketFanout;
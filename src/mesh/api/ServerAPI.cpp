@@ -1,16 +1,35 @@
 #include "ServerAPI.h"
 #include "configuration.h"
 #include <Arduino.h>
+#if HAS_EPOLL_REACTOR
+#include "platform/portduino/EpollReactor.h"
+#endif
+
+// How often we run when the reactor will wake us for any incoming data anyway (i.e. just to check for timeouts)
+#define SERVER_API_IDLE_MSEC 1000
 
 template <typename T>
 ServerAPI<T>::ServerAPI(T &_client) : StreamAPI(&client), concurrency::OSThread("ServerAPI"), client(_client)
 {
     LOG_INFO("Incoming wifi connection\n");
+    fanoutSlot = apiPacketFanout.attach();
+    if (fanoutSlot < 0) {
+        // Taking packets straight from MeshService would steal them from every other client
+        LOG_WARN("No room for another API client, closing the connection\n");
+        client.stop();
+    }
+#if HAS_EPOLL_REACTOR
+    epollReactor.watch(client.fd(), EPOLLIN | EPOLLRDHUP, this);
+#endif
 }
 
 template <typename T> ServerAPI<T>::~ServerAPI()
 {
-    client.stop();
+#if HAS_EPOLL_REACTOR
+    epollReactor.unwatch(client.fd());
+#endif
+    close(); // release any packet we hold back to the fanout, ~PhoneAPI can no longer reach our overrides
+    apiPacketFanout.detach(fanoutSlot);
 }
 
 template <typename T> void ServerAPI<T>::close()
@@ -25,10 +44,27 @@ template <typename T> bool ServerAPI<T>::checkIsConnected()
     return client.connected();
 }
 
+template <typename T> meshtastic_MeshPacket *ServerAPI<T>::getPacketForPhone()
+{
+    return fanoutSlot >= 0 ? apiPacketFanout.get(fanoutSlot) : NULL;
+}
+
+template <typename T> void ServerAPI<T>::releasePacketForPhone(meshtastic_MeshPacket *p)
+{
+    if (fanoutSlot >= 0)
+        apiPacketFanout.release(p);
+}
+
 template <class T> int32_t ServerAPI<T>::runOnce()
 {
     if (client.connected()) {
-        return StreamAPI::runOncePart();
+        int32_t result = StreamAPI::runOncePart();
+#if HAS_EPOLL_REACTOR
+        // Rearm our watch, if that works we'll be woken as soon as the client sends anything so there is no need to poll
+        if (epollReactor.watch(client.fd(), EPOLLIN | EPOLLRDHUP, this) && result > 0)
+            return SERVER_API_IDLE_MSEC;
+#endif
+        return result;
     } else {
         LOG_INFO("Client dropped connection, suspending API service\n");
         enabled = false; // we no longer need to run
@@ -36,8 +72,6 @@ template <class T> int32_t ServerAPI<T>::runOnce()
     }
 }
 
-template <class T, class U> APIServerPort<T, U>::APIServerPort(int port) : U(port), concurrency::OSThread("ApiServer") {}
-
 template <class T, class U> void APIServerPort<T, U>::init()
 {
     U::begin();
@@ -45,15 +79,31 @@ template <class T, class U> void APIServerPort<T, U>::init()
 
 template <class T, class U> int32_t APIServerPort<T, U>::runOnce()
 {
+    // Reap connections which have gone away, keeping the survivors in oldest first order
+    int numOpen = 0;
+    for (int i = 0; i < MAX_API_CLIENTS; i++) {
+        if (openAPIs[i] && !openAPIs[i]->isClientConnected()) {
+            delete openAPIs[i];
+            openAPIs[i] = NULL;
+        }
+        if (openAPIs[i])
+            openAPIs[numOpen++] = openAPIs[i];
+    }
+    for (int i = numOpen; i < MAX_API_CLIENTS; i++)
+        openAPIs[i] = NULL;
+
     auto client = U::available();
     if (client) {
-        // Close any previous connection (see FIXME in header file)
-        if (openAPI) {
-            LOG_INFO("Force closing previous TCP connection\n");
-            delete openAPI;
+        if (numOpen == MAX_API_CLIENTS) {
+            // Close the oldest connection to make room
+            LOG_INFO("Too many TCP connections, force closing the oldest one\n");
+            delete openAPIs[0];
+            for (int i = 1; i < MAX_API_CLIENTS; i++)
+                openAPIs[i - 1] = openAPIs[i];
+            numOpen--;
         }
 
-        openAPI = new T(client);
+        openAPIs[numOpen] = new T(client);
     }
 
     return 100; // only check occasionally for incoming connections
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "PhonePacketFanout.h"
 #include "StreamAPI.h"
 
 /**
@@ -11,6 +12,9 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
   private:
     T client;
 
+    /// Our slot in apiPacketFanout, or -1 if there was none left (we close the connection then)
+    int fanoutSlot;
+
   public:
     explicit ServerAPI(T &_client);
 
@@ -19,6 +23,9 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
     /// override close to also shutdown the TCP link
     virtual void close();
 
+    /// @return true while the TCP link is still up
+    bool isClientConnected() { return client.connected(); }
+
   protected:
     /// We override this method to prevent publishing EVENT_SERIAL_CONNECTED/DISCONNECTED for wifi links (we want the board to
     /// stay in the POWERED state to prevent disabling wifi)
@@ -28,6 +35,13 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
 
     /// Check the current underlying physical link to see if the client is currently connected
     virtual bool checkIsConnected() override;
+
+    /// Run right away to send the new packets, rather than waiting for our next poll
+    virtual void onNowHasData(uint32_t fromRadioNum) override { setInterval(0); }
+
+    /// Mesh packets are shared with any other connected TCP clients
+    virtual meshtastic_MeshPacket *getPacketForPhone() override;
+    virtual void releasePacketForPhone(meshtastic_MeshPacket *p) override;
 };
 
 /**
@@ -35,15 +49,16 @@ template <class T> class ServerAPI : public StreamAPI, private concurrency::OSTh
  */
 template <class T, class U> class APIServerPort : public U, private concurrency::OSThread
 {
-    /** The currently open port
+    /** The currently open connections, oldest first
      *
-     * FIXME: We currently only allow one open TCP connection at a time, because we depend on the loop() call in this class to
-     * delegate to the worker.  Once coroutines are implemented we can relax this restriction.
+     * Each connection is its own OSThread and gets its own PhoneAPI state.  Once MAX_API_CLIENTS are connected, a new
+     * connection kicks the oldest one.
      */
-    T *openAPI = NULL;
+    T *openAPIs[MAX_API_CLIENTS] = {};
 
   public:
-    explicit APIServerPort(int port);
+    /// Our arguments are passed on to the listening server (i.e. the TCP port number)
+    template <typename... Args> explicit APIServerPort(Args... args) : U(args...), concurrency::OSThread("ApiServer") {}
 
     void init();
 
@@ -1,15 +1,20 @@
 #if !MESHTASTIC_EXCLUDE_WEBSERVER
+#include "MeshTopology.h"
 #include "NodeDB.h"
+#include "NodeDBExport.h"
+#include "OpenMetrics.h"
 #include "PowerFSM.h"
 #include "RadioLibInterface.h"
 #include "airtime.h"
 #include "main.h"
 #include "mesh/http/ContentHelper.h"
+#include "mesh/http/FsDeleteJob.h"
 #include "mesh/http/WebServer.h"
 #if !MESHTASTIC_EXCLUDE_WIFI
 #include "mesh/wifi/WiFiAPClient.h"
 #endif
 #include "mqtt/JSON.h"
+#include "mqtt/JSONWriter.h"
 #include "power.h"
 #include "sleep.h"
 #include <FSCommon.h>
@@ -92,8 +97,12 @@ void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
     ResourceNode *nodeJsonScanNetworks = new ResourceNode("/json/scanNetworks", "GET", &handleScanNetworks);
     ResourceNode *nodeJsonBlinkLED = new ResourceNode("/json/blink", "POST", &handleBlinkLED);
     ResourceNode *nodeJsonReport = new ResourceNode("/json/report", "GET", &handleReport);
+    ResourceNode *nodeMetrics = new ResourceNode("/metrics", "GET", &handleMetrics);
+    ResourceNode *nodeAPIv1Nodes = new ResourceNode("/api/v1/nodes", "GET", &handleNodes);
+    ResourceNode *nodeAPIv1Topology = new ResourceNode("/api/v1/topology", "GET", &handleTopology);
     ResourceNode *nodeJsonFsBrowseStatic = new ResourceNode("/json/fs/browse/static", "GET", &handleFsBrowseStatic);
     ResourceNode *nodeJsonDelete = new ResourceNode("/json/fs/delete/static", "DELETE", &handleFsDeleteStatic);
+    ResourceNode *nodeJsonDeleteProgress = new ResourceNode("/json/fs/delete/progress", "GET", &handleFsDeleteProgress);
 
     ResourceNode *nodeRoot = new ResourceNode("/*", "GET", &handleStatic);
 
@@ -109,7 +118,11 @@ void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
     secureServer->registerNode(nodeJsonBlinkLED);
     secureServer->registerNode(nodeJsonFsBrowseStatic);
     secureServer->registerNode(nodeJsonDelete);
+    secureServer->registerNode(nodeJsonDeleteProgress);
     secureServer->registerNode(nodeJsonReport);
+    secureServer->registerNode(nodeMetrics);
+    secureServer->registerNode(nodeAPIv1Nodes);
+    secureServer->registerNode(nodeAPIv1Topology);
     //    secureServer->registerNode(nodeUpdateFs);
     //    secureServer->registerNode(nodeDeleteFs);
     secureServer->registerNode(nodeAdmin);
@@ -130,7 +143,11 @@ void registerHandlers(HTTPServer *insecureServer, HTTPSServer *secureServer)
     insecureServer->registerNode(nodeJsonBlinkLED);
     insecureServer->registerNode(nodeJsonFsBrowseStatic);
     insecureServer->registerNode(nodeJsonDelete);
+    insecureServer->registerNode(nodeJsonDeleteProgress);
     insecureServer->registerNode(nodeJsonReport);
+    insecureServer->registerNode(nodeMetrics);
+    insecureServer->registerNode(nodeAPIv1Nodes);
+    insecureServer->registerNode(nodeAPIv1Topology);
     //    insecureServer->registerNode(nodeUpdateFs);
     //    insecureServer->registerNode(nodeDeleteFs);
     insecureServer->registerNode(nodeAdmin);
@@ -223,111 +240,136 @@ void handleAPIv1ToRadio(HTTPRequest *req, HTTPResponse *res)
     LOG_DEBUG("webAPI handleAPIv1ToRadio\n");
 }
 
-void htmlDeleteDir(const char *dirname)
-{
-    File root = FSCom.open(dirname);
-    if (!root) {
-        return;
+// How deep below /static the file browser looks
+#define FS_LIST_MAX_DEPTH 10
+
+/**
+ * Where we are in a streamed directory listing.  Directories are nested arrays, as before, but a directory's '[' is only
+ * written once we reach a file in it which is on the requested page, so skipped parts of the tree cost nothing.
+ */
+struct FsListing {
+    Print &out;
+    uint32_t offset, limit; // the page of files to list, limit 0 means all of them
+    uint32_t seen = 0;      // files walked past so far
+    bool more = false;      // we stopped because the page was full
+
+    uint8_t depth = 0;  // how deep the walk is right now, 0 is the "files" array itself
+    uint8_t opened = 0; // how many of those levels we have written the '[' for
+    bool first[FS_LIST_MAX_DEPTH + 1];
+
+    FsListing(Print &_out, uint32_t _offset, uint32_t _limit) : out(_out), offset(_offset), limit(_limit) { first[0] = true; }
+
+    void separate(uint8_t level)
+    {
+        if (!first[level])
+            out.print(',');
+        first[level] = false;
     }
-    if (!root.isDirectory()) {
-        return;
+
+    /// @return false once the page is full and the walk should stop
+    bool file(File &file)
+    {
+        if (seen++ < offset)
+            return true;
+        if (limit && seen > offset + limit) {
+            more = true;
+            return false;
+        }
+
+        while (opened < depth) {
+            separate(opened);
+            out.print('[');
+            first[++opened] = true;
+        }
+        separate(depth);
+
+        String name = String(file.path()).substring(1);
+        char buf[256];
+        JSONWriter w(buf, sizeof(buf));
+        w.beginObject();
+        w.key("name");
+        w.value(name.c_str());
+        if (name.endsWith(".gz")) {
+            name.remove(name.length() - 3, 3);
+            w.key("nameModified");
+            w.value(name.c_str());
+        }
+        w.key("size");
+        w.value((uint32_t)file.size());
+        w.endObject();
+        out.print(buf);
+        return true;
     }
 
-    File file = root.openNextFile();
-    while (file) {
-        if (file.isDirectory() && !String(file.name()).endsWith(".")) {
-            htmlDeleteDir(file.name());
-            file.flush();
-            file.close();
-        } else {
-            String fileName = String(file.name());
-            file.flush();
-            file.close();
-            LOG_DEBUG("    %s\n", fileName.c_str());
-            FSCom.remove(fileName);
+    void leaveDir()
+    {
+        depth--;
+        if (opened > depth) {
+            out.print(']');
+            opened = depth;
         }
-        file = root.openNextFile();
     }
-    root.flush();
-    root.close();
-}
+};
 
-JSONArray htmlListDir(const char *dirname, uint8_t levels)
+/// Stream the files below dirname into the listing.  @return false if the walk should stop
+static bool htmlListDir(FsListing &listing, const char *dirname, uint8_t levels)
 {
     File root = FSCom.open(dirname, FILE_O_READ);
-    JSONArray fileList;
-    if (!root) {
-        return fileList;
-    }
-    if (!root.isDirectory()) {
-        return fileList;
-    }
+    if (!root || !root.isDirectory())
+        return true;
 
-    // iterate over the file list
+    bool keepGoing = true;
     File file = root.openNextFile();
-    while (file) {
+    while (file && keepGoing) {
         if (file.isDirectory() && !String(file.name()).endsWith(".")) {
             if (levels) {
-#ifdef ARCH_ESP32
-                fileList.push_back(new JSONValue(htmlListDir(file.path(), levels - 1)));
-#else
-                fileList.push_back(new JSONValue(htmlListDir(file.name(), levels - 1)));
-#endif
-                file.close();
+                listing.depth++;
+                keepGoing = htmlListDir(listing, file.path(), levels - 1);
+                listing.leaveDir();
             }
         } else {
-            JSONObject thisFileMap;
-            thisFileMap["size"] = new JSONValue((int)file.size());
-#ifdef ARCH_ESP32
-            thisFileMap["name"] = new JSONValue(String(file.path()).substring(1).c_str());
-#else
-            thisFileMap["name"] = new JSONValue(String(file.name()).substring(1).c_str());
-#endif
-            if (String(file.name()).substring(1).endsWith(".gz")) {
-#ifdef ARCH_ESP32
-                String modifiedFile = String(file.path()).substring(1);
-#else
-                String modifiedFile = String(file.name()).substring(1);
-#endif
-                modifiedFile.remove((modifiedFile.length() - 3), 3);
-                thisFileMap["nameModified"] = new JSONValue(modifiedFile.c_str());
-            }
-            fileList.push_back(new JSONValue(thisFileMap));
+            keepGoing = listing.file(file);
         }
         file.close();
-        file = root.openNextFile();
+        if (keepGoing)
+            file = root.openNextFile();
     }
     root.close();
-    return fileList;
+    return keepGoing;
 }
 
+/*
+ * Lists /static as it walks the tree rather than building the whole list in RAM first.  offset and limit page through the
+ * files, data.next is the offset of the next page if there is one
+ */
 void handleFsBrowseStatic(HTTPRequest *req, HTTPResponse *res)
 {
+    ResourceParameters *params = req->getParams();
+    std::string value;
+    uint32_t offset = params->getQueryParameter("offset", value) ? strtoul(value.c_str(), NULL, 10) : 0;
+    uint32_t limit = params->getQueryParameter("limit", value) ? strtoul(value.c_str(), NULL, 10) : 0;
+
     res->setHeader("Content-Type", "application/json");
     res->setHeader("Access-Control-Allow-Origin", "*");
     res->setHeader("Access-Control-Allow-Methods", "GET");
 
-    auto fileList = htmlListDir("/static", 10);
-
-    // create json output structure
-    JSONObject filesystemObj;
-    filesystemObj["total"] = new JSONValue((int)FSCom.totalBytes());
-    filesystemObj["used"] = new JSONValue((int)FSCom.usedBytes());
-    filesystemObj["free"] = new JSONValue(int(FSCom.totalBytes() - FSCom.usedBytes()));
-
-    JSONObject jsonObjInner;
-    jsonObjInner["files"] = new JSONValue(fileList);
-    jsonObjInner["filesystem"] = new JSONValue(filesystemObj);
-
-    JSONObject jsonObjOuter;
-    jsonObjOuter["data"] = new JSONValue(jsonObjInner);
-    jsonObjOuter["status"] = new JSONValue("ok");
-
-    JSONValue *value = new JSONValue(jsonObjOuter);
-
-    res->print(value->Stringify().c_str());
-
-    delete value;
+    // Keys in the same (sorted) order JSONValue used to give us
+    res->print("{\"data\":{\"files\":[");
+    FsListing listing(*res, offset, limit);
+    htmlListDir(listing, "/static", FS_LIST_MAX_DEPTH);
+    while (listing.depth > 0)
+        listing.leaveDir();
+    res->print("]");
+
+    char buf[128];
+    snprintf(buf, sizeof(buf), ",\"filesystem\":{\"free\":%d,\"total\":%d,\"used\":%d}",
+             int(FSCom.totalBytes() - FSCom.usedBytes()), (int)FSCom.totalBytes(), (int)FSCom.usedBytes());
+    res->print(buf);
+    if (listing.more) {
+        snprintf(buf, sizeof(buf), ",\"next\":%u", offset + limit);
+        res->print(buf);
+    }
+    res->print("},\"status\":\"ok\"}");
 }
 
 void handleFsDeleteStatic(HTTPRequest *req, HTTPResponse *res)
@@ -569,6 +611,62 @@ void handleFormUpload(HTTPRequest *req, HTTPResponse *res)
     delete parser;
 }
 
+void handleMetrics(HTTPRequest *req, HTTPResponse *res)
+{
+    res->setHeader("Content-Type", OPENMETRICS_CONTENT_TYPE);
+    writeOpenMetrics(*res);
+}
+
+/*
+ * The NodeDB as length delimited NodeInfo protobufs, or columnar JSON with format=json.  since=<generation> (from the
+ * X-NodeDB-Generation of an earlier response) returns only what changed after it
+ */
+void handleNodes(HTTPRequest *req, HTTPResponse *res)
+{
+    ResourceParameters *params = req->getParams();
+    std::string format, since;
+
+    bool json = params->getQueryParameter("format", format) && format == "json";
+    uint32_t base = params->getQueryParameter("since", since) ? nodeDBExportBase(strtoul(since.c_str(), NULL, 10)) : 0;
+
+    char etag[NODEDB_EXPORT_ETAG_SIZE];
+    nodeDBExportETag(etag, sizeof(etag), json, base);
+    res->setHeader("ETag", etag);
+    res->setHeader(NODEDB_EXPORT_GENERATION_HEADER, std::to_string(nodeDB->getGeneration()));
+    res->setHeader("Access-Control-Allow-Origin", "*");
+    res->setHeader("Access-Control-Allow-Methods", "GET");
+    res->setHeader("Access-Control-Expose-Headers", "ETag, " NODEDB_EXPORT_GENERATION_HEADER);
+
+    if (req->getHeader("If-None-Match") == etag) {
+        res->setStatusCode(304);
+        return;
+    }
+
+    if (json) {
+        res->setHeader("Content-Type", "application/json");
+        writeNodeDBJson(*res, base);
+    } else {
+        res->setHeader("Content-Type", "application/x-protobuf");
+        res->setHeader("X-Protobuf-Schema", "https://raw.githubusercontent.com/meshtastic/protobufs/master/mesh.proto");
+        writeNodeDBProtobuf(*res, base);
+    }
+}
+
+/*
+ * The links we know of and our routes over them as JSON, plus our path to a node with to=<nodenum>
+ */
+void handleTopology(HTTPRequest *req, HTTPResponse *res)
+{
+    ResourceParameters *params = req->getParams();
+    std::string to;
+    NodeNum dest = params->getQueryParameter("to", to) ? strtoul(to.c_str(), NULL, 10) : 0;
+
+    res->setHeader("Content-Type", "application/json");
+    res->setHeader("Access-Control-Allow-Origin", "*");
+    res->setHeader("Access-Control-Allow-Methods", "GET");
+    meshTopology->writeJson(*res, dest);
+}
+
 void handleReport(HTTPRequest *req, HTTPResponse *res)
 {
     ResourceParameters *params = req->getParams();
@@ -702,13 +800,29 @@ void handleDeleteFsContent(HTTPRequest *req, HTTPResponse *res)
     res->println("<h1>Meshtastic</h1>\n");
     res->println("Deleting Content in /static/*");
 
-    LOG_INFO("Deleting files from /static/* : \n");
-
-    htmlDeleteDir("/static");
+    if (!fsDeleteJob)
+        fsDeleteJob = new FsDeleteJob();
+    if (fsDeleteJob->start("/static"))
+        res->println("<p>Started, see <a href=/json/fs/delete/progress>progress</a>\n");
+    else
+        res->println("<p>A delete is already running, see <a href=/json/fs/delete/progress>progress</a>\n");
 
     res->println("<p><hr><p><a href=/admin>Back to admin</a>\n");
 }
 
+void handleFsDeleteProgress(HTTPRequest *req, HTTPResponse *res)
+{
+    res->setHeader("Content-Type", "application/json");
+    res->setHeader("Access-Control-Allow-Origin", "*");
+    res->setHeader("Access-Control-Allow-Methods", "GET");
+
+    bool running = fsDeleteJob && fsDeleteJob->isRunning();
+    char buf[96];
+    snprintf(buf, sizeof(buf), "{\"data\":{\"deleted\":%u,\"failed\":%u,\"running\":%s},\"status\":\"ok\"}",
+             fsDeleteJob ? fsDeleteJob->getDeleted() : 0, fsDeleteJob ? fsDeleteJob->getFailed() : 0, running ? "true" : "false");
+    res->print(buf);
+}
+
 void handleAdmin(HTTPRequest *req, HTTPResponse *res)
 {
     res->setHeader("Content-Type", "text/html");
@@ -0,0 +1,76 @@
+#include "configuration.h"
+#if !MESHTASTIC_EXCLUDE_WEBSERVER
+#include "FsDeleteJob.h"
+
+FsDeleteJob *fsDeleteJob;
+
+bool FsDeleteJob::start(const char *dirname)
+{
+    if (isRunning())
+        return false;
+
+    File root = FSCom.open(dirname, FILE_O_READ);
+    if (!root || !root.isDirectory())
+        return false;
+
+    LOG_INFO("Deleting files from %s/* in the background\n", dirname);
+    depth = 0;
+    dirs[0] = root;
+    paths[0] = dirname;
+    deleted = failed = 0;
+
+    enabled = true;
+    setIntervalFromNow(0);
+    return true;
+}
+
+bool FsDeleteJob::step()
+{
+    File file = dirs[depth].openNextFile();
+
+    if (!file) {
+        // This directory is now empty, remove it unless it is the one we were asked to empty
+        dirs[depth].close();
+        if (depth > 0) {
+            if (FSCom.rmdir(paths[depth].c_str()))
+                deleted++;
+            else
+                failed++;
+        }
+        paths[depth] = "";
+        return --depth >= 0;
+    }
+
+    String path = file.path();
+    if (file.isDirectory()) {
+        if (!path.endsWith(".") && depth < FS_DELETE_MAX_DEPTH) {
+            depth++;
+            dirs[depth] = file;
+            paths[depth] = path;
+        } else {
+            file.close();
+        }
+        return true;
+    }
+
+    file.close();
+    LOG_DEBUG("    %s\n", path.c_str());
+    if (FSCom.remove(path.c_str()))
+        deleted++;
+    else
+        failed++;
+    return true;
+}
+
+int32_t FsDeleteJob::runOnce()
+{
+    for (int i = 0; i < FS_DELETE_BATCH; i++) {
+        if (!step()) {
+            LOG_INFO("Background delete done, %u removed, %u failed\n", deleted, failed);
+            return disable();
+        }
+    }
+    return 5;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "FSCommon.h"
+#include "concurrency/OSThread.h"
+
+// How deep below the directory we are asked to empty we will go, like htmlListDir()
+#define FS_DELETE_MAX_DEPTH 10
+
+// How many files and directories we remove each time we run, so the web server and the mesh keep running meanwhile
+#define FS_DELETE_BATCH 8
+
+/**
+ * Empties a directory a few entries at a time in the background, rather than in one long recursive call from a web request
+ * handler.  Subdirectories are removed too, the directory itself is kept.
+ */
+class FsDeleteJob : private concurrency::OSThread
+{
+    /// The directories we are in the middle of, outermost first, and their paths (which File::path() can't give us back
+    /// once we have closed them)
+    File dirs[FS_DELETE_MAX_DEPTH + 1];
+    String paths[FS_DELETE_MAX_DEPTH + 1];
+    int depth = -1; // index of the innermost open directory, -1 when we are idle
+
+    uint32_t deleted = 0;
+    uint32_t failed = 0;
+
+  public:
+    FsDeleteJob() : concurrency::OSThread("FsDelete", 0) { disable(); }
+
+    /// Start emptying dirname.  @return false if a job is already running (or dirname is not a directory)
+    bool start(const char *dirname);
+
+    bool isRunning() const { return depth >= 0; }
+
+    /// How many entries we have removed (or failed to) since the last start()
+    uint32_t getDeleted() const { return deleted; }
+    uint32_t getFailed() const { return failed; }
+
+  protected:
+    virtual int32_t runOnce() override;
+
+  private:
+    /// Remove the next entry of the innermost directory, or finish with that directory.  @return false once we are done
+    bool step();
+};
+
+extern FsDeleteJob *fsDeleteJob;
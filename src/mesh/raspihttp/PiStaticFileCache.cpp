@@ -0,0 +1,56 @@
+#ifdef PORTDUINO_LINUX_HARDWARE
+#include "PiStaticFileCache.h"
+#include <iterator>
+#include <stdio.h>
+
+StaticFileCache staticFileCache;
+
+void StaticFileCache::evict(std::list<Entry>::iterator it)
+{
+    totalBytes -= it->body.size();
+    index.erase(it->path);
+    entries.erase(it);
+}
+
+bool StaticFileCache::get(const std::string &path, const struct stat &st, std::string &body)
+{
+    if (st.st_size > STATIC_CACHE_MAX_FILE_BYTES)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = index.find(path);
+        if (found != index.end()) {
+            auto it = found->second;
+            if (it->mtime == st.st_mtime && it->size == st.st_size) {
+                entries.splice(entries.begin(), entries, it);
+                body = it->body;
+                return true;
+            }
+            evict(it); // the file has changed since we read it
+        }
+    }
+
+    // Read without holding the lock, so a slow SD card doesn't stall requests for files we already have
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f)
+        return false;
+    body.resize(st.st_size);
+    size_t got = fread(&body[0], 1, st.st_size, f);
+    fclose(f);
+    if (got != (size_t)st.st_size)
+        return false;
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (index.count(path))
+        return true; // someone else read it meanwhile
+
+    while (!entries.empty() && totalBytes + body.size() > STATIC_CACHE_MAX_BYTES)
+        evict(std::prev(entries.end()));
+    entries.push_front(Entry{path, body, st.st_mtime, st.st_size});
+    index[path] = entries.begin();
+    totalBytes += body.size();
+    return true;
+}
+
+#endif
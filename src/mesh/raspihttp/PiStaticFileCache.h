@@ -0,0 +1,46 @@
+#pragma once
+#ifdef PORTDUINO_LINUX_HARDWARE
+#include <list>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <unordered_map>
+
+// How much of the web root we keep in RAM
+#define STATIC_CACHE_MAX_BYTES (8 * 1024 * 1024)
+
+// Files bigger than this are always streamed from disk
+#define STATIC_CACHE_MAX_FILE_BYTES (1024 * 1024)
+
+/**
+ * The most recently served static files of the web server, so loading the web client doesn't read every asset from the SD
+ * card again.  Entries are checked against the file's size and mtime on every lookup, so edits to the web root show up
+ * right away.  Safe to use from several ulfius threads at once.
+ */
+class StaticFileCache
+{
+    struct Entry {
+        std::string path;
+        std::string body;
+        time_t mtime;
+        off_t size;
+    };
+
+    std::mutex lock;
+
+    /// Most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    size_t totalBytes = 0;
+
+    void evict(std::list<Entry>::iterator it);
+
+  public:
+    /// Copy the contents of the file at path, which stat'ed as st, into body.  @return false if the file is too big to cache
+    /// (or can't be read), the caller should stream it instead
+    bool get(const std::string &path, const struct stat &st, std::string &body);
+};
+
+extern StaticFileCache staticFileCache;
+
+#endif
@@ -5,6 +5,8 @@ Webserver libs including generation of SSL certifcicates,  because the use ESP s
 the lib that can't be emulated.
 
 The WebServices adapt to the two major phoneapi functions "handleAPIv1FromRadio,handleAPIv1ToRadio"
+Clients which would rather not poll can open a websocket on /api/v1/websocket instead, FromRadio messages are then
+pushed to them as binary messages as soon as they are available, and ToRadio messages are sent the same way.
 The WebServer just adds basaic support to deliver WebContent, so it can be used to
 deliver the WebGui definded by the WebClient Project.
 
@@ -37,7 +39,12 @@ mail:   marchammermann@googlemail.com
 #ifdef PORTDUINO_LINUX_HARDWARE
 #if __has_include(<ulfius.h>)
 #include "PiWebServer.h"
+#include "MeshTopology.h"
 #include "NodeDB.h"
+#include "NodeDBExport.h"
+#include "OpenMetrics.h"
+#include "PiStaticFileCache.h"
+#include "PiWebSocketAPI.h"
 #include "PhoneAPI.h"
 #include "PowerFSM.h"
 #include "RadioLibInterface.h"
@@ -53,9 +60,11 @@ mail:   marchammermann@googlemail.com
 #include <openssl/x509.h>
 #include <orcania.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <ulfius.h>
 #include <yder.h>
 
+#include <chrono>
 #include <cstring>
 #include <string>
 
@@ -85,6 +94,51 @@ volatile bool isCertReady;
 HttpAPI webAPI;
 
 PiWebServerThread *piwebServerThread;
+WebMainThread *webMainThread;
+
+bool WebMainThread::run(const std::function<void()> &fn, uint32_t timeoutMsec)
+{
+    Job job;
+    job.fn = &fn;
+
+    std::unique_lock<std::mutex> guard(lock);
+    jobs.push_back(&job);
+    hasJobs = true;
+    concurrency::mainDelay.interrupt();
+
+    if (!jobDone.wait_for(guard, std::chrono::milliseconds(timeoutMsec), [&job] { return job.started; })) {
+        // Not started, so it's still queued and we can take it back before it goes out of scope
+        for (auto i = jobs.begin(); i != jobs.end(); i++) {
+            if (*i == &job) {
+                jobs.erase(i);
+                break;
+            }
+        }
+        return false;
+    }
+    jobDone.wait(guard, [&job] { return job.done; });
+    return true;
+}
+
+int32_t WebMainThread::runOnce()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (!jobs.empty()) {
+        Job *job = jobs.front();
+        jobs.pop_front();
+        job->started = true;
+        jobDone.notify_all();
+
+        guard.unlock();
+        (*job->fn)();
+        guard.lock();
+
+        job->done = true;
+        jobDone.notify_all();
+    }
+    hasJobs = false;
+    return INT32_MAX; // shouldRun() wakes us for the next job
+}
 
 /**
  * Return the filename extension
@@ -125,15 +179,102 @@ static void callback_static_file_stream_free(void *cls)
     }
 }
 
+/**
+ * Does the Accept-Encoding header list this encoding (and not with q=0)?
+ */
+static bool acceptsEncoding(const char *accept, const char *encoding)
+{
+    size_t len = strlen(encoding);
+    for (const char *p = accept; p && *p;) {
+        while (*p == ' ' || *p == ',')
+            p++;
+        const char *end = strchr(p, ',');
+        if (!end)
+            end = p + strlen(p);
+        if (strncasecmp(p, encoding, len) == 0 && (p[len] == ';' || p[len] == ' ' || p + len == end)) {
+            const char *q = strstr(p, "q=");
+            return !(q && q < end && atof(q + 2) == 0);
+        }
+        p = end;
+    }
+    return false;
+}
+
+/**
+ * Send a file we know exists, preferring a precompressed .br or .gz sibling if the client takes those.  Files come from
+ * staticFileCache if they are small enough, and are streamed in big chunks otherwise.  The ETag lets browsers revalidate
+ * without downloading the file again.
+ */
+static void sendStaticFile(const struct _u_request *request, struct _u_response *response, const char *file_path,
+                           const char *file_requested)
+{
+    static const char *encodings[][2] = {{"br", ".br"}, {"gzip", ".gz"}};
+
+    std::string path = file_path;
+    const char *encoding = NULL;
+    struct stat st;
+
+    const char *accept = u_map_get_case(request->map_header, "Accept-Encoding");
+    for (auto &e : encodings) {
+        if (acceptsEncoding(accept, e[0]) && stat((path + e[1]).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            path += e[1];
+            encoding = e[0];
+            break;
+        }
+    }
+    if (!encoding && stat(file_path, &st) != 0) {
+        ulfius_set_string_body_response(response, 404, "File not found");
+        return;
+    }
+
+    const char *content_type = u_map_get_case(&configWeb.mime_types, get_filename_ext(file_requested));
+    if (content_type == NULL) {
+        content_type = u_map_get(&configWeb.mime_types, "*");
+        LOG_DEBUG("Static File Server - Unknown mime type for extension %s \n", get_filename_ext(file_requested));
+    }
+
+    char etag[48];
+    snprintf(etag, sizeof(etag), "\"%lx-%lx%s\"", (unsigned long)st.st_mtime, (unsigned long)st.st_size,
+             encoding ? encoding : "");
+
+    u_map_put(response->map_header, "Content-Type", content_type);
+    u_map_put(response->map_header, "ETag", etag);
+    u_map_put(response->map_header, "Cache-Control", "no-cache"); // always revalidate, which is cheap thanks to the ETag
+    u_map_put(response->map_header, "Vary", "Accept-Encoding");
+    if (encoding)
+        u_map_put(response->map_header, "Content-Encoding", encoding);
+    u_map_copy_into(response->map_header, &configWeb.map_header);
+
+    const char *ifNoneMatch = u_map_get_case(request->map_header, "If-None-Match");
+    if (ifNoneMatch && (strstr(ifNoneMatch, etag) || strcmp(ifNoneMatch, "*") == 0)) {
+        response->status = 304;
+        return;
+    }
+
+    std::string body;
+    if (staticFileCache.get(path, st, body)) {
+        ulfius_set_binary_body_response(response, 200, body.data(), body.size());
+        return;
+    }
+
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) {
+        ulfius_set_string_body_response(response, 404, "File not found");
+        return;
+    }
+    if (ulfius_set_stream_response(response, 200, callback_static_file_stream, callback_static_file_stream_free, st.st_size,
+                                   STATIC_FILE_CHUNK, f) != U_OK) {
+        LOG_DEBUG("callback_static_file - Error ulfius_set_stream_response\n");
+        fclose(f);
+    }
+}
+
 /**
  * static file callback endpoint that delivers the content for WebServer calls
  */
 int callback_static_file(const struct _u_request *request, struct _u_response *response, void *user_data)
 {
-    size_t length;
-    FILE *f;
     char *file_requested, *file_path, *url_dup_save, *real_path = NULL;
-    const char *content_type;
 
     /*
      * Comment this if statement if you don't access static files url from root dir, like /app
@@ -169,25 +310,7 @@ int callback_static_file(const struct _u_request *request, struct _u_response *r
         real_path = realpath(file_path, NULL);
         if (0 == o_strncmp(configWeb.files_path, real_path, o_strlen(configWeb.files_path))) {
             if (access(file_path, F_OK) != -1) {
-                f = fopen(file_path, "rb");
-                if (f) {
-                    fseek(f, 0, SEEK_END);
-                    length = ftell(f);
-                    fseek(f, 0, SEEK_SET);
-
-                    content_type = u_map_get_case(&configWeb.mime_types, get_filename_ext(file_requested));
-                    if (content_type == NULL) {
-                        content_type = u_map_get(&configWeb.mime_types, "*");
-                        LOG_DEBUG("Static File Server - Unknown mime type for extension %s \n", get_filename_ext(file_requested));
-                    }
-                    u_map_put(response->map_header, "Content-Type", content_type);
-                    u_map_copy_into(response->map_header, &configWeb.map_header);
-
-                    if (ulfius_set_stream_response(response, 200, callback_static_file_stream, callback_static_file_stream_free,
-                                                   length, STATIC_FILE_CHUNK, f) != U_OK) {
-                        LOG_DEBUG("callback_static_file - Error ulfius_set_stream_response\n	");
-                    }
-                }
+                sendStaticFile(request, response, file_path, file_requested);
             } else {
                 if (configWeb.redirect_on_404 == NULL) {
                     ulfius_set_string_body_response(response, 404, "File not found");
@@ -296,6 +419,118 @@ int handleAPIv1FromRadio(const struct _u_request *req, struct _u_response *res,
     return U_CALLBACK_COMPLETE;
 }
 
+/// Collects what is printed to it, so writeOpenMetrics() can fill a response body
+class StringPrint : public Print
+{
+  public:
+    std::string str;
+
+    virtual size_t write(uint8_t c) override
+    {
+        str += (char)c;
+        return 1;
+    }
+    virtual size_t write(const uint8_t *buf, size_t len) override
+    {
+        str.append((const char *)buf, len);
+        return len;
+    }
+};
+
+/*
+ * Serve our metrics for Prometheus and friends
+ */
+int handleMetrics(const struct _u_request *req, struct _u_response *res, void *user_data)
+{
+    // Our thread lists and the rest may only be walked from the main thread
+    StringPrint body;
+    if (!webMainThread->run([&body] { writeOpenMetrics(body); })) {
+        ulfius_set_string_body_response(res, 503, "Busy, try again");
+        return U_CALLBACK_COMPLETE;
+    }
+    ulfius_add_header_to_response(res, "Content-Type", OPENMETRICS_CONTENT_TYPE);
+    ulfius_set_binary_body_response(res, 200, body.str.data(), body.str.size());
+    return U_CALLBACK_COMPLETE;
+}
+
+/*
+ * The NodeDB as length delimited NodeInfo protobufs, or columnar JSON with format=json.  since=<generation> (from the
+ * X-NodeDB-Generation of an earlier response) returns only what changed after it
+ */
+int handleAPIv1Nodes(const struct _u_request *req, struct _u_response *res, void *user_data)
+{
+    const char *format = u_map_get(req->map_url, "format");
+    const char *since = u_map_get(req->map_url, "since");
+    const char *ifNoneMatch = u_map_get_case(req->map_header, "If-None-Match");
+
+    bool json = format && strcmp(format, "json") == 0;
+    uint32_t sinceGeneration = since ? strtoul(since, NULL, 10) : 0;
+
+    // NodeDB may only be read from the main thread, so everything which looks at it happens there
+    char etag[NODEDB_EXPORT_ETAG_SIZE], generation[12];
+    bool notModified = false;
+    StringPrint body;
+    bool ran = webMainThread->run([&] {
+        uint32_t base = nodeDBExportBase(sinceGeneration);
+        nodeDBExportETag(etag, sizeof(etag), json, base);
+        snprintf(generation, sizeof(generation), "%u", nodeDB->getGeneration());
+        notModified = ifNoneMatch && strcmp(ifNoneMatch, etag) == 0;
+        if (notModified)
+            return;
+        if (json)
+            writeNodeDBJson(body, base);
+        else
+            writeNodeDBProtobuf(body, base);
+    });
+    if (!ran) {
+        ulfius_set_string_body_response(res, 503, "Busy, try again");
+        return U_CALLBACK_COMPLETE;
+    }
+
+    ulfius_add_header_to_response(res, "ETag", etag);
+    ulfius_add_header_to_response(res, NODEDB_EXPORT_GENERATION_HEADER, generation);
+    ulfius_add_header_to_response(res, "Access-Control-Allow-Origin", "*");
+    ulfius_add_header_to_response(res, "Access-Control-Allow-Methods", "GET");
+    ulfius_add_header_to_response(res, "Access-Control-Expose-Headers", "ETag, " NODEDB_EXPORT_GENERATION_HEADER);
+
+    if (notModified) {
+        ulfius_set_response_properties(res, U_OPT_STATUS, 304);
+        return U_CALLBACK_COMPLETE;
+    }
+
+    if (json) {
+        ulfius_add_header_to_response(res, "Content-Type", "application/json");
+    } else {
+        ulfius_add_header_to_response(res, "Content-Type", "application/x-protobuf");
+        ulfius_add_header_to_response(res, "X-Protobuf-Schema",
+                                      "https://raw.githubusercontent.com/meshtastic/protobufs/master/mesh.proto");
+    }
+    ulfius_set_binary_body_response(res, 200, body.str.data(), body.str.size());
+    return U_CALLBACK_COMPLETE;
+}
+
+/*
+ * The links we know of and our routes over them as JSON, plus our path to a node with to=<nodenum>
+ */
+int handleAPIv1Topology(const struct _u_request *req, struct _u_response *res, void *user_data)
+{
+    const char *to = u_map_get(req->map_url, "to");
+
+    NodeNum dest = to ? strtoul(to, NULL, 10) : 0;
+
+    // The topology is built from NodeDB and NeighborInfo, which may only be read from the main thread
+    StringPrint body;
+    if (!webMainThread->run([&body, dest] { meshTopology->writeJson(body, dest); })) {
+        ulfius_set_string_body_response(res, 503, "Busy, try again");
+        return U_CALLBACK_COMPLETE;
+    }
+    ulfius_add_header_to_response(res, "Content-Type", "application/json");
+    ulfius_add_header_to_response(res, "Access-Control-Allow-Origin", "*");
+    ulfius_add_header_to_response(res, "Access-Control-Allow-Methods", "GET");
+    ulfius_set_binary_body_response(res, 200, body.str.data(), body.str.size());
+    return U_CALLBACK_COMPLETE;
+}
+
 /*
 OpenSSL RSA Key Gen
 */
@@ -492,8 +727,16 @@ PiWebServerThread::PiWebServerThread()
         u_map_put(instanceWeb.default_headers, "Access-Control-Allow-Origin", "*");
         // Maximum body size sent by the client is 1 Kb
         instanceWeb.max_post_body_size = 1024;
+        webMainThread = new WebMainThread();
         ulfius_add_endpoint_by_val(&instanceWeb, "GET", PREFIX, "/api/v1/fromradio/*", 1, &handleAPIv1FromRadio, NULL);
         ulfius_add_endpoint_by_val(&instanceWeb, "PUT", PREFIX, "/api/v1/toradio/*", 1, &handleAPIv1ToRadio, configWeb.rootPath);
+        ulfius_add_endpoint_by_val(&instanceWeb, "GET", PREFIX, "/metrics", 1, &handleMetrics, NULL);
+        ulfius_add_endpoint_by_val(&instanceWeb, "GET", PREFIX, "/api/v1/nodes", 1, &handleAPIv1Nodes, NULL);
+        ulfius_add_endpoint_by_val(&instanceWeb, "GET", PREFIX, "/api/v1/topology", 1, &handleAPIv1Topology, NULL);
+#ifndef U_DISABLE_WEBSOCKET
+        webSocketPump = new WebSocketPump();
+        ulfius_add_endpoint_by_val(&instanceWeb, "GET", PREFIX, "/api/v1/websocket", 1, &handleAPIv1WebSocket, NULL);
+#endif
 
         // Add callback function to all endpoints for the Web Server
         ulfius_add_endpoint_by_val(&instanceWeb, "GET", NULL, "/*", 2, &callback_static_file, &configWeb);
@@ -2,12 +2,21 @@
 #ifdef PORTDUINO_LINUX_HARDWARE
 #if __has_include(<ulfius.h>)
 #include "PhoneAPI.h"
+#include "concurrency/OSThread.h"
 #include "ulfius-cfg.h"
 #include "ulfius.h"
 #include <Arduino.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <mutex>
 
-#define STATIC_FILE_CHUNK 256
+// Files too big for the static file cache are streamed from disk in chunks this big
+#define STATIC_FILE_CHUNK (64 * 1024)
+
+// How long a request waits for the main thread to build its response before we give up with a 503
+#define WEB_MAIN_THREAD_TIMEOUT_MSEC 5000
 
 void initWebServer();
 void createSSLCert();
@@ -55,7 +64,37 @@ class HttpAPI : public PhoneAPI
     virtual bool checkIsConnected() override { return true; } // FIXME, be smarter about this
 };
 
+/**
+ * Runs work for the ulfius threads on the main thread, which is the only one allowed to walk our thread lists, NodeDB and the
+ * like.  A request handler hands over a function building its response and blocks until it has run.
+ */
+class WebMainThread : private concurrency::OSThread
+{
+    struct Job {
+        const std::function<void()> *fn;
+        bool started = false, done = false;
+    };
+
+    std::mutex lock; // protects jobs and the state of every Job in it
+    std::condition_variable jobDone;
+    std::deque<Job *> jobs;
+    std::atomic<bool> hasJobs{false};
+
+  public:
+    WebMainThread() : concurrency::OSThread("WebMain") {}
+
+    /// Called from ulfius threads: run fn on the main thread and wait for it.  @return false if it didn't start in time
+    bool run(const std::function<void()> &fn, uint32_t timeoutMsec = WEB_MAIN_THREAD_TIMEOUT_MSEC);
+
+    /// Also run as soon as the main thread wakes if run() queued a job, so run() never touches our schedule itself
+    virtual bool shouldRun(unsigned long time) override { return hasJobs || concurrency::OSThread::shouldRun(time); }
+
+  protected:
+    virtual int32_t runOnce() override;
+};
+
 extern PiWebServerThread *piwebServerThread;
+extern WebMainThread *webMainThread;
 
 #endif
 #endif
\ No newline at end of file
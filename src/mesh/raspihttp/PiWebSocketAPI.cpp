@@ -0,0 +1,255 @@
+#ifdef PORTDUINO_LINUX_HARDWARE
+#if __has_include(<ulfius.h>)
+#include "PiWebSocketAPI.h"
+#ifndef U_DISABLE_WEBSOCKET
+#include "configuration.h"
+#include "mesh/api/PhonePacketFanout.h"
+#include <chrono>
+
+// How often the manager thread wakes up to see if the websocket has closed when there is nothing to send
+#define WEBSOCKET_POLL_MSEC 1000
+
+// How often we pump our clients while any are connected
+#define WEBSOCKET_PUMP_MSEC 20
+
+WebSocketPump *webSocketPump;
+
+WebSocketAPI::~WebSocketAPI()
+{
+    close(); // release any packet we hold back to the fanout, ~PhoneAPI can no longer reach our overrides
+    if (fanoutAttached)
+        apiPacketFanout.detach(fanoutSlot);
+}
+
+bool WebSocketAPI::queueToRadio(const uint8_t *buf, size_t len)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (rxCount == WEBSOCKET_RX_FRAMES || len > MAX_TO_FROM_RADIO_SIZE)
+        return false;
+
+    Frame &f = rxFrames[(rxHead + rxCount) % WEBSOCKET_RX_FRAMES];
+    memcpy(f.buf, buf, len);
+    f.len = len;
+    rxCount++;
+    return true;
+}
+
+size_t WebSocketAPI::waitFromRadio(uint8_t *buf, uint32_t timeoutMsec)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (!txReady.wait_for(guard, std::chrono::milliseconds(timeoutMsec), [this] { return txCount > 0 || rejected; }) ||
+        !txCount)
+        return 0;
+
+    Frame &f = txFrames[txHead];
+    size_t len = f.len;
+    memcpy(buf, f.buf, len);
+    txHead = (txHead + 1) % WEBSOCKET_TX_FRAMES;
+    txCount--;
+    return len;
+}
+
+void WebSocketAPI::markClosed()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    txReady.notify_all();
+    ulfiusRefs--;
+}
+
+void WebSocketAPI::release()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    ulfiusRefs--;
+}
+
+bool WebSocketAPI::pump()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (closed)
+            return ulfiusRefs > 0; // wait for the ulfius side to let go before we get deleted
+    }
+
+    if (!fanoutAttached) {
+        fanoutSlot = apiPacketFanout.attach();
+        fanoutAttached = true;
+        if (fanoutSlot < 0) {
+            // Without a slot we could only steal packets from the other clients, so turn the client away instead
+            LOG_WARN("No room to share mesh packets with another websocket client, closing it\n");
+            std::lock_guard<std::mutex> guard(lock);
+            rejected = true;
+            txReady.notify_all();
+        }
+    }
+    if (rejected)
+        return true; // until the manager thread has closed the websocket
+
+    // The queues are tiny, so copy out under the lock and run PhoneAPI without it
+    Frame rx;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (rxCount == 0)
+                break;
+            rx = rxFrames[rxHead];
+            rxHead = (rxHead + 1) % WEBSOCKET_RX_FRAMES;
+            rxCount--;
+        }
+        handleToRadio(rx.buf, rx.len);
+    }
+
+    bool added = false;
+    while (true) {
+        uint8_t freeSlots;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            freeSlots = WEBSOCKET_TX_FRAMES - txCount;
+        }
+        if (!freeSlots || !available())
+            break;
+
+        // Only we add frames, so the slot we saw free is still free
+        Frame tx;
+        tx.len = getFromRadio(tx.buf);
+        if (!tx.len)
+            break;
+
+        std::lock_guard<std::mutex> guard(lock);
+        txFrames[(txHead + txCount) % WEBSOCKET_TX_FRAMES] = tx;
+        txCount++;
+        added = true;
+    }
+    if (added)
+        txReady.notify_one();
+
+    return true;
+}
+
+meshtastic_MeshPacket *WebSocketAPI::getPacketForPhone()
+{
+    return fanoutSlot >= 0 ? apiPacketFanout.get(fanoutSlot) : NULL;
+}
+
+void WebSocketAPI::releasePacketForPhone(meshtastic_MeshPacket *p)
+{
+    if (fanoutSlot >= 0)
+        apiPacketFanout.release(p);
+}
+
+bool WebSocketPump::add(WebSocketAPI *api)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    int used = 0, freeSlot = -1;
+    for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++) {
+        if (clients[i])
+            used++;
+        if (pending[i])
+            used++;
+        else if (freeSlot < 0)
+            freeSlot = i;
+    }
+    if (used >= MAX_WEBSOCKET_CLIENTS || freeSlot < 0) {
+        delete api;
+        return false;
+    }
+
+    // We may only be rescheduled from the main thread, so just wake it and let shouldRun() pick the connection up
+    pending[freeSlot] = api;
+    hasPending = true;
+    concurrency::mainDelay.interrupt();
+    return true;
+}
+
+int32_t WebSocketPump::runOnce()
+{
+    bool any = false;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        hasPending = false;
+        for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++) {
+            if (!pending[i])
+                continue;
+            for (int j = 0; j < MAX_WEBSOCKET_CLIENTS; j++) {
+                if (!clients[j]) {
+                    clients[j] = pending[i];
+                    pending[i] = NULL;
+                    LOG_INFO("Websocket API client connected\n");
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < MAX_WEBSOCKET_CLIENTS; i++) {
+        if (!clients[i])
+            continue;
+        if (clients[i]->pump()) {
+            any = true;
+        } else {
+            LOG_INFO("Websocket API client disconnected\n");
+            std::lock_guard<std::mutex> guard(lock);
+            delete clients[i];
+            clients[i] = NULL;
+        }
+    }
+
+    return any ? WEBSOCKET_PUMP_MSEC : 1000;
+}
+
+/// Runs in its own ulfius thread for as long as the websocket is open, sending whatever the pump has queued for it
+static void websocketManager(const struct _u_request *req, struct _websocket_manager *manager, void *user_data)
+{
+    WebSocketAPI *api = (WebSocketAPI *)user_data;
+    uint8_t buf[MAX_TO_FROM_RADIO_SIZE];
+
+    while (ulfius_websocket_status(manager) == U_WEBSOCKET_STATUS_OPEN && !api->isRejected()) {
+        size_t len = api->waitFromRadio(buf, WEBSOCKET_POLL_MSEC);
+        // This blocks until the client has taken the message, which is what holds back the pump for a slow client
+        if (len && ulfius_websocket_send_message(manager, U_WEBSOCKET_OPCODE_BINARY, len, (const char *)buf) != U_OK)
+            break;
+    }
+    api->release(); // last thing we do with it, the pump may delete it from here on
+}
+
+static void websocketIncoming(const struct _u_request *req, struct _websocket_manager *manager,
+                              const struct _websocket_message *message, void *user_data)
+{
+    WebSocketAPI *api = (WebSocketAPI *)user_data;
+
+    if (message->opcode != U_WEBSOCKET_OPCODE_BINARY)
+        return;
+    if (!api->queueToRadio((const uint8_t *)message->data, message->data_len))
+        LOG_WARN("Websocket client sent a ToRadio we can't take, dropping it\n");
+}
+
+static void websocketClosed(const struct _u_request *req, struct _websocket_manager *manager, void *user_data)
+{
+    ((WebSocketAPI *)user_data)->markClosed(); // last thing we do with it, the pump may delete it from here on
+}
+
+int handleAPIv1WebSocket(const struct _u_request *req, struct _u_response *res, void *user_data)
+{
+    WebSocketAPI *api = new WebSocketAPI();
+    if (!webSocketPump || !webSocketPump->add(api)) {
+        if (!webSocketPump)
+            delete api;
+        ulfius_set_string_body_response(res, 503, "Too many websocket clients");
+        return U_CALLBACK_COMPLETE;
+    }
+
+    if (ulfius_set_websocket_response(res, NULL, NULL, &websocketManager, api, &websocketIncoming, api, &websocketClosed,
+                                      api) != U_OK) {
+        LOG_ERROR("Can't set up websocket response\n");
+        // Neither ulfius callback will ever run, so let go for both and the pump will delete it
+        api->markClosed();
+        api->release();
+        ulfius_set_string_body_response(res, 500, "Websocket error");
+    }
+    return U_CALLBACK_COMPLETE;
+}
+
+#endif
+#endif
+#endif
@@ -0,0 +1,127 @@
+#pragma once
+#ifdef PORTDUINO_LINUX_HARDWARE
+#if __has_include(<ulfius.h>)
+#include "ulfius-cfg.h"
+#ifndef U_DISABLE_WEBSOCKET
+#include "PhoneAPI.h"
+#include "concurrency/OSThread.h"
+#include "mesh/api/PhonePacketFanout.h"
+#include "ulfius.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// How many encoded FromRadio messages we hold for a websocket client which hasn't taken them yet.  Once these are full we stop
+// pulling from its PhoneAPI, so a slow client only makes its own mesh packets back up (and eventually get dropped)
+#define WEBSOCKET_TX_FRAMES 8
+
+// How many ToRadio messages a client may send ahead of us handing them to its PhoneAPI
+#define WEBSOCKET_RX_FRAMES 4
+
+/**
+ * A PhoneAPI for one websocket connection to the web server, so web clients get FromRadio messages pushed to them as soon as
+ * they are available instead of having to poll /api/v1/fromradio.  Each ToRadio and FromRadio message is one binary
+ * websocket message.
+ *
+ * The websocket itself is run by ulfius threads, while PhoneAPI may only be used from our own thread, so the two sides meet
+ * in small bounded queues: WebSocketPump moves ToRadio messages in and FromRadio messages out, and the ulfius manager thread
+ * blocks until there is something to send.
+ */
+class WebSocketAPI : public PhoneAPI
+{
+    struct Frame {
+        uint16_t len;
+        uint8_t buf[MAX_TO_FROM_RADIO_SIZE];
+    };
+
+    std::mutex lock;
+    std::condition_variable txReady;
+
+    Frame txFrames[WEBSOCKET_TX_FRAMES];
+    uint8_t txHead = 0, txCount = 0;
+
+    Frame rxFrames[WEBSOCKET_RX_FRAMES];
+    uint8_t rxHead = 0, rxCount = 0;
+
+    /// Set by the ulfius thread once the websocket has closed
+    volatile bool closed = false;
+
+    /// Held by the ulfius side: one by the manager thread and one until the websocket has closed.  Both are dropped under
+    /// lock as the last thing the ulfius side does with us, and only once both are gone may WebSocketPump delete us
+    uint8_t ulfiusRefs = 2;
+
+    /// Our slot in apiPacketFanout, attached from our own thread the first time we are pumped
+    int fanoutSlot = -1;
+    bool fanoutAttached = false;
+
+    /// Set once we found the fanout full, the manager thread then closes the websocket
+    volatile bool rejected = false;
+
+  public:
+    virtual ~WebSocketAPI();
+
+    // Called from ulfius threads
+
+    /// Queue a ToRadio message from the client.  @return false if the client is too far ahead of us and it was dropped
+    bool queueToRadio(const uint8_t *buf, size_t len);
+
+    /// Wait up to timeoutMsec for a FromRadio message.  @return its length, or 0 if there was none
+    size_t waitFromRadio(uint8_t *buf, uint32_t timeoutMsec);
+
+    /// The websocket has closed, and the ulfius side drops its reference for that
+    void markClosed();
+
+    /// The manager thread is done with us and drops its reference
+    void release();
+
+    /// @return true if we have no slot in apiPacketFanout and the websocket should be closed
+    bool isRejected() const { return rejected; }
+
+    // Called from WebSocketPump
+
+    /// Move messages between the websocket and PhoneAPI.  @return false once the websocket has closed and the ulfius side
+    /// has let go of us, after which we may be deleted
+    bool pump();
+
+  protected:
+    virtual bool checkIsConnected() override { return !closed; }
+
+    /// Mesh packets are shared with TCP API clients and the other websockets
+    virtual meshtastic_MeshPacket *getPacketForPhone() override;
+    virtual void releasePacketForPhone(meshtastic_MeshPacket *p) override;
+};
+
+/**
+ * Runs every open WebSocketAPI from the main thread
+ */
+class WebSocketPump : private concurrency::OSThread
+{
+    std::mutex lock; // protects pending, which ulfius threads add new connections to
+
+    WebSocketAPI *pending[MAX_WEBSOCKET_CLIENTS] = {};
+    WebSocketAPI *clients[MAX_WEBSOCKET_CLIENTS] = {};
+
+  public:
+    WebSocketPump() : concurrency::OSThread("WebSocket") {}
+
+    /// Start running a new connection.  @return false (and deletes it) if we already have as many clients as we allow
+    bool add(WebSocketAPI *api);
+
+    /// Also run as soon as the main thread wakes if add() queued a new connection, so add() never touches our schedule itself
+    virtual bool shouldRun(unsigned long time) override { return hasPending || concurrency::OSThread::shouldRun(time); }
+
+  protected:
+    virtual int32_t runOnce() override;
+
+  private:
+    std::atomic<bool> hasPending{false};
+};
+
+extern WebSocketPump *webSocketPump;
+
+/// ulfius endpoint which upgrades a request to a websocket speaking the PhoneAPI protocol
+int handleAPIv1WebSocket(const struct _u_request *req, struct _u_response *res, void *user_data);
+
+#endif
+#endif
+#endif
@@ -88,6 +88,7 @@ class CannedMessageModule : public SinglePortModule, public Observable<const UIF
             return false;
         }
     }
+    virtual int getDispatchPortNum() override { return ANY_PORTNUM; } // we also track the signal of every packet we see
 
   protected:
     virtual int32_t runOnce() override;
@@ -1,6 +1,7 @@
 #include "NeighborInfoModule.h"
 #include "Default.h"
 #include "MeshService.h"
+#include "MeshTopology.h"
 #include "NodeDB.h"
 #include "RTC.h"
 
@@ -131,6 +132,7 @@ bool NeighborInfoModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp,
     if (np) {
         printNeighborInfo("RECEIVED", np);
         updateNeighbors(mp, np);
+        meshTopology->addNeighborInfo(*np);
     } else if (mp.hop_start != 0 && mp.hop_start == mp.hop_limit) {
         // If the hopLimit is the same as hopStart, then it is a neighbor
         getOrCreateNeighbor(mp.from, mp.from, 0, mp.rx_snr); // Set the broadcast interval to 0, as we don't know it
@@ -11,6 +11,7 @@
 #include "configuration.h"
 #include "gps/GeoCoord.h"
 #include "main.h"
+#include "mesh/PositionDelta.h"
 #include "meshtastic/atak.pb.h"
 #include "sleep.h"
 #include "target_specific.h"
@@ -43,6 +44,11 @@ PositionModule::PositionModule()
 
 bool PositionModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp, meshtastic_Position *pptr)
 {
+    if (mp.decoded.portnum == POSITION_DELTA_PORTNUM) {
+        handleCompactPosition(mp);
+        return false;
+    }
+
     auto p = *pptr;
 
     // If inbound message is a replay (or spoof!) of our own messages, we shouldn't process
@@ -93,7 +99,8 @@ bool PositionModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp, mes
         trySetRtc(p, isLocal, force);
     }
 
-    nodeDB->updatePosition(getFrom(&mp), p);
+    bool onPrimary = channels.getByIndex(mp.channel).role == meshtastic_Channel_Role_PRIMARY;
+    nodeDB->updatePosition(getFrom(&mp), p, RX_SRC_RADIO, onPrimary);
     if (channels.getByIndex(mp.channel).settings.has_module_settings) {
         precision = channels.getByIndex(mp.channel).settings.module_settings.position_precision;
     } else if (channels.getByIndex(mp.channel).role == meshtastic_Channel_Role_PRIMARY) {
@@ -132,11 +139,95 @@ void PositionModule::trySetRtc(meshtastic_Position p, bool isLocal, bool forceUp
     perhapsSetRTC(isLocal ? RTCQualityNTP : RTCQualityFromNet, &tv, forceUpdate);
 }
 
+void PositionModule::handleCompactPosition(const meshtastic_MeshPacket &mp)
+{
+    PositionDelta d;
+    if (getFrom(&mp) == nodeDB->getNodeNum() ||
+        !decodePositionDelta(mp.decoded.payload.bytes, mp.decoded.payload.size, d)) {
+        return;
+    }
+
+    meshtastic_Position p;
+    if (!nodeDB->updatePosition(getFrom(&mp), d, &p))
+        return;
+
+    // Clients only understand full positions, so give them what we made of it
+    if (mp.to == NODENUM_BROADCAST || mp.to == nodeDB->getNodeNum()) {
+        meshtastic_MeshPacket *full = packetPool.allocCopy(mp);
+        full->decoded.portnum = meshtastic_PortNum_POSITION_APP;
+        full->decoded.payload.size =
+            pb_encode_to_bytes(full->decoded.payload.bytes, sizeof(full->decoded.payload.bytes), &meshtastic_Position_msg, &p);
+        service.sendToPhone(full);
+    }
+}
+
 meshtastic_MeshPacket *PositionModule::allocReply()
+{
+    // Answers go out on the channel the request came in on
+    return allocFullPosition(currentRequest ? currentRequest->channel : 0);
+}
+
+meshtastic_MeshPacket *PositionModule::allocFullPosition(ChannelIndex channel)
+{
+    meshtastic_Position p;
+    if (!getOurPosition(p))
+        return nullptr;
+
+    // TAK Tracker devices should send their position in a TAK packet over the ATAK port
+    if (config.device.role == meshtastic_Config_DeviceConfig_Role_TAK_TRACKER)
+        return allocAtakPli();
+
+    // Whoever gets a full position on the channel our compact ones go out on takes it as the keyframe, so it must be ours too
+    if (POSITION_COMPACT_DELTAS && channel == 0)
+        takeKeyframe(p);
+    return allocDataProtobuf(p);
+}
+
+void PositionModule::takeKeyframe(const meshtastic_Position &p)
+{
+    keyframe = p;
+    keyframeDue = false;
+    deltasSinceKeyframe = 0;
+    stats.keyframes++;
+}
+
+meshtastic_MeshPacket *PositionModule::allocPositionBroadcast()
+{
+    if (!POSITION_COMPACT_DELTAS || config.device.role == meshtastic_Config_DeviceConfig_Role_TAK_TRACKER)
+        return allocFullPosition(0);
+
+    meshtastic_Position p;
+    if (!getOurPosition(p))
+        return nullptr;
+
+    // A position with a velocity (dead reckoning) goes out in full, the velocity is what saves us packets then
+    PositionDelta d;
+    if (!keyframeDue && deltasSinceKeyframe < POSITION_KEYFRAME_INTERVAL && !p.next_update && makePositionDelta(keyframe, p, d)) {
+        meshtastic_MeshPacket *mp = allocDataPacket();
+        mp->decoded.portnum = POSITION_DELTA_PORTNUM;
+        mp->decoded.payload.size = encodePositionDelta(d, mp->decoded.payload.bytes, sizeof(mp->decoded.payload.bytes));
+
+        size_t fullSize = 0;
+        pb_get_encoded_size(&fullSize, &meshtastic_Position_msg, &p);
+        deltasSinceKeyframe++;
+        stats.deltas++;
+        if (fullSize > mp->decoded.payload.size)
+            stats.deltaBytesSaved += fullSize - mp->decoded.payload.size;
+        LOG_INFO("Sending compact position, %u bytes instead of %u (%u bytes saved in %u compact positions)\n",
+                 mp->decoded.payload.size, (unsigned)fullSize, stats.deltaBytesSaved, stats.deltas);
+        return mp;
+    }
+
+    // Everyone who gets this can make sense of the compact positions which follow
+    takeKeyframe(p);
+    return allocDataProtobuf(p);
+}
+
+bool PositionModule::getOurPosition(meshtastic_Position &p)
 {
     if (precision == 0) {
         LOG_DEBUG("Skipping location send because precision is set to 0!\n");
-        return nullptr;
+        return false;
     }
 
     meshtastic_NodeInfoLite *node = service.refreshLocalMeshNode(); // should guarantee there is now a position
@@ -147,7 +238,7 @@ meshtastic_MeshPacket *PositionModule::allocReply()
     uint32_t pos_flags = config.position.position_flags;
 
     // Populate a Position struct with ONLY the requested fields
-    meshtastic_Position p = meshtastic_Position_init_default; //   Start with an empty structure
+    p = meshtastic_Position_init_default; //   Start with an empty structure
     // if localPosition is totally empty, put our last saved position (lite) in there
     if (localPosition.latitude_i == 0 && localPosition.longitude_i == 0) {
         nodeDB->setLocalPosition(TypeConversions::ConvertToPosition(node->position));
@@ -156,7 +247,7 @@ meshtastic_MeshPacket *PositionModule::allocReply()
 
     if (localPosition.latitude_i == 0 && localPosition.longitude_i == 0) {
         LOG_WARN("Skipping position send because lat/lon are zero!\n");
-        return nullptr;
+        return false;
     }
 
     // lat/lon are unconditionally included - IF AVAILABLE!
@@ -199,7 +290,8 @@ meshtastic_MeshPacket *PositionModule::allocReply()
     if (pos_flags & meshtastic_Config_PositionConfig_PositionFlags_TIMESTAMP)
         p.timestamp = localPosition.timestamp;
 
-    if (pos_flags & meshtastic_Config_PositionConfig_PositionFlags_SEQ_NO)
+    // Compact positions name the full one they are relative to by its sequence number
+    if ((pos_flags & meshtastic_Config_PositionConfig_PositionFlags_SEQ_NO) || POSITION_COMPACT_DELTAS)
         p.seq_number = localPosition.seq_number;
 
     if (pos_flags & meshtastic_Config_PositionConfig_PositionFlags_HEADING)
@@ -208,6 +300,14 @@ meshtastic_MeshPacket *PositionModule::allocReply()
     if (pos_flags & meshtastic_Config_PositionConfig_PositionFlags_SPEED)
         p.ground_speed = localPosition.ground_speed;
 
+    // With dead reckoning everyone extrapolates us with our velocity until the next periodic broadcast, which we promise
+    uint32_t speed, track, horizonSecs;
+    if (getMotionToSend(speed, track, horizonSecs)) {
+        p.ground_speed = speed;
+        p.ground_track = track;
+        p.next_update = horizonSecs;
+    }
+
     // Strip out any time information before sending packets to other nodes - to keep the wire size small (and because other
     // nodes shouldn't trust it anyways) Note: we allow a device with a local GPS to include the time, so that gpsless
     // devices can get time.
@@ -220,12 +320,7 @@ meshtastic_MeshPacket *PositionModule::allocReply()
     }
 
     LOG_INFO("Position reply: time=%i, latI=%i, lonI=%i\n", p.time, p.latitude_i, p.longitude_i);
-
-    // TAK Tracker devices should send their position in a TAK packet over the ATAK port
-    if (config.device.role == meshtastic_Config_DeviceConfig_Role_TAK_TRACKER)
-        return allocAtakPli();
-
-    return allocDataProtobuf(p);
+    return true;
 }
 
 meshtastic_MeshPacket *PositionModule::allocAtakPli()
@@ -287,12 +382,17 @@ void PositionModule::sendOurPosition(NodeNum dest, bool wantReplies, uint8_t cha
         precision = 0;
     }
 
-    meshtastic_MeshPacket *p = allocReply();
+    // Broadcasts nobody has to answer may be compact positions
+    bool isBroadcast = dest == NODENUM_BROADCAST && !wantReplies && channel == 0;
+    meshtastic_MeshPacket *p = isBroadcast ? allocPositionBroadcast() : allocFullPosition(channel);
     if (p == nullptr) {
         LOG_DEBUG("allocReply returned a nullptr\n");
         return;
     }
 
+    if (dest == NODENUM_BROADCAST && !getMotionToSend(lastSentSpeed, lastSentTrack, lastSentHorizonSecs))
+        lastSentSpeed = lastSentTrack = lastSentHorizonSecs = 0;
+
     p->to = dest;
     p->decoded.want_response = config.device.role == meshtastic_Config_DeviceConfig_Role_TRACKER ? false : wantReplies;
     if (config.device.role == meshtastic_Config_DeviceConfig_Role_TRACKER ||
@@ -348,6 +448,10 @@ int32_t PositionModule::runOnce()
 
             lastGpsLatitude = node->position.latitude_i;
             lastGpsLongitude = node->position.longitude_i;
+            distanceLatitude = lastGpsLatitude;
+            distanceLongitude = lastGpsLongitude;
+            distanceSendMsec = now;
+            keyframeDue = true; // the periodic broadcast is always a full one
 
             sendOurPosition();
             if (config.device.role == meshtastic_Config_DeviceConfig_Role_LOST_AND_FOUND) {
@@ -360,6 +464,7 @@ int32_t PositionModule::runOnce()
         if (hasValidPosition(node2)) {
             // The minimum time (in seconds) that would pass before we are able to send a new position packet.
 
+            trackMovement(node->position);
             auto smartPosition = getDistanceTraveledSinceLastSend(node->position);
             msSinceLastSend = now - lastGpsSend;
 
@@ -372,6 +477,7 @@ int32_t PositionModule::runOnce()
                           "minTimeInterval=%ims)\n",
                           localPosition.timestamp, smartPosition.distanceTraveled, smartPosition.distanceThreshold,
                           msSinceLastSend, minimumTimeThreshold);
+                countSmartSend();
 
                 // Set the current coords as our last ones, after we've compared distance with current and decided to send
                 lastGpsLatitude = node->position.latitude_i;
@@ -404,9 +510,18 @@ struct SmartPosition PositionModule::getDistanceTraveledSinceLastSend(meshtastic
     const uint32_t distanceTravelThreshold =
         Default::getConfiguredOrDefault(config.position.broadcast_smart_minimum_distance, 100);
 
+    // Where everyone else thinks we are: where we last sent, or with dead reckoning as far as that has got us by now
+    int32_t expectedLatitude = lastGpsLatitude;
+    int32_t expectedLongitude = lastGpsLongitude;
+    if (lastSentSpeed) {
+        float secs = std::min((millis() - lastGpsSend) / 1000.0f, (float)lastSentHorizonSecs);
+        GeoCoord::deadReckon(expectedLatitude, expectedLongitude, lastSentSpeed, lastSentTrack, secs);
+    }
+
     // Determine the distance in meters between two points on the globe
-    float distanceTraveledSinceLastSend = GeoCoord::latLongToMeter(
-        lastGpsLatitude * 1e-7, lastGpsLongitude * 1e-7, currentPosition.latitude_i * 1e-7, currentPosition.longitude_i * 1e-7);
+    float distanceTraveledSinceLastSend =
+        GeoCoord::latLongToMeter(expectedLatitude * 1e-7, expectedLongitude * 1e-7, currentPosition.latitude_i * 1e-7,
+                                 currentPosition.longitude_i * 1e-7);
 
 #ifdef GPS_EXTRAVERBOSE
     LOG_DEBUG("--------LAST POSITION------------------------------------\n");
@@ -430,12 +545,80 @@ struct SmartPosition PositionModule::getDistanceTraveledSinceLastSend(meshtastic
                          .hasTraveledOverThreshold = abs(distanceTraveledSinceLastSend) >= distanceTravelThreshold};
 }
 
+bool PositionModule::isDeadReckoning()
+{
+    return POSITION_DEAD_RECKONING && config.position.position_broadcast_smart_enabled;
+}
+
+bool PositionModule::getMotionToSend(uint32_t &speed, uint32_t &track, uint32_t &horizonSecs)
+{
+    // A velocity would give away more than a channel with reduced precision means to
+    if (!isDeadReckoning() || precision != 32 || !currentSpeed || getTime() - lastFixTime > POSITION_VELOCITY_MAX_AGE_SECS)
+        return false;
+
+    speed = currentSpeed;
+    track = currentTrack;
+    uint32_t broadcastSecs =
+        Default::getConfiguredOrDefault(config.position.position_broadcast_secs, default_broadcast_interval_secs);
+    horizonSecs = std::min(broadcastSecs, (uint32_t)DEAD_RECKONING_MAX_SECS);
+    return true;
+}
+
+void PositionModule::trackMovement(const meshtastic_PositionLite &pos)
+{
+    if (!isDeadReckoning())
+        return;
+
+    // Our velocity, from the GPS if it knows it, otherwise from how far we got since the last fix we looked at
+    if (pos.time && pos.time - lastFixTime >= POSITION_VELOCITY_MIN_SECS) {
+        if (localPosition.ground_speed) {
+            currentSpeed = localPosition.ground_speed;
+            currentTrack = localPosition.ground_track;
+        } else if (lastFixTime) {
+            float meters = GeoCoord::latLongToMeter(lastFixLatitude * 1e-7, lastFixLongitude * 1e-7, pos.latitude_i * 1e-7,
+                                                    pos.longitude_i * 1e-7);
+            currentSpeed = lround(meters / (pos.time - lastFixTime) * 3.6);
+            float track = toDegrees(GeoCoord::bearing(lastFixLatitude * 1e-7, lastFixLongitude * 1e-7, pos.latitude_i * 1e-7,
+                                                      pos.longitude_i * 1e-7));
+            currentTrack = (track < 0 ? track + 360 : track) * 1e5;
+        }
+        if (currentSpeed < POSITION_MIN_SPEED_KMPH)
+            currentSpeed = 0;
+        lastFixLatitude = pos.latitude_i;
+        lastFixLongitude = pos.longitude_i;
+        lastFixTime = pos.time;
+    }
+
+    // Would a smart broadcast without dead reckoning go out now?
+    uint32_t now = millis();
+    float moved = GeoCoord::latLongToMeter(distanceLatitude * 1e-7, distanceLongitude * 1e-7, pos.latitude_i * 1e-7,
+                                           pos.longitude_i * 1e-7);
+    if (moved >= Default::getConfiguredOrDefault(config.position.broadcast_smart_minimum_distance, 100) &&
+        now - distanceSendMsec >= minimumTimeThreshold) {
+        stats.distanceSends++;
+        distanceLatitude = pos.latitude_i;
+        distanceLongitude = pos.longitude_i;
+        distanceSendMsec = now;
+    }
+}
+
+void PositionModule::countSmartSend()
+{
+    if (!isDeadReckoning())
+        return;
+
+    stats.smartSends++;
+    LOG_INFO("Dead reckoning has sent %u smart positions, going by distance alone would have sent %u\n",
+             stats.smartSends, stats.distanceSends);
+}
+
 void PositionModule::handleNewPosition()
 {
     meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(nodeDB->getNodeNum());
     const meshtastic_NodeInfoLite *node2 = service.refreshLocalMeshNode(); // should guarantee there is now a position
     // We limit our GPS broadcasts to a max rate
     if (hasValidPosition(node2)) {
+        trackMovement(node->position);
         auto smartPosition = getDistanceTraveledSinceLastSend(node->position);
         uint32_t msSinceLastSend = millis() - lastGpsSend;
         if (smartPosition.hasTraveledOverThreshold &&
@@ -446,6 +629,7 @@ void PositionModule::handleNewPosition()
                       "minTimeInterval=%ims)\n",
                       localPosition.timestamp, smartPosition.distanceTraveled, smartPosition.distanceThreshold, msSinceLastSend,
                       minimumTimeThreshold);
+            countSmartSend();
 
             // Set the current coords as our last ones, after we've compared distance with current and decided to send
             lastGpsLatitude = node->position.latitude_i;
@@ -2,6 +2,26 @@
 #include "Default.h"
 #include "ProtobufModule.h"
 #include "concurrency/OSThread.h"
+#include "mesh/PositionDelta.h"
+
+// Smart position broadcasts carry our velocity, and we only send again once we are further than broadcast_smart_minimum_distance
+// from where everyone extrapolates us to be by now, instead of from where we last were.  Off unless enabled in the build,
+// because older firmware doesn't extrapolate and would see us stand still between broadcasts
+#ifndef POSITION_DEAD_RECKONING
+#define POSITION_DEAD_RECKONING 0
+#endif
+
+// We work out our velocity from fixes at least this far apart, if the GPS doesn't tell us
+#define POSITION_VELOCITY_MIN_SECS 5
+
+// A velocity from a fix older than this isn't worth sending
+#define POSITION_VELOCITY_MAX_AGE_SECS (5 * 60)
+
+// Slower than this is GPS noise, we are standing still
+#define POSITION_MIN_SPEED_KMPH 2
+
+// At most this many compact positions follow a full one, so whoever missed it doesn't wait long for the next
+#define POSITION_KEYFRAME_INTERVAL 8
 
 /**
  * Position module for sending/receiving positions into the mesh
@@ -21,6 +41,28 @@ class PositionModule : public ProtobufModule<meshtastic_Position>, private concu
     /// We force a rebroadcast if the radio settings change
     uint32_t currentGeneration = 0;
 
+    /// Our velocity, from the GPS or from the last two fixes, in km/h and 1e-5 degrees like the GPS reports it
+    uint32_t currentSpeed = 0;
+    uint32_t currentTrack = 0;
+    int32_t lastFixLatitude = 0;
+    int32_t lastFixLongitude = 0;
+    uint32_t lastFixTime = 0;
+
+    /// The velocity our last broadcast told everyone to extrapolate us with, and for how long (0 if it didn't)
+    uint32_t lastSentSpeed = 0;
+    uint32_t lastSentTrack = 0;
+    uint32_t lastSentHorizonSecs = 0;
+
+    /// Where distance based smart broadcasts would last have sent our position, to count what dead reckoning saves
+    int32_t distanceLatitude = 0;
+    int32_t distanceLongitude = 0;
+    uint32_t distanceSendMsec = 0;
+
+    /// The last full position we sent on the primary channel, which our compact positions are relative to
+    meshtastic_Position keyframe = meshtastic_Position_init_default;
+    uint8_t deltasSinceKeyframe = 0;
+    bool keyframeDue = true;
+
   public:
     /** Constructor
      * name is for debugging output
@@ -35,7 +77,25 @@ class PositionModule : public ProtobufModule<meshtastic_Position>, private concu
 
     void handleNewPosition();
 
+    struct Stats {
+        uint32_t smartSends;      // smart broadcasts we sent with dead reckoning
+        uint32_t distanceSends;   // smart broadcasts we would have sent over the same track without dead reckoning
+        uint32_t keyframes;       // full positions sent on the primary channel, with compact positions enabled
+        uint32_t deltas;          // compact position broadcasts
+        uint32_t deltaBytesSaved; // how much smaller the compact positions were than full ones
+    };
+
+    const Stats &getStats() const { return stats; }
+
   protected:
+    /// We take compact positions as well
+    virtual bool wantPacket(const meshtastic_MeshPacket *p) override
+    {
+        return p->decoded.portnum == ourPortNum || (POSITION_COMPACT_DELTAS && p->decoded.portnum == POSITION_DELTA_PORTNUM);
+    }
+
+    virtual int getDispatchPortNum() override { return ANY_PORTNUM; }
+
     /** Called to handle a particular incoming message
 
     @return true if you've guaranteed you've handled this message and no other handlers should be considered for it
@@ -58,6 +118,32 @@ class PositionModule : public ProtobufModule<meshtastic_Position>, private concu
     uint32_t precision;
     void sendLostAndFoundText();
 
+    Stats stats = {};
+
+    /// Our position, with the fields the channel and our position flags allow
+    bool getOurPosition(meshtastic_Position &p);
+
+    /// Our position for a broadcast: a compact one if we can, otherwise a full one which is the next keyframe
+    meshtastic_MeshPacket *allocPositionBroadcast();
+
+    /// Our full position to send on channel, which is the next keyframe if that is the primary channel
+    meshtastic_MeshPacket *allocFullPosition(ChannelIndex channel);
+
+    /// Make p, which we are about to send in full on the primary channel, what our compact positions are relative to
+    void takeKeyframe(const meshtastic_Position &p);
+
+    void handleCompactPosition(const meshtastic_MeshPacket &mp);
+
+    bool isDeadReckoning();
+
+    /// The velocity to send with our position and how long everyone may extrapolate with it, if we send one
+    bool getMotionToSend(uint32_t &speed, uint32_t &track, uint32_t &horizonSecs);
+
+    /// Update our velocity and count what a distance based smart broadcast would have sent
+    void trackMovement(const meshtastic_PositionLite &pos);
+
+    void countSmartSend();
+
     const uint32_t minimumTimeThreshold =
         Default::getConfiguredOrDefaultMs(config.position.broadcast_smart_minimum_interval_secs, 30);
 };
@@ -45,12 +45,23 @@ int32_t AirQualityTelemetryModule::runOnce()
         if (!moduleConfig.telemetry.air_quality_enabled)
             return result;
 
+#if TELEMETRY_BATCH
+        meshtastic_Telemetry m = meshtastic_Telemetry_init_zero;
+        if (batch.isSampleDue() && getAirQualityTelemetry(&m))
+            batch.add(m);
+#endif
+
         uint32_t now = millis();
         if (((lastSentToMesh == 0) ||
              ((now - lastSentToMesh) >= Default::getConfiguredOrDefaultMs(moduleConfig.telemetry.air_quality_interval))) &&
             airTime->isTxAllowedChannelUtil(config.device.role != meshtastic_Config_DeviceConfig_Role_SENSOR) &&
             airTime->isTxAllowedAirUtil()) {
+#if TELEMETRY_BATCH
+            if (!batch.send())
+                sendTelemetry();
+#else
             sendTelemetry();
+#endif
             lastSentToMesh = now;
         } else if (service.isToPhoneQueueEmpty()) {
             // Just send to phone when it's not our time to send to mesh yet
@@ -58,7 +69,11 @@ int32_t AirQualityTelemetryModule::runOnce()
             sendTelemetry(NODENUM_BROADCAST, true);
         }
     }
+#if TELEMETRY_BATCH
+    return min(sendToPhoneIntervalMs, (uint32_t)TELEMETRY_BATCH_SAMPLE_SECS * 1000);
+#else
     return sendToPhoneIntervalMs;
+#endif
 }
 
 bool AirQualityTelemetryModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp, meshtastic_Telemetry *t)
@@ -85,23 +100,30 @@ bool AirQualityTelemetryModule::handleReceivedProtobuf(const meshtastic_MeshPack
     return false; // Let others look at this message also if they want
 }
 
-bool AirQualityTelemetryModule::sendTelemetry(NodeNum dest, bool phoneOnly)
+bool AirQualityTelemetryModule::getAirQualityTelemetry(meshtastic_Telemetry *m)
 {
     if (!aqi.read(&data)) {
         LOG_WARN("Skipping send measurements. Could not read AQIn\n");
         return false;
     }
 
+    m->time = getTime();
+    m->which_variant = meshtastic_Telemetry_air_quality_metrics_tag;
+    m->variant.air_quality_metrics.pm10_standard = data.pm10_standard;
+    m->variant.air_quality_metrics.pm25_standard = data.pm25_standard;
+    m->variant.air_quality_metrics.pm100_standard = data.pm100_standard;
+
+    m->variant.air_quality_metrics.pm10_environmental = data.pm10_env;
+    m->variant.air_quality_metrics.pm25_environmental = data.pm25_env;
+    m->variant.air_quality_metrics.pm100_environmental = data.pm100_env;
+    return true;
+}
+
+bool AirQualityTelemetryModule::sendTelemetry(NodeNum dest, bool phoneOnly)
+{
     meshtastic_Telemetry m;
-    m.time = getTime();
-    m.which_variant = meshtastic_Telemetry_air_quality_metrics_tag;
-    m.variant.air_quality_metrics.pm10_standard = data.pm10_standard;
-    m.variant.air_quality_metrics.pm25_standard = data.pm25_standard;
-    m.variant.air_quality_metrics.pm100_standard = data.pm100_standard;
-
-    m.variant.air_quality_metrics.pm10_environmental = data.pm10_env;
-    m.variant.air_quality_metrics.pm25_environmental = data.pm25_env;
-    m.variant.air_quality_metrics.pm100_environmental = data.pm100_env;
+    if (!getAirQualityTelemetry(&m))
+        return false;
 
     LOG_INFO("(Sending): PM1.0(Standard)=%i, PM2.5(Standard)=%i, PM10.0(Standard)=%i\n",
              m.variant.air_quality_metrics.pm10_standard, m.variant.air_quality_metrics.pm25_standard,
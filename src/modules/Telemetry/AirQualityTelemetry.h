@@ -7,13 +7,15 @@
 #include "Adafruit_PM25AQI.h"
 #include "NodeDB.h"
 #include "ProtobufModule.h"
+#include "TelemetryBatch.h"
 
 class AirQualityTelemetryModule : private concurrency::OSThread, public ProtobufModule<meshtastic_Telemetry>
 {
   public:
     AirQualityTelemetryModule()
         : concurrency::OSThread("AirQualityTelemetryModule"),
-          ProtobufModule("AirQualityTelemetry", meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg)
+          ProtobufModule("AirQualityTelemetry", meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg),
+          batch(meshtastic_Telemetry_air_quality_metrics_tag)
     {
         lastMeasurementPacket = nullptr;
         setIntervalFromNow(10 * 1000);
@@ -32,6 +34,10 @@ class AirQualityTelemetryModule : private concurrency::OSThread, public Protobuf
     bool sendTelemetry(NodeNum dest = NODENUM_BROADCAST, bool wantReplies = false);
 
   private:
+    /// Read the sensor into m.  @return false if it failed
+    bool getAirQualityTelemetry(meshtastic_Telemetry *m);
+
+    TelemetryBatch batch; // readings waiting to be sent, with TELEMETRY_BATCH
     Adafruit_PM25AQI aqi;
     PM25_AQI_Data data = {0};
     bool firstTime = 1;
@@ -6,6 +6,7 @@
 #include "../mesh/generated/meshtastic/telemetry.pb.h"
 #include "NodeDB.h"
 #include "ProtobufModule.h"
+#include "TelemetryBatch.h"
 #include <OLEDDisplay.h>
 #include <OLEDDisplayUi.h>
 
@@ -14,7 +15,8 @@ class EnvironmentTelemetryModule : private concurrency::OSThread, public Protobu
   public:
     EnvironmentTelemetryModule()
         : concurrency::OSThread("EnvironmentTelemetryModule"),
-          ProtobufModule("EnvironmentTelemetry", meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg)
+          ProtobufModule("EnvironmentTelemetry", meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg),
+          batch(meshtastic_Telemetry_environment_metrics_tag)
     {
         lastMeasurementPacket = nullptr;
         setIntervalFromNow(10 * 1000);
@@ -38,7 +40,11 @@ class EnvironmentTelemetryModule : private concurrency::OSThread, public Protobu
     bool sendTelemetry(NodeNum dest = NODENUM_BROADCAST, bool wantReplies = false);
 
   private:
+    /// Read all our sensors into m.  @return false if any of them failed, or we have none
+    bool getEnvironmentTelemetry(meshtastic_Telemetry *m);
+
     float CelsiusToFahrenheit(float c);
+    TelemetryBatch batch; // readings waiting to be sent, with TELEMETRY_BATCH
     bool firstTime = 1;
     meshtastic_MeshPacket *lastMeasurementPacket;
     uint32_t sendToPhoneIntervalMs = SECONDS_IN_MINUTE * 1000; // Send to phone every minute
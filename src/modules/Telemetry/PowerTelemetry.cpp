@@ -68,11 +68,23 @@ int32_t PowerTelemetryModule::runOnce()
         if (!moduleConfig.telemetry.power_measurement_enabled)
             return disable();
 
+#if TELEMETRY_BATCH
+        meshtastic_Telemetry m;
+        if (batch.isSampleDue() && getPowerTelemetry(&m))
+            batch.add(m);
+        result = min(result, (uint32_t)TELEMETRY_BATCH_SAMPLE_SECS * 1000);
+#endif
+
         uint32_t now = millis();
         if (((lastSentToMesh == 0) ||
              ((now - lastSentToMesh) >= Default::getConfiguredOrDefaultMs(moduleConfig.telemetry.power_update_interval))) &&
             airTime->isTxAllowedAirUtil()) {
+#if TELEMETRY_BATCH
+            if (!batch.send())
+                sendTelemetry();
+#else
             sendTelemetry();
+#endif
             lastSentToMesh = now;
         } else if (((lastSentToPhone == 0) || ((now - lastSentToPhone) >= sendToPhoneIntervalMs)) &&
                    (service.isToPhoneQueueEmpty())) {
@@ -163,27 +175,33 @@ bool PowerTelemetryModule::handleReceivedProtobuf(const meshtastic_MeshPacket &m
     return false; // Let others look at this message also if they want
 }
 
-bool PowerTelemetryModule::sendTelemetry(NodeNum dest, bool phoneOnly)
+bool PowerTelemetryModule::getPowerTelemetry(meshtastic_Telemetry *m)
 {
-    meshtastic_Telemetry m;
     bool valid = false;
-    m.time = getTime();
-    m.which_variant = meshtastic_Telemetry_power_metrics_tag;
-
-    m.variant.power_metrics.ch1_voltage = 0;
-    m.variant.power_metrics.ch1_current = 0;
-    m.variant.power_metrics.ch2_voltage = 0;
-    m.variant.power_metrics.ch2_current = 0;
-    m.variant.power_metrics.ch3_voltage = 0;
-    m.variant.power_metrics.ch3_current = 0;
+    m->time = getTime();
+    m->which_variant = meshtastic_Telemetry_power_metrics_tag;
+
+    m->variant.power_metrics.ch1_voltage = 0;
+    m->variant.power_metrics.ch1_current = 0;
+    m->variant.power_metrics.ch2_voltage = 0;
+    m->variant.power_metrics.ch2_current = 0;
+    m->variant.power_metrics.ch3_voltage = 0;
+    m->variant.power_metrics.ch3_current = 0;
 #if HAS_TELEMETRY && !defined(ARCH_PORTDUINO)
     if (ina219Sensor.hasSensor())
-        valid = ina219Sensor.getMetrics(&m);
+        valid = ina219Sensor.getMetrics(m);
     if (ina260Sensor.hasSensor())
-        valid = ina260Sensor.getMetrics(&m);
+        valid = ina260Sensor.getMetrics(m);
     if (ina3221Sensor.hasSensor())
-        valid = ina3221Sensor.getMetrics(&m);
+        valid = ina3221Sensor.getMetrics(m);
 #endif
+    return valid;
+}
+
+bool PowerTelemetryModule::sendTelemetry(NodeNum dest, bool phoneOnly)
+{
+    meshtastic_Telemetry m;
+    bool valid = getPowerTelemetry(&m);
 
     if (valid) {
         LOG_INFO("(Sending): ch1_voltage=%f, ch1_current=%f, ch2_voltage=%f, ch2_current=%f, "
@@ -212,7 +230,9 @@ bool PowerTelemetryModule::sendTelemetry(NodeNum dest, bool phoneOnly)
             LOG_INFO("Sending packet to mesh\n");
             service.sendToMesh(p, RX_SRC_LOCAL, true);
 
-            if (config.device.role == meshtastic_Config_DeviceConfig_Role_SENSOR && config.power.is_power_saving) {
+            // Deep sleep would lose the readings we batch
+            if (config.device.role == meshtastic_Config_DeviceConfig_Role_SENSOR && config.power.is_power_saving &&
+                !TELEMETRY_BATCH) {
                 LOG_DEBUG("Starting next execution in 5 seconds and then going to sleep.\n");
                 sleepOnNextExecution = true;
                 setIntervalFromNow(5000);
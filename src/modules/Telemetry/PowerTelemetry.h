@@ -7,6 +7,7 @@
 #include "../mesh/generated/meshtastic/telemetry.pb.h"
 #include "NodeDB.h"
 #include "ProtobufModule.h"
+#include "TelemetryBatch.h"
 #include <OLEDDisplay.h>
 #include <OLEDDisplayUi.h>
 
@@ -15,7 +16,8 @@ class PowerTelemetryModule : private concurrency::OSThread, public ProtobufModul
   public:
     PowerTelemetryModule()
         : concurrency::OSThread("PowerTelemetryModule"),
-          ProtobufModule("PowerTelemetry", meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg)
+          ProtobufModule("PowerTelemetry", meshtastic_PortNum_TELEMETRY_APP, &meshtastic_Telemetry_msg),
+          batch(meshtastic_Telemetry_power_metrics_tag)
     {
         lastMeasurementPacket = nullptr;
         setIntervalFromNow(10 * 1000);
@@ -39,6 +41,10 @@ class PowerTelemetryModule : private concurrency::OSThread, public ProtobufModul
     bool sendTelemetry(NodeNum dest = NODENUM_BROADCAST, bool wantReplies = false);
 
   private:
+    /// Read our sensors into m.  @return false if we have none which worked
+    bool getPowerTelemetry(meshtastic_Telemetry *m);
+
+    TelemetryBatch batch; // readings waiting to be sent, with TELEMETRY_BATCH
     bool firstTime = 1;
     meshtastic_MeshPacket *lastMeasurementPacket;
     uint32_t sendToPhoneIntervalMs = SECONDS_IN_MINUTE * 1000; // Send to phone every minute
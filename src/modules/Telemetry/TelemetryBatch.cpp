@@ -0,0 +1,392 @@
+#include "TelemetryBatch.h"
+
+#if !MESHTASTIC_EXCLUDE_ENVIRONMENTAL_SENSOR
+
+#include "MeshService.h"
+#include "NodeDB.h"
+#include "Router.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum FieldType : uint8_t { FIELD_FLOAT, FIELD_UINT32, FIELD_UINT16 };
+
+/// Where a metric is in its Telemetry variant, and how many steps of the fixed point value make one unit
+struct BatchField {
+    uint8_t offset;
+    FieldType type;
+    uint16_t scale;
+};
+
+static const BatchField environmentFields[] = {
+    {offsetof(meshtastic_EnvironmentMetrics, temperature), FIELD_FLOAT, 100},
+    {offsetof(meshtastic_EnvironmentMetrics, relative_humidity), FIELD_FLOAT, 10},
+    {offsetof(meshtastic_EnvironmentMetrics, barometric_pressure), FIELD_FLOAT, 10},
+    {offsetof(meshtastic_EnvironmentMetrics, gas_resistance), FIELD_FLOAT, 1000},
+    {offsetof(meshtastic_EnvironmentMetrics, voltage), FIELD_FLOAT, 1000},
+    {offsetof(meshtastic_EnvironmentMetrics, current), FIELD_FLOAT, 10},
+    {offsetof(meshtastic_EnvironmentMetrics, iaq), FIELD_UINT16, 1},
+    {offsetof(meshtastic_EnvironmentMetrics, distance), FIELD_FLOAT, 10},
+    {offsetof(meshtastic_EnvironmentMetrics, lux), FIELD_FLOAT, 10},
+    {offsetof(meshtastic_EnvironmentMetrics, white_lux), FIELD_FLOAT, 10},
+};
+
+static const BatchField powerFields[] = {
+    {offsetof(meshtastic_PowerMetrics, ch1_voltage), FIELD_FLOAT, 1000},
+    {offsetof(meshtastic_PowerMetrics, ch1_current), FIELD_FLOAT, 10},
+    {offsetof(meshtastic_PowerMetrics, ch2_voltage), FIELD_FLOAT, 1000},
+    {offsetof(meshtastic_PowerMetrics, ch2_current), FIELD_FLOAT, 10},
+    {offsetof(meshtastic_PowerMetrics, ch3_voltage), FIELD_FLOAT, 1000},
+    {offsetof(meshtastic_PowerMetrics, ch3_current), FIELD_FLOAT, 10},
+};
+
+static const BatchField airQualityFields[] = {
+    {offsetof(meshtastic_AirQualityMetrics, pm10_standard), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, pm25_standard), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, pm100_standard), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, pm10_environmental), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, pm25_environmental), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, pm100_environmental), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, particles_03um), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, particles_05um), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, particles_10um), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, particles_25um), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, particles_50um), FIELD_UINT32, 1},
+    {offsetof(meshtastic_AirQualityMetrics, particles_100um), FIELD_UINT32, 1},
+};
+
+/// The metrics of a variant we batch, NULL for the others
+static const BatchField *getFields(pb_size_t variant, size_t &numFields)
+{
+    switch (variant) {
+    case meshtastic_Telemetry_environment_metrics_tag:
+        numFields = sizeof(environmentFields) / sizeof(environmentFields[0]);
+        return environmentFields;
+    case meshtastic_Telemetry_power_metrics_tag:
+        numFields = sizeof(powerFields) / sizeof(powerFields[0]);
+        return powerFields;
+    case meshtastic_Telemetry_air_quality_metrics_tag:
+        numFields = sizeof(airQualityFields) / sizeof(airQualityFields[0]);
+        return airQualityFields;
+    default:
+        numFields = 0;
+        return NULL;
+    }
+}
+
+static int32_t getField(const meshtastic_Telemetry &m, const BatchField &f)
+{
+    const uint8_t *metric = (const uint8_t *)&m.variant + f.offset;
+    switch (f.type) {
+    case FIELD_FLOAT: {
+        float v = *(const float *)metric * f.scale;
+        if (!(v > INT32_MIN && v < INT32_MAX)) // NAN from a sensor that failed too
+            return 0;
+        return (int32_t)lroundf(v);
+    }
+    case FIELD_UINT32:
+        return (int32_t) * (const uint32_t *)metric;
+    default:
+        return *(const uint16_t *)metric;
+    }
+}
+
+static void setField(meshtastic_Telemetry &m, const BatchField &f, int32_t value)
+{
+    uint8_t *metric = (uint8_t *)&m.variant + f.offset;
+    switch (f.type) {
+    case FIELD_FLOAT:
+        *(float *)metric = (float)value / f.scale;
+        break;
+    case FIELD_UINT32:
+        *(uint32_t *)metric = (uint32_t)value;
+        break;
+    default:
+        *(uint16_t *)metric = (uint16_t)value;
+        break;
+    }
+}
+
+/// Write v at pos if it fits, @return where the next one goes either way
+static size_t putVarint(uint8_t *buf, size_t pos, size_t bufSize, uint32_t v)
+{
+    do {
+        if (pos < bufSize)
+            buf[pos] = (v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+        pos++;
+        v >>= 7;
+    } while (v);
+    return pos;
+}
+
+static size_t putZigzag(uint8_t *buf, size_t pos, size_t bufSize, int32_t value)
+{
+    return putVarint(buf, pos, bufSize, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+/// @return where the next one starts, 0 if buf ended first
+static size_t getVarint(const uint8_t *buf, size_t pos, size_t len, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= len)
+            return 0;
+        uint8_t b = buf[pos++];
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return pos;
+    }
+    return 0;
+}
+
+static size_t getZigzag(const uint8_t *buf, size_t pos, size_t len, int32_t &value)
+{
+    uint32_t v;
+    pos = getVarint(buf, pos, len, v);
+    value = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+    return pos;
+}
+
+TelemetryBatch::TelemetryBatch(pb_size_t _variant) : variant(_variant)
+{
+    getFields(variant, numFields);
+}
+
+TelemetryBatch::~TelemetryBatch()
+{
+    free(times);
+    free(values);
+}
+
+bool TelemetryBatch::add(const meshtastic_Telemetry &m)
+{
+    lastSampleMsec = millis();
+    if (!numFields || m.which_variant != variant)
+        return false;
+
+    // Only allocated once batching is really used, most nodes never do
+    if (!times) {
+        times = (uint32_t *)malloc(TELEMETRY_BATCH_MAX_SAMPLES * sizeof(uint32_t));
+        values = (int32_t *)malloc(TELEMETRY_BATCH_MAX_SAMPLES * numFields * sizeof(int32_t));
+        if (!times || !values) {
+            LOG_ERROR("Can't allocate telemetry batch of %d readings\n", TELEMETRY_BATCH_MAX_SAMPLES);
+            free(times);
+            free(values);
+            times = NULL;
+            values = NULL;
+            return false;
+        }
+    }
+
+    if (count == TELEMETRY_BATCH_MAX_SAMPLES) {
+        head = (head + 1) % TELEMETRY_BATCH_MAX_SAMPLES;
+        count--;
+    }
+    size_t slot = (head + count) % TELEMETRY_BATCH_MAX_SAMPLES;
+    times[slot] = m.time;
+    const BatchField *fields = getFields(variant, numFields);
+    for (size_t f = 0; f < numFields; f++)
+        values[slot * numFields + f] = getField(m, fields[f]);
+    count++;
+    return true;
+}
+
+size_t TelemetryBatch::encode(size_t n, uint8_t *buf, size_t bufSize) const
+{
+    uint32_t mask = 0;
+    for (size_t i = 0; i < n; i++)
+        for (size_t f = 0; f < numFields; f++)
+            if (valuesAt(i)[f])
+                mask |= 1 << f;
+
+    if (bufSize)
+        buf[0] = (uint8_t)variant;
+    size_t pos = putVarint(buf, 1, bufSize, mask);
+    pos = putVarint(buf, pos, bufSize, n);
+    pos = putVarint(buf, pos, bufSize, timeAt(0));
+
+    for (size_t i = 0; i < n; i++) {
+        const int32_t *v = valuesAt(i);
+        const int32_t *prev = i ? valuesAt(i - 1) : NULL;
+        if (i)
+            pos = putZigzag(buf, pos, bufSize, timeAt(i) - timeAt(i - 1));
+        for (size_t f = 0; f < numFields; f++)
+            if (mask & (1 << f))
+                pos = putZigzag(buf, pos, bufSize, v[f] - (prev ? prev[f] : 0));
+        if (pos > bufSize)
+            break; // no need to find out by how much
+    }
+    return pos;
+}
+
+size_t TelemetryBatch::take(meshtastic_MeshPacket &p)
+{
+    if (!count)
+        return 0;
+
+    uint8_t *buf = p.decoded.payload.bytes;
+    size_t bufSize = sizeof(p.decoded.payload.bytes);
+    size_t n = count, len;
+    while ((len = encode(n, buf, bufSize)) > bufSize && n > 1)
+        n--;
+
+    p.decoded.portnum = TELEMETRY_BATCH_PORTNUM;
+    p.decoded.payload.size = len;
+    head = (head + n) % TELEMETRY_BATCH_MAX_SAMPLES;
+    count -= n;
+    return n;
+}
+
+size_t TelemetryBatch::send(NodeNum dest)
+{
+    // A single reading is no smaller batched, and everyone understands it on its own
+    if (count <= 1) {
+        clear();
+        return 0;
+    }
+
+    size_t sent = 0;
+    for (int i = 0; i < TELEMETRY_BATCH_MAX_PACKETS && count; i++) {
+        meshtastic_MeshPacket *p = router->allocForSending();
+        size_t n = take(*p);
+        p->to = dest;
+        p->decoded.want_response = false;
+        if (config.device.role == meshtastic_Config_DeviceConfig_Role_SENSOR)
+            p->priority = meshtastic_MeshPacket_Priority_RELIABLE;
+        else
+            p->priority = meshtastic_MeshPacket_Priority_BACKGROUND;
+        LOG_INFO("Sending %u telemetry readings in a %u byte batch\n", (unsigned)n, p->decoded.payload.size);
+        service.sendToMesh(p, RX_SRC_LOCAL, true);
+        sent += n;
+    }
+    if (count)
+        LOG_INFO("%u telemetry readings wait for the next batch\n", (unsigned)count);
+    return sent;
+}
+
+bool TelemetryBatch::Reader::begin(const uint8_t *_buf, size_t _len)
+{
+    buf = _buf;
+    len = _len;
+    done = count = 0;
+    memset(values, 0, sizeof(values));
+
+    size_t numFields;
+    uint32_t n;
+    if (len < 1 || !getFields(buf[0], numFields))
+        return false;
+    variant = buf[0];
+    pos = getVarint(buf, 1, len, mask);
+    if (pos)
+        pos = getVarint(buf, pos, len, n);
+    if (pos)
+        pos = getVarint(buf, pos, len, time);
+    if (!pos || mask >> numFields)
+        return false;
+
+    count = n;
+    return true;
+}
+
+bool TelemetryBatch::Reader::next(meshtastic_Telemetry &m)
+{
+    if (done >= count)
+        return false;
+
+    size_t numFields;
+    const BatchField *fields = getFields(variant, numFields);
+    if (done) {
+        int32_t dt;
+        pos = getZigzag(buf, pos, len, dt);
+        time += dt;
+    }
+    for (size_t f = 0; f < numFields && pos; f++) {
+        int32_t d;
+        if (mask & (1 << f)) {
+            pos = getZigzag(buf, pos, len, d);
+            values[f] += d;
+        }
+    }
+    if (!pos) {
+        count = done; // garbled, stop here
+        return false;
+    }
+
+    memset(&m, 0, sizeof(m));
+    m.time = time;
+    m.which_variant = variant;
+    for (size_t f = 0; f < numFields; f++)
+        setField(m, fields[f], values[f]);
+    done++;
+    return true;
+}
+
+ProcessMessage TelemetryBatchModule::handleReceived(const meshtastic_MeshPacket &mp)
+{
+    if (getFrom(&mp) == nodeDB->getNodeNum())
+        return ProcessMessage::CONTINUE;
+
+    TelemetryBatch::Reader check;
+    if (!check.begin(mp.decoded.payload.bytes, mp.decoded.payload.size)) {
+        LOG_WARN("Ignoring telemetry batch from 0x%x we don't understand\n", mp.from);
+        return ProcessMessage::CONTINUE;
+    }
+    LOG_DEBUG("Telemetry batch from 0x%x with %u readings\n", mp.from, (unsigned)check.size());
+
+    if (mp.to != NODENUM_BROADCAST && mp.to != nodeDB->getNodeNum())
+        return ProcessMessage::CONTINUE;
+
+    if (backlogCount == TELEMETRY_BATCH_UNPACK_BACKLOG) {
+        LOG_WARN("Too many telemetry batches waiting for the phone, dropping the oldest\n");
+        packetPool.release(backlog[backlogHead]);
+        backlogHead = (backlogHead + 1) % TELEMETRY_BATCH_UNPACK_BACKLOG;
+        backlogCount--;
+    }
+    backlog[(backlogHead + backlogCount) % TELEMETRY_BATCH_UNPACK_BACKLOG] = packetPool.allocCopy(mp);
+    backlogCount++;
+    setIntervalFromNow(0);
+    return ProcessMessage::CONTINUE;
+}
+
+bool TelemetryBatchModule::nextReading(meshtastic_Telemetry &m)
+{
+    while (true) {
+        if (unpacking && reader.next(m))
+            return true;
+        if (unpacking) {
+            packetPool.release(unpacking);
+            unpacking = NULL;
+        }
+        if (!backlogCount)
+            return false;
+
+        unpacking = backlog[backlogHead];
+        backlogHead = (backlogHead + 1) % TELEMETRY_BATCH_UNPACK_BACKLOG;
+        backlogCount--;
+        reader.begin(unpacking->decoded.payload.bytes, unpacking->decoded.payload.size); // checked when it came in
+    }
+}
+
+int32_t TelemetryBatchModule::runOnce()
+{
+    for (int i = 0; i < TELEMETRY_BATCH_UNPACK_READINGS; i++) {
+        if (service.getToPhoneQueueDepth() >= TELEMETRY_BATCH_UNPACK_QUEUE_MAX)
+            return TELEMETRY_BATCH_UNPACK_MSEC; // let the phone catch up first
+
+        meshtastic_Telemetry m;
+        if (!nextReading(m))
+            return INT32_MAX; // until handleReceived() has another batch for us
+
+        // Each reading goes to the phone as if it had been sent on its own, so it needs an id of its own too
+        meshtastic_MeshPacket *p = packetPool.allocCopy(*unpacking);
+        p->id = generatePacketId();
+        p->decoded.portnum = meshtastic_PortNum_TELEMETRY_APP;
+        p->decoded.payload.size =
+            pb_encode_to_bytes(p->decoded.payload.bytes, sizeof(p->decoded.payload.bytes), &meshtastic_Telemetry_msg, &m);
+        service.sendToPhone(p);
+    }
+    return TELEMETRY_BATCH_UNPACK_MSEC;
+}
+
+#endif
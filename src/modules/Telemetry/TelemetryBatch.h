@@ -0,0 +1,145 @@
+#pragma once
+
+#include "configuration.h"
+
+#if !MESHTASTIC_EXCLUDE_ENVIRONMENTAL_SENSOR
+
+#include "../mesh/generated/meshtastic/telemetry.pb.h"
+#include "SinglePortModule.h"
+#include "concurrency/OSThread.h"
+
+// Environment, power and air quality readings are taken every TELEMETRY_BATCH_SAMPLE_SECS and kept, and at the update interval
+// everything kept is sent in a few TelemetryBatch packets instead of one reading a packet.  Off unless enabled in the build,
+// because older firmware doesn't unpack batches into the single readings phones understand
+#ifndef TELEMETRY_BATCH
+#define TELEMETRY_BATCH 0
+#endif
+
+// The port batches go out on.  It has no upstream PortNum yet, so it sits in the private range (>= 256)
+#define TELEMETRY_BATCH_PORTNUM ((meshtastic_PortNum)301)
+
+// The update interval should be a good many of these, or there's little to batch
+#ifndef TELEMETRY_BATCH_SAMPLE_SECS
+#define TELEMETRY_BATCH_SAMPLE_SECS 60
+#endif
+
+// How many readings each sensor module keeps, once it has this many the oldest goes
+#ifndef TELEMETRY_BATCH_MAX_SAMPLES
+#define TELEMETRY_BATCH_MAX_SAMPLES 60
+#endif
+
+// Most batch packets we send at once, whatever doesn't fit waits for the next update interval
+#define TELEMETRY_BATCH_MAX_PACKETS 4
+
+// Batches we receive are handed to the phone a few readings at a time, and only while its queue is no more than half full, so
+// they don't push out packets it hasn't seen yet
+#define TELEMETRY_BATCH_UNPACK_READINGS 8
+#define TELEMETRY_BATCH_UNPACK_MSEC 250
+#define TELEMETRY_BATCH_UNPACK_QUEUE_MAX (MAX_RX_TOPHONE / 2)
+
+// How many received batches may wait to be unpacked, beyond that the oldest is dropped
+#define TELEMETRY_BATCH_UNPACK_BACKLOG 4
+
+/**
+ * The readings of one kind of telemetry (one Telemetry variant) which haven't been sent yet, in a ring buffer.
+ *
+ * Readings are kept as fixed point integers at the resolution the sensors are good for (e.g. 0.01 °C), so a receiver gets
+ * values rounded to that.  They go out on TELEMETRY_BATCH_PORTNUM as: the variant tag, a varint mask of the metrics in the batch
+ * (those not zero in any of its readings), a varint count and the varint time of the first reading, then for each reading its
+ * time and each metric in the mask as zigzag varints of the difference from the reading before (from 0 for the first).
+ * Slowly changing metrics take a byte or two a reading that way, against 5 bytes each and a packet header in a Telemetry.
+ */
+class TelemetryBatch
+{
+  public:
+    explicit TelemetryBatch(pb_size_t variant);
+    ~TelemetryBatch();
+
+    /// Keep m, a reading of our variant.  @return false if we couldn't allocate our ring buffer
+    bool add(const meshtastic_Telemetry &m);
+
+    size_t size() const { return count; }
+    bool isEmpty() const { return count == 0; }
+    void clear() { head = count = 0; }
+
+    /// Is it time to take another reading
+    bool isSampleDue() const { return !lastSampleMsec || millis() - lastSampleMsec >= TELEMETRY_BATCH_SAMPLE_SECS * 1000; }
+
+    /**
+     * Put as many of the oldest readings as fit into p's payload, and forget them
+     * @return how many readings went in, 0 if we have none
+     */
+    size_t take(meshtastic_MeshPacket &p);
+
+    /**
+     * Send what we have into the mesh, in at most TELEMETRY_BATCH_MAX_PACKETS packets
+     * @return how many readings went out.  0 if we had only one (or none), which is forgotten and better sent the usual way
+     */
+    size_t send(NodeNum dest = NODENUM_BROADCAST);
+
+    /// Reads the readings in a batch someone sent us back out
+    class Reader
+    {
+      public:
+        /// @return false if buf isn't a batch we understand
+        bool begin(const uint8_t *buf, size_t len);
+
+        /// @return false once there are no more readings (or the rest of the batch is garbled)
+        bool next(meshtastic_Telemetry &m);
+
+        size_t size() const { return count; }
+
+      private:
+        const uint8_t *buf = NULL;
+        size_t len = 0, pos = 0;
+        pb_size_t variant = 0;
+        uint32_t mask = 0;
+        size_t count = 0, done = 0;
+        uint32_t time = 0;
+        int32_t values[16] = {};
+    };
+
+  private:
+    pb_size_t variant;
+    uint32_t *times = NULL; // ring buffers of TELEMETRY_BATCH_MAX_SAMPLES readings
+    int32_t *values = NULL; // numFields values per reading
+    size_t numFields;
+    size_t head = 0, count = 0;
+    uint32_t lastSampleMsec = 0;
+
+    const int32_t *valuesAt(size_t i) const { return values + ((head + i) % TELEMETRY_BATCH_MAX_SAMPLES) * numFields; }
+    uint32_t timeAt(size_t i) const { return times[(head + i) % TELEMETRY_BATCH_MAX_SAMPLES]; }
+
+    /// @return how many bytes the oldest n readings take, which is more than bufSize if they didn't fit
+    size_t encode(size_t n, uint8_t *buf, size_t bufSize) const;
+};
+
+/**
+ * Unpacks the TelemetryBatch packets we receive into single Telemetry readings for the phone, which only knows those.
+ */
+class TelemetryBatchModule : public SinglePortModule, private concurrency::OSThread
+{
+  public:
+    TelemetryBatchModule()
+        : SinglePortModule("TelemetryBatch", TELEMETRY_BATCH_PORTNUM), concurrency::OSThread("TelemetryBatch")
+    {
+    }
+
+  protected:
+    virtual ProcessMessage handleReceived(const meshtastic_MeshPacket &mp) override;
+
+    /// Hands the phone the next few readings of the batches we received
+    virtual int32_t runOnce() override;
+
+  private:
+    meshtastic_MeshPacket *unpacking = NULL; // the batch reader is going through
+    TelemetryBatch::Reader reader;
+
+    meshtastic_MeshPacket *backlog[TELEMETRY_BATCH_UNPACK_BACKLOG] = {};
+    uint8_t backlogHead = 0, backlogCount = 0;
+
+    /// @return false once every batch we received has been unpacked
+    bool nextReading(meshtastic_Telemetry &m);
+};
+
+#endif
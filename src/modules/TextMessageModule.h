@@ -21,6 +21,7 @@ class TextMessageModule : public SinglePortModule, public Observable<const mesht
     */
     virtual ProcessMessage handleReceived(const meshtastic_MeshPacket &mp) override;
     virtual bool wantPacket(const meshtastic_MeshPacket *p) override;
+    virtual int getDispatchPortNum() override { return ANY_PORTNUM; } // isTextPayload() takes several portnums
 };
 
 extern TextMessageModule *textMessageModule;
\ No newline at end of file
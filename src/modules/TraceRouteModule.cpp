@@ -1,5 +1,7 @@
 #include "TraceRouteModule.h"
 #include "MeshService.h"
+#include "MeshTopology.h"
+#include "RTC.h"
 
 TraceRouteModule *traceRouteModule;
 
@@ -7,7 +9,15 @@ bool TraceRouteModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp, m
 {
     // Only handle a response
     if (mp.decoded.request_id) {
-        printRoute(r, mp.to, mp.from);
+        // Someone answered from their cache, which might be older than what we know
+        if (mp.decoded.source) {
+            printRoute(r, mp.to, mp.decoded.dest);
+            LOG_INFO("Route to 0x%x was answered by 0x%x from its cache\n", mp.decoded.dest, mp.decoded.source);
+        } else {
+            printRoute(r, mp.to, mp.from);
+            meshTopology->addRoute(mp.to, *r, mp.from);
+            cacheTracedRoute(mp.to, *r, mp.from);
+        }
     }
 
     return false; // let it be handled by RoutingModule
@@ -20,6 +30,7 @@ void TraceRouteModule::alterReceivedProtobuf(meshtastic_MeshPacket &p, meshtasti
     if (!incoming.request_id && p.to != nodeDB->getNodeNum()) {
         appendMyID(r);
         printRoute(r, p.from, NODENUM_BROADCAST);
+        meshTopology->addRoute(p.from, *r, 0);
 
         // Set updated route to the payload of the to be flooded packet
         p.decoded.payload.size =
@@ -27,6 +38,112 @@ void TraceRouteModule::alterReceivedProtobuf(meshtastic_MeshPacket &p, meshtasti
     }
 }
 
+void TraceRouteModule::cacheRoute(NodeNum dest, const uint32_t *route, size_t count, bool reversed)
+{
+    NodeNum ourNodeNum = nodeDB->getNodeNum();
+    if (dest == NODENUM_BROADCAST || dest == ourNodeNum || count > sizeof(cache[0].route) / sizeof(cache[0].route[0]))
+        return;
+
+    // Reuse the slot for dest, or else a free one, or else the oldest
+    CachedRoute *slot = &cache[0];
+    for (auto &c : cache) {
+        if (c.dest == dest) {
+            slot = &c;
+            break;
+        }
+        if (slot->dest && (!c.dest || (int32_t)(c.cachedAt - slot->cachedAt) < 0))
+            slot = &c;
+    }
+
+    slot->dest = dest;
+    slot->cachedAt = millis();
+    slot->count = count;
+    for (size_t i = 0; i < count; i++)
+        slot->route[i] = reversed ? route[count - 1 - i] : route[i];
+}
+
+void TraceRouteModule::cacheTracedRoute(NodeNum origin, const meshtastic_RouteDiscovery &r, NodeNum dest)
+{
+    NodeNum ourNodeNum = nodeDB->getNodeNum();
+    if (origin == ourNodeNum) {
+        cacheRoute(dest, r.route, r.route_count, false);
+        return;
+    }
+    if (dest == ourNodeNum) {
+        cacheRoute(origin, r.route, r.route_count, true);
+        return;
+    }
+
+    // We were on the way, so we know the way from here to both ends
+    for (pb_size_t i = 0; i < r.route_count; i++) {
+        if (r.route[i] == ourNodeNum) {
+            cacheRoute(dest, r.route + i + 1, r.route_count - i - 1, false);
+            cacheRoute(origin, r.route, i, true);
+            return;
+        }
+    }
+}
+
+const TraceRouteModule::CachedRoute *TraceRouteModule::findRoute(NodeNum dest)
+{
+    for (auto &c : cache) {
+        if (c.dest == dest) {
+            if (millis() - c.cachedAt > TRACEROUTE_CACHE_TTL_SECS * 1000UL) {
+                c.dest = 0;
+                return NULL;
+            }
+            return &c;
+        }
+    }
+    return NULL;
+}
+
+meshtastic_MeshPacket *TraceRouteModule::allocCachedReply(const meshtastic_MeshPacket &req)
+{
+    if (req.decoded.request_id || !req.decoded.want_response || req.to == NODENUM_BROADCAST)
+        return NULL;
+
+    const CachedRoute *cached = findRoute(req.to);
+    if (!cached)
+        return NULL;
+
+    NodeNum origin = getFrom(&req);
+    meshtastic_RouteDiscovery full = meshtastic_RouteDiscovery_init_zero;
+    for (pb_size_t i = 0; i < cached->count; i++)
+        full.route[full.route_count++] = cached->route[i];
+
+    LOG_INFO("Answering traceroute from 0x%x to 0x%x with the route we cached %u s ago\n", origin, req.to,
+             (millis() - cached->cachedAt) / 1000);
+    printRoute(&full, origin, req.to);
+
+    meshtastic_MeshPacket *reply = allocDataProtobuf(full);
+    setReplyTo(reply, req);
+    reply->hop_start = reply->hop_limit;
+    reply->want_ack = false;                      // whoever asked will just ask again
+    reply->decoded.source = nodeDB->getNodeNum(); // answered from our cache
+    reply->decoded.dest = req.to;                 // about the way to the destination
+    return reply;
+}
+
+bool TraceRouteModule::answerFromCache(const meshtastic_MeshPacket &req)
+{
+    if (req.which_payload_variant != meshtastic_MeshPacket_decoded_tag ||
+        req.decoded.portnum != meshtastic_PortNum_TRACEROUTE_APP || req.to == nodeDB->getNodeNum())
+        return false;
+
+    meshtastic_MeshPacket *reply = allocCachedReply(req);
+    if (!reply)
+        return false;
+
+    // Only the phone sees it, as if the destination had answered, so nothing we know about the destination is touched
+    reply->from = req.to;
+    reply->to = nodeDB->getNodeNum();
+    reply->hop_limit = reply->hop_start = 0;
+    reply->rx_time = getValidTime(RTCQualityFromNet);
+    service.sendToPhone(reply);
+    return true;
+}
+
 void TraceRouteModule::appendMyID(meshtastic_RouteDiscovery *updated)
 {
     // Length of route array can normally not be exceeded due to the max. hop_limit of 7
@@ -67,6 +184,9 @@ meshtastic_MeshPacket *TraceRouteModule::allocReply()
     updated = &scratch;
 
     printRoute(updated, req.from, req.to);
+    meshTopology->addRoute(req.from, *updated, req.to);
+    if (getFrom(&req) != nodeDB->getNodeNum())
+        cacheTracedRoute(req.from, *updated, req.to);
 
     // Create a MeshPacket with this payload and set it as the reply
     meshtastic_MeshPacket *reply = allocDataProtobuf(*updated);
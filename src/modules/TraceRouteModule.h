@@ -1,14 +1,33 @@
 #pragma once
 #include "ProtobufModule.h"
 
+// How many destinations we remember a route to
+#define TRACEROUTE_CACHE_SIZE 16
+
+// How long a route we traced (or saw traced) is good enough to answer a traceroute with, instead of flooding a new one
+#define TRACEROUTE_CACHE_TTL_SECS (5 * 60)
+
 /**
  * A module that traces the route to a certain destination node
+ *
+ * Routes we see traced are cached for a while, keyed by destination: the origin and the destination of a traceroute learn
+ * the whole route, and every node on it learns the part from itself to either end.  A traceroute to a destination we have
+ * a fresh route to is answered from the cache, but only if it comes from our phone: the answer goes straight back to it, as
+ * if the destination had sent it.  Traceroutes we relay are always relayed, because stock clients take whoever answers a
+ * traceroute for its destination.  Answers from a cache have the data source field set to whoever answered and the data
+ * dest field to the destination, and are never cached, so a route can't live longer than the TTL by being passed around.
  */
 class TraceRouteModule : public ProtobufModule<meshtastic_RouteDiscovery>
 {
   public:
     TraceRouteModule();
 
+    /**
+     * Answer a traceroute request from our phone from the cache
+     * @return true if we did, and the request mustn't be sent
+     */
+    bool answerFromCache(const meshtastic_MeshPacket &req);
+
   protected:
     bool handleReceivedProtobuf(const meshtastic_MeshPacket &mp, meshtastic_RouteDiscovery *r) override;
 
@@ -19,6 +38,15 @@ class TraceRouteModule : public ProtobufModule<meshtastic_RouteDiscovery>
     void alterReceivedProtobuf(meshtastic_MeshPacket &p, meshtastic_RouteDiscovery *r) override;
 
   private:
+    struct CachedRoute {
+        NodeNum dest;      // 0 for a free slot
+        uint32_t cachedAt; // millis()
+        pb_size_t count;
+        uint32_t route[8]; // the nodes between us and dest
+    };
+
+    CachedRoute cache[TRACEROUTE_CACHE_SIZE] = {};
+
     // Call to add your ID to the route array of a RouteDiscovery message
     void appendMyID(meshtastic_RouteDiscovery *r);
 
@@ -26,6 +54,18 @@ class TraceRouteModule : public ProtobufModule<meshtastic_RouteDiscovery>
        Set origin to where the request came from.
        Set dest to the ID of its destination, or NODENUM_BROADCAST if it has not yet arrived there. */
     void printRoute(meshtastic_RouteDiscovery *r, uint32_t origin, uint32_t dest);
+
+    /// Remember the count nodes of route as the way to dest, in reverse order if reversed
+    void cacheRoute(NodeNum dest, const uint32_t *route, size_t count, bool reversed);
+
+    /// Learn what we can from a traced route which went from origin through r to dest
+    void cacheTracedRoute(NodeNum origin, const meshtastic_RouteDiscovery &r, NodeNum dest);
+
+    /// @return our route to dest if it is fresh, otherwise NULL
+    const CachedRoute *findRoute(NodeNum dest);
+
+    /// Build the answer to req, a traceroute from our phone, from the cache if we can
+    meshtastic_MeshPacket *allocCachedReply(const meshtastic_MeshPacket &req);
 };
 
-extern TraceRouteModule *traceRouteModule;
\ No newline at end of file
+extern TraceRouteModule *traceRouteModule;
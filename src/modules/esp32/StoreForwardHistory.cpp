@@ -0,0 +1,381 @@
+#include "StoreForwardHistory.h"
+#include "RTC.h"
+#include <stdlib.h>
+#include <string.h>
+#if SF_COMPRESS_PAYLOADS
+#include "mesh/compression/unishox2.h"
+#endif
+#ifdef ARCH_PORTDUINO
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define SF_HISTORY_MAGIC 0x31574653 // "SFW1"
+#define SF_RECORD_ALIGN 8
+#define SF_RECORD_COMPRESSED 0x01
+
+static size_t alignRecord(size_t size)
+{
+    return (size + SF_RECORD_ALIGN - 1) & ~(size_t)(SF_RECORD_ALIGN - 1);
+}
+
+size_t StoreForwardHistory::maxRecordSize()
+{
+    return alignRecord(sizeof(Record) + meshtastic_Constants_DATA_PAYLOAD_LEN);
+}
+
+StoreForwardHistory::~StoreForwardHistory()
+{
+#ifdef ARCH_PORTDUINO
+    if (map) {
+        munmap(map, mapSize);
+        return;
+    }
+#endif
+    free(directs);
+    free(ring);
+}
+
+bool StoreForwardHistory::allocIndexes()
+{
+#ifdef ARCH_ESP32
+    directs = (DirectList *)ps_calloc(SF_DIRECT_MAX_DESTS, sizeof(DirectList));
+#else
+    directs = (DirectList *)calloc(SF_DIRECT_MAX_DESTS, sizeof(DirectList));
+#endif
+    return directs != NULL;
+}
+
+void StoreForwardHistory::clearIndexes()
+{
+    numBuckets = bucketHead = 0;
+    memset(directs, 0, SF_DIRECT_MAX_DESTS * sizeof(DirectList));
+}
+
+StoreForwardHistory::DirectList *StoreForwardHistory::findDirects(NodeNum to)
+{
+    for (size_t i = 0; i < SF_DIRECT_MAX_DESTS; i++)
+        if (directs[i].to == to)
+            return &directs[i];
+    return NULL;
+}
+
+bool StoreForwardHistory::begin(size_t _capacity)
+{
+    capacity = alignRecord(_capacity);
+#ifdef ARCH_ESP32
+    ring = (uint8_t *)ps_malloc(capacity);
+#else
+    ring = (uint8_t *)malloc(capacity);
+#endif
+    if (!ring || !allocIndexes())
+        return false;
+
+    reset();
+    return true;
+}
+
+#ifdef ARCH_PORTDUINO
+bool StoreForwardHistory::beginFile(const char *path, size_t _capacity)
+{
+    capacity = alignRecord(_capacity);
+    mapSize = sizeof(Header) + capacity;
+    if (!allocIndexes())
+        return false;
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Can't open S&F history %s\n", path);
+        return false;
+    }
+    off_t oldSize = lseek(fd, 0, SEEK_END);
+    if (ftruncate(fd, mapSize) != 0) {
+        LOG_ERROR("Can't grow S&F history %s to %u bytes\n", path, (unsigned)mapSize);
+        close(fd);
+        return false;
+    }
+    map = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (map == MAP_FAILED) {
+        LOG_ERROR("Can't map S&F history %s\n", path);
+        map = NULL;
+        return false;
+    }
+
+    header = (Header *)map;
+    ring = (uint8_t *)map + sizeof(Header);
+
+    if (oldSize < (off_t)sizeof(Header) || header->magic != SF_HISTORY_MAGIC || header->capacity != capacity ||
+        header->head < header->tail || header->head - header->tail > capacity) {
+        LOG_INFO("Starting a new S&F history in %s\n", path);
+        reset();
+    } else {
+        rebuildIndexes();
+        LOG_INFO("S&F history %s holds %u messages from before we restarted\n", path, numStored);
+    }
+    return true;
+}
+#endif
+
+void StoreForwardHistory::reset()
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = SF_HISTORY_MAGIC;
+    header->capacity = capacity;
+    // Start one lap in, so no record is ever at position 0
+    header->head = header->tail = capacity;
+    numStored = 0;
+    clearIndexes();
+}
+
+/// Drop the oldest records until there are bytes free after head
+void StoreForwardHistory::makeRoom(size_t bytes)
+{
+    while (header->head + bytes - header->tail > capacity) {
+        Record *r = recordAt(header->tail);
+        if (r->size == 0) {
+            header->tail += capacity - header->tail % capacity;
+        } else {
+            header->tail += r->size;
+            numStored--;
+        }
+    }
+}
+
+void StoreForwardHistory::add(const meshtastic_MeshPacket &mp)
+{
+    if (!isReady())
+        return;
+
+    const auto &p = mp.decoded;
+    const uint8_t *payload = p.payload.bytes;
+    uint16_t len = p.payload.size;
+    uint8_t flags = 0;
+
+#if SF_COMPRESS_PAYLOADS
+    // unishox2 only knows text, so keep the compressed version only if it really is smaller and comes back the same
+    char compressed[meshtastic_Constants_DATA_PAYLOAD_LEN * 2];
+    char check[meshtastic_Constants_DATA_PAYLOAD_LEN * 2];
+    int clen = len ? unishox2_compress_simple((const char *)p.payload.bytes, len, compressed) : 0;
+    if (clen > 0 && clen < len && unishox2_decompress_simple(compressed, clen, check) == len &&
+        memcmp(check, p.payload.bytes, len) == 0) {
+        payload = (const uint8_t *)compressed;
+        len = clen;
+        flags |= SF_RECORD_COMPRESSED;
+    }
+#endif
+
+    size_t size = alignRecord(sizeof(Record) + len);
+
+    // Records don't wrap, pad to the end of the ring if this one wouldn't fit there
+    size_t untilEnd = capacity - header->head % capacity;
+    if (size > untilEnd) {
+        makeRoom(untilEnd);
+        recordAt(header->head)->size = 0;
+        header->head += untilEnd;
+    }
+    makeRoom(size);
+
+    HistoryPos pos = header->head;
+    Record *r = recordAt(pos);
+    r->size = size;
+    r->time = getTime();
+    r->to = mp.to;
+    r->from = mp.from;
+    r->nextBroadcast = 0;
+    r->channel = mp.channel;
+    r->flags = flags;
+    r->len = len;
+    memcpy(r + 1, payload, len);
+
+    if (mp.to == NODENUM_BROADCAST) {
+        if (isLive(header->lastBroadcast))
+            recordAt(header->lastBroadcast)->nextBroadcast = pos;
+        header->lastBroadcast = pos;
+    }
+    index(pos, r);
+
+    // Only now is the record part of the history, on portduino this is what makes it survive a restart
+    header->head += size;
+    header->total++;
+    numStored++;
+}
+
+void StoreForwardHistory::index(HistoryPos pos, const Record *r)
+{
+    if (r->to != NODENUM_BROADCAST) {
+        indexDirect(r->to, pos);
+        return;
+    }
+
+    Bucket *b = numBuckets ? &buckets[(bucketHead + SF_TIME_BUCKETS - 1) % SF_TIME_BUCKETS] : NULL;
+    if (!b || r->time >= b->start + SF_BUCKET_SECS || r->time < b->start) {
+        b = &buckets[bucketHead];
+        bucketHead = (bucketHead + 1) % SF_TIME_BUCKETS;
+        if (numBuckets < SF_TIME_BUCKETS)
+            numBuckets++;
+        b->start = r->time - r->time % SF_BUCKET_SECS;
+        b->firstBroadcast = pos;
+    }
+}
+
+void StoreForwardHistory::indexDirect(NodeNum to, HistoryPos pos)
+{
+    DirectList *list = findDirects(to);
+    if (!list) {
+        // Take a free slot, or else forget whoever got a message longest ago
+        list = &directs[0];
+        for (size_t i = 1; i < SF_DIRECT_MAX_DESTS && list->count; i++) {
+            DirectList &l = directs[i];
+            if (!l.count || l.pos[l.count - 1] < list->pos[list->count - 1])
+                list = &l;
+        }
+        list->to = to;
+        list->count = 0;
+    }
+
+    // Drop what has been overwritten, and the oldest once we have as many as we keep
+    uint8_t drop = 0;
+    while (drop < list->count && (!isLive(list->pos[drop]) || list->count - drop >= SF_DIRECT_PER_DEST))
+        drop++;
+    list->count -= drop;
+    memmove(list->pos, list->pos + drop, list->count * sizeof(HistoryPos));
+    list->pos[list->count++] = pos;
+}
+
+void StoreForwardHistory::rebuildIndexes()
+{
+    numStored = 0;
+    clearIndexes();
+
+    HistoryPos pos = header->tail, lastBroadcast = 0;
+    while (pos < header->head) {
+        Record *r = recordAt(pos);
+        if (r->size == 0) {
+            pos += capacity - pos % capacity;
+            continue;
+        }
+        if (r->size < sizeof(Record) || r->size % SF_RECORD_ALIGN || r->size > capacity - pos % capacity ||
+            r->len > r->size - sizeof(Record)) {
+            LOG_WARN("S&F history is damaged after %u messages, dropping the rest\n", numStored);
+            break;
+        }
+        index(pos, r);
+        if (r->to == NODENUM_BROADCAST)
+            lastBroadcast = pos;
+        numStored++;
+        pos += r->size;
+    }
+    header->head = pos;
+
+    // We may have stopped between linking a broadcast and storing it
+    header->lastBroadcast = lastBroadcast;
+    if (lastBroadcast)
+        recordAt(lastBroadcast)->nextBroadcast = 0;
+}
+
+HistoryPos StoreForwardHistory::firstBroadcastSince(uint32_t since)
+{
+    // The newest bucket which started at or before since
+    HistoryPos pos = 0;
+    for (uint8_t i = 0; i < numBuckets; i++) {
+        const Bucket &b = buckets[(bucketHead + SF_TIME_BUCKETS - numBuckets + i) % SF_TIME_BUCKETS];
+        if (b.start > since)
+            break;
+        if (isLive(b.firstBroadcast))
+            pos = b.firstBroadcast;
+    }
+
+    // since is older than our buckets go back, walk from the oldest record to the first broadcast
+    if (!pos) {
+        for (HistoryPos p = header->tail; p < header->head;) {
+            Record *r = recordAt(p);
+            if (r->size == 0) {
+                p += capacity - p % capacity;
+            } else if (r->to == NODENUM_BROADCAST) {
+                pos = p;
+                break;
+            } else {
+                p += r->size;
+            }
+        }
+    }
+
+    while (pos && recordAt(pos)->time < since)
+        pos = recordAt(pos)->nextBroadcast;
+    return pos;
+}
+
+size_t StoreForwardHistory::query(NodeNum client, uint32_t since, Cursor &cursor, HistoryPos *out, size_t max)
+{
+    if (!isReady())
+        return 0;
+
+    // Carry on after the last broadcast we sent, unless that has been overwritten or is outside the window
+    HistoryPos b;
+    if (isLive(cursor.lastBroadcast) && recordAt(cursor.lastBroadcast)->time >= since)
+        b = recordAt(cursor.lastBroadcast)->nextBroadcast;
+    else
+        b = firstBroadcastSince(since);
+
+    const DirectList *list = findDirects(client);
+    const HistoryPos *d = list ? list->pos : NULL;
+    size_t numDirects = list ? list->count : 0;
+    size_t di = 0;
+    while (di < numDirects &&
+           (d[di] <= cursor.lastDirect || !isLive(d[di]) || recordAt(d[di])->time < since || recordAt(d[di])->from == client))
+        di++;
+
+    size_t n = 0;
+    while (n < max) {
+        while (b && isLive(b) && recordAt(b)->from == client)
+            b = recordAt(b)->nextBroadcast;
+        if (b && !isLive(b))
+            b = 0;
+
+        bool haveDirect = di < numDirects;
+        if (!b && !haveDirect)
+            break;
+
+        if (b && (!haveDirect || b < d[di])) {
+            out[n++] = cursor.lastBroadcast = b;
+            b = recordAt(b)->nextBroadcast;
+        } else {
+            out[n++] = cursor.lastDirect = d[di++];
+            while (di < numDirects && recordAt(d[di])->from == client)
+                di++;
+        }
+    }
+    return n;
+}
+
+bool StoreForwardHistory::read(HistoryPos pos, PacketHistoryStruct &out)
+{
+    if (!isLive(pos))
+        return false;
+
+    const Record *r = recordAt(pos);
+    out.time = r->time;
+    out.to = r->to;
+    out.from = r->from;
+    out.channel = r->channel;
+
+#if SF_COMPRESS_PAYLOADS
+    if (r->flags & SF_RECORD_COMPRESSED) {
+        char text[meshtastic_Constants_DATA_PAYLOAD_LEN * 2];
+        int len = unishox2_decompress_simple((const char *)(r + 1), r->len, text);
+        if (len < 0 || len > (int)sizeof(out.payload))
+            return false;
+        memcpy(out.payload, text, len);
+        out.payload_size = len;
+        return true;
+    }
+#endif
+
+    if (r->len > sizeof(out.payload))
+        return false;
+    memcpy(out.payload, r + 1, r->len);
+    out.payload_size = r->len;
+    return true;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "MeshTypes.h"
+#include "configuration.h"
+#include "mesh-pb-constants.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Compress text payloads with unishox2 when that makes them smaller
+#ifndef SF_COMPRESS_PAYLOADS
+#define SF_COMPRESS_PAYLOADS 1
+#endif
+
+// Width and number of the time buckets used to find where a history window starts, 128 buckets of 10 minutes cover a day
+#define SF_BUCKET_SECS 600
+#define SF_TIME_BUCKETS 128
+
+// How many direct messages we index for each destination, and for how many destinations
+#define SF_DIRECT_PER_DEST 32
+#define SF_DIRECT_MAX_DESTS MAX_NUM_NODES
+
+/// A stored message, as handed back to StoreForwardModule
+struct PacketHistoryStruct {
+    uint32_t time;
+    uint32_t to;
+    uint32_t from;
+    uint8_t channel;
+    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
+    pb_size_t payload_size;
+};
+
+/// Where a record lives in the history: a byte position in the log which only ever grows, 0 for none
+typedef uint64_t HistoryPos;
+
+/**
+ * The messages a Store & Forward router keeps for its clients.
+ *
+ * Messages are variable length records in a byte ring, so a short text takes a few dozen bytes instead of a whole
+ * PacketHistoryStruct, and once the ring is full the oldest records make room for new ones.  Broadcasts are chained to the
+ * next broadcast, direct messages are indexed by destination, and time buckets say where each ten minutes started, so a
+ * history request costs about as much as the number of messages it returns rather than a scan of everything we hold.
+ *
+ * The ring and the direct message index (some 64 KB with a full NodeDB) live in PSRAM on ESP32.  On portduino the ring may
+ * instead be a memory mapped file, which keeps the history across restarts and can be as large as the disk allows; the
+ * indexes are rebuilt from it at startup.
+ */
+class StoreForwardHistory
+{
+  public:
+    /// How far a client has been sent, so the next request continues from there
+    struct Cursor {
+        HistoryPos lastBroadcast = 0;
+        HistoryPos lastDirect = 0;
+    };
+
+    ~StoreForwardHistory();
+
+    /// Keep up to capacity bytes of history in RAM (PSRAM where we have it).  @return false if we couldn't get the memory
+    bool begin(size_t capacity);
+
+#ifdef ARCH_PORTDUINO
+    /// Keep up to capacity bytes of history in this file, picking up whatever a previous run left there
+    bool beginFile(const char *path, size_t capacity);
+#endif
+
+    bool isReady() const { return ring != NULL; }
+
+    /// Store a decoded packet
+    void add(const meshtastic_MeshPacket &mp);
+
+    /**
+     * Find the messages for client stored at or after the time since (in getTime() seconds), which it hasn't been sent yet:
+     * broadcasts and messages to it, but not the ones it sent itself.  Advances cursor past what is returned.
+     * @return how many positions were written to out, oldest first
+     */
+    size_t query(NodeNum client, uint32_t since, Cursor &cursor, HistoryPos *out, size_t max);
+
+    /// Read a record back.  @return false if it has been overwritten since
+    bool read(HistoryPos pos, PacketHistoryStruct &out);
+
+    /// How many messages we hold now, and how many we ever stored
+    uint32_t getNumStored() const { return numStored; }
+    uint32_t getNumTotal() const { return header->total; }
+
+    /// The most a message can take in the ring
+    static size_t maxRecordSize();
+
+  private:
+    /// Kept at the start of the file on portduino, so it is saved with the records
+    struct Header {
+        uint32_t magic;
+        uint32_t total;
+        uint64_t capacity;
+        HistoryPos head; // where the next record goes
+        HistoryPos tail; // the oldest record
+        HistoryPos lastBroadcast;
+    };
+
+    struct Record {
+        uint32_t size; // of the whole record, or 0 to pad to the end of the ring
+        uint32_t time; // getTime() when it was stored
+        uint32_t to;
+        uint32_t from;
+        HistoryPos nextBroadcast; // for broadcasts, the next one, or 0 until there is one
+        uint8_t channel;
+        uint8_t flags;
+        uint16_t len; // of the stored payload
+    };
+
+    struct Bucket {
+        uint32_t start;
+        HistoryPos firstBroadcast; // or 0 if there was none
+    };
+
+    /// The direct messages to one destination
+    struct DirectList {
+        NodeNum to; // 0 for a free slot
+        uint8_t count;
+        HistoryPos pos[SF_DIRECT_PER_DEST]; // oldest first
+    };
+
+    Header ramHeader = {};
+    Header *header = &ramHeader;
+    uint8_t *ring = NULL;
+    uint64_t capacity = 0;
+    uint32_t numStored = 0;
+
+    Bucket buckets[SF_TIME_BUCKETS] = {};
+    uint8_t bucketHead = 0, numBuckets = 0;
+
+    DirectList *directs = NULL; // SF_DIRECT_MAX_DESTS of them
+
+#ifdef ARCH_PORTDUINO
+    void *map = NULL;
+    size_t mapSize = 0;
+#endif
+
+    Record *recordAt(HistoryPos pos) const { return (Record *)(ring + pos % capacity); }
+    bool isLive(HistoryPos pos) const { return pos >= header->tail && pos < header->head; }
+
+    /// Get the memory for the indexes.  @return false if we couldn't
+    bool allocIndexes();
+    void clearIndexes();
+    DirectList *findDirects(NodeNum to);
+
+    void reset();
+    void makeRoom(size_t bytes);
+    void index(HistoryPos pos, const Record *r);
+    void indexDirect(NodeNum to, HistoryPos pos);
+    void rebuildIndexes();
+
+    /// The first broadcast stored at or after since, or 0 if there is none
+    HistoryPos firstBroadcastSince(uint32_t since);
+};
@@ -26,25 +26,23 @@
 #include <Arduino.h>
 #include <iterator>
 #include <map>
+#ifdef ARCH_PORTDUINO
+#include "platform/portduino/PortduinoGlue.h"
+#endif
 
 StoreForwardModule *storeForwardModule;
 
 int32_t StoreForwardModule::runOnce()
 {
-#ifdef ARCH_ESP32
+#if defined(ARCH_ESP32) || defined(ARCH_PORTDUINO)
     if (moduleConfig.store_forward.enabled && is_server) {
+        bool replaying = false;
+        for (auto &r : replays)
+            replaying = replaying || r.to;
+
         // Send out the message queue.
-        if (this->busy) {
-            // Only send packets if the channel is less than 25% utilized.
-            if (airTime->isTxAllowedChannelUtil(true)) {
-                storeForwardModule->sendPayload(this->busyTo, this->packetHistoryTXQueue_index);
-                if (this->packetHistoryTXQueue_index < packetHistoryTXQueue_size - 1) {
-                    this->packetHistoryTXQueue_index++;
-                } else {
-                    this->packetHistoryTXQueue_index = 0;
-                    this->busy = false;
-                }
-            }
+        if (replaying) {
+            return replayNextMessage();
         } else if (this->heartbeat && (millis() - lastHeartbeat > (heartbeatInterval * 1000)) &&
                    airTime->isTxAllowedChannelUtil(true)) {
             lastHeartbeat = millis();
@@ -62,6 +60,59 @@ int32_t StoreForwardModule::runOnce()
     return disable();
 }
 
+/**
+ * Sends the next history message, taking turns between the clients we are sending history to.
+ *
+ * How soon we send again depends on how busy the channel is, whether we still have duty cycle left, and whether the radio has
+ * sent what we gave it last time, so a history dump neither floods a busy channel nor crawls along on an idle one.
+ */
+int32_t StoreForwardModule::replayNextMessage()
+{
+    // Let the radio catch up before we queue more
+    meshtastic_QueueStatus qs = router->getQueueStatus();
+    if (qs.maxlen && qs.free + 1 < qs.maxlen)
+        return SF_REPLAY_MIN_MSEC;
+
+    // Hold off while the channel is busier than the polite limit or we are out of duty cycle, otherwise pace ourselves
+    // between SF_REPLAY_MIN_MSEC on an idle channel and packetTimeMax as it nears the limit
+    float util = airTime->channelUtilizationPercent();
+    float polite = airTime->getPoliteChannelUtilPercent();
+    if (util >= polite || !airTime->isTxAllowedAirUtil())
+        return this->packetTimeMax;
+
+    for (uint8_t i = 0; i < SF_MAX_REPLAYS; i++) {
+        StoreForwardReplay &r = replays[(nextReplay + i) % SF_MAX_REPLAYS];
+        if (!r.to)
+            continue;
+
+        nextReplay = (nextReplay + i + 1) % SF_MAX_REPLAYS;
+        storeForwardModule->sendPayload(r.to, r.queue[r.index]);
+        if (++r.index >= r.size)
+            r.to = 0; // done with this client
+        break;
+    }
+
+    return SF_REPLAY_MIN_MSEC + (int32_t)((this->packetTimeMax - SF_REPLAY_MIN_MSEC) * util / polite);
+}
+
+StoreForwardReplay *StoreForwardModule::replayFor(NodeNum to)
+{
+    StoreForwardReplay *slot = NULL;
+    for (auto &r : replays) {
+        if (r.to == to)
+            return NULL;
+        if (!r.to && !slot)
+            slot = &r;
+    }
+    return slot;
+}
+
+void StoreForwardModule::allocReplays()
+{
+    for (auto &r : replays)
+        r.queue = new HistoryPos[this->historyReturnMax];
+}
+
 /**
  * Populates the PSRAM with data to be sent later when a device is out of range.
  */
@@ -75,23 +126,43 @@ void StoreForwardModule::populatePSRAM()
     LOG_DEBUG("*** Before PSRAM initialization: heap %d/%d PSRAM %d/%d\n", memGet.getFreeHeap(), memGet.getHeapSize(),
               memGet.getFreePsram(), memGet.getPsramSize());
 
-    this->packetHistoryTXQueue =
-        static_cast<PacketHistoryStruct *>(ps_calloc(this->historyReturnMax, sizeof(PacketHistoryStruct)));
+    this->allocReplays();
 
     /* Use a maximum of 2/3 the available PSRAM unless otherwise specified.
         Note: This needs to be done after every thing that would use PSRAM
     */
-    uint32_t numberOfPackets =
-        (this->records ? this->records : (((memGet.getFreePsram() / 3) * 2) / sizeof(PacketHistoryStruct)));
-    this->records = numberOfPackets;
+    size_t historyBytes = this->records ? this->records * StoreForwardHistory::maxRecordSize()
+                                        : (memGet.getFreePsram() / 3) * 2;
+    // records is the most we can hold, short messages take less room so we usually fit more
+    this->records = historyBytes / StoreForwardHistory::maxRecordSize();
 
-    this->packetHistory = static_cast<PacketHistoryStruct *>(ps_calloc(numberOfPackets, sizeof(PacketHistoryStruct)));
+    if (!history.begin(historyBytes))
+        LOG_ERROR("*** Can't allocate %u bytes of PSRAM for S&F history\n", (unsigned)historyBytes);
 
     LOG_DEBUG("*** After PSRAM initialization: heap %d/%d PSRAM %d/%d\n", memGet.getFreeHeap(), memGet.getHeapSize(),
               memGet.getFreePsram(), memGet.getPsramSize());
-    LOG_DEBUG("*** numberOfPackets for packetHistory - %u\n", numberOfPackets);
+    LOG_DEBUG("*** numberOfPackets for packetHistory - %u\n", this->records);
 }
 
+#ifdef ARCH_PORTDUINO
+/**
+ * Sets up the history in the file from the config file, or else in RAM.
+ */
+void StoreForwardModule::populateHistory()
+{
+    this->allocReplays();
+
+    if (!this->records)
+        this->records = settingsMap[sfhistoryrecords];
+    size_t historyBytes = (size_t)this->records * StoreForwardHistory::maxRecordSize();
+
+    if (settingsStrings[sfhistoryfile] != "" && history.beginFile(settingsStrings[sfhistoryfile].c_str(), historyBytes))
+        return;
+    if (!history.begin(historyBytes))
+        LOG_ERROR("*** Can't allocate %u bytes for S&F history\n", (unsigned)historyBytes);
+}
+#endif
+
 /**
  * Sends messages from the message history to the specified recipient.
  *
@@ -100,13 +171,15 @@ void StoreForwardModule::populatePSRAM()
  */
 void StoreForwardModule::historySend(uint32_t msAgo, uint32_t to)
 {
-    uint32_t lastIndex = lastRequest.find(to) != lastRequest.end() ? lastRequest[to] : 0;
-    uint32_t queueSize = storeForwardModule->historyQueueCreate(msAgo, to, &lastIndex);
+    // Our callers have checked there is one
+    StoreForwardReplay *replay = replayFor(to);
+    StoreForwardHistory::Cursor &cursor = lastRequest[to];
+    uint32_t queueSize = storeForwardModule->historyQueueCreate(msAgo, to, *replay, cursor);
 
     if (queueSize) {
         LOG_INFO("*** S&F - Sending %u message(s)\n", queueSize);
-        this->busy = true; // runOnce() will pickup the next steps once busy = true.
-        this->busyTo = to;
+        replay->to = to; // runOnce() will pickup the next steps once this slot is used.
+        replay->index = 0;
     } else {
         LOG_INFO("*** S&F - No history to send\n");
     }
@@ -115,8 +188,7 @@ void StoreForwardModule::historySend(uint32_t msAgo, uint32_t to)
     sf.which_variant = meshtastic_StoreAndForward_history_tag;
     sf.variant.history.history_messages = queueSize;
     sf.variant.history.window = msAgo;
-    sf.variant.history.last_request = lastIndex;
-    lastRequest[to] = lastIndex;
+    sf.variant.history.last_request = history.getNumTotal();
     storeForwardModule->sendMessage(to, sf);
 }
 
@@ -125,51 +197,21 @@ void StoreForwardModule::historySend(uint32_t msAgo, uint32_t to)
  *
  * @param msAgo The number of milliseconds ago to start the history queue.
  * @param to The NodeNum of the recipient.
- * @param last_request_index The index in the packet history of the last request from this node.
- * @return The ID of the newly created history queue.
+ * @param replay Where to queue the messages.
+ * @param cursor How far the last request from this node got, advanced past what we queue now.
+ * @return The number of messages queued.
  */
-uint32_t StoreForwardModule::historyQueueCreate(uint32_t msAgo, uint32_t to, uint32_t *last_request_index)
+uint32_t StoreForwardModule::historyQueueCreate(uint32_t msAgo, uint32_t to, StoreForwardReplay &replay,
+                                                StoreForwardHistory::Cursor &cursor)
 {
-
-    this->packetHistoryTXQueue_size = 0;
-    // If our history was cleared, ignore the last request index
-    uint32_t last_index = *last_request_index > this->packetHistoryCurrent ? 0 : *last_request_index;
-
-    for (uint32_t i = last_index; i < this->packetHistoryCurrent; i++) {
-        /*
-            LOG_DEBUG("SF historyQueueCreate\n");
-            LOG_DEBUG("SF historyQueueCreate - time %d\n", this->packetHistory[i].time);
-            LOG_DEBUG("SF historyQueueCreate - millis %d\n", millis());
-            LOG_DEBUG("SF historyQueueCreate - math %d\n", (millis() - msAgo));
-        */
-        if (this->packetHistoryTXQueue_size < this->historyReturnMax) {
-            if (this->packetHistory[i].time && (this->packetHistory[i].time < (millis() - msAgo))) {
-                /*  Copy the messages that were received by the router in the last msAgo
-                    to the packetHistoryTXQueue structure.
-                    Client not interested in packets from itself and only in broadcast packets or packets towards it. */
-                if (this->packetHistory[i].from != to &&
-                    (this->packetHistory[i].to == NODENUM_BROADCAST || this->packetHistory[i].to == to)) {
-                    this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].time = this->packetHistory[i].time;
-                    this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].to = this->packetHistory[i].to;
-                    this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].from = this->packetHistory[i].from;
-                    this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].channel = this->packetHistory[i].channel;
-                    this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].payload_size =
-                        this->packetHistory[i].payload_size;
-                    memcpy(this->packetHistoryTXQueue[this->packetHistoryTXQueue_size].payload, this->packetHistory[i].payload,
-                           meshtastic_Constants_DATA_PAYLOAD_LEN);
-                    this->packetHistoryTXQueue_size++;
-                    *last_request_index = i + 1; // Set to one higher such that we don't send the same message again
-
-                    LOG_DEBUG("*** PacketHistoryStruct time=%d, msg=%s\n", this->packetHistory[i].time,
-                              this->packetHistory[i].payload);
-                }
-            }
-        } else {
-            LOG_WARN("*** S&F - Maximum history return reached.\n");
-            return this->packetHistoryTXQueue_size;
-        }
-    }
-    return this->packetHistoryTXQueue_size;
+    uint32_t now = getTime();
+    uint32_t since = now > msAgo / 1000 ? now - msAgo / 1000 : 0;
+
+    // Only positions are queued, the messages are read back from the history as they are sent
+    replay.size = history.query(to, since, cursor, replay.queue, this->historyReturnMax);
+    if (replay.size == this->historyReturnMax)
+        LOG_WARN("*** S&F - Maximum history return reached.\n");
+    return replay.size;
 }
 
 /**
@@ -179,26 +221,7 @@ uint32_t StoreForwardModule::historyQueueCreate(uint32_t msAgo, uint32_t to, uin
  */
 void StoreForwardModule::historyAdd(const meshtastic_MeshPacket &mp)
 {
-    const auto &p = mp.decoded;
-
-    if (this->packetHistoryCurrent == this->records) {
-        LOG_WARN("*** S&F - PSRAM Full. Starting overwrite now.\n");
-        this->packetHistoryCurrent = 0;
-        this->packetHistoryMax = 0;
-        for (auto &i : lastRequest) {
-            i.second = 0; // Clear the last request index for each client device
-        }
-    }
-
-    this->packetHistory[this->packetHistoryCurrent].time = millis();
-    this->packetHistory[this->packetHistoryCurrent].to = mp.to;
-    this->packetHistory[this->packetHistoryCurrent].channel = mp.channel;
-    this->packetHistory[this->packetHistoryCurrent].from = mp.from;
-    this->packetHistory[this->packetHistoryCurrent].payload_size = p.payload.size;
-    memcpy(this->packetHistory[this->packetHistoryCurrent].payload, p.payload.bytes, meshtastic_Constants_DATA_PAYLOAD_LEN);
-
-    this->packetHistoryCurrent++;
-    this->packetHistoryMax++;
+    history.add(mp);
 }
 
 meshtastic_MeshPacket *StoreForwardModule::allocReply()
@@ -211,16 +234,22 @@ meshtastic_MeshPacket *StoreForwardModule::allocReply()
  * Sends a payload to a specified destination node using the store and forward mechanism.
  *
  * @param dest The destination node number.
- * @param packetHistory_index The index of the packet in the packet history buffer.
+ * @param pos Where the message is in the packet history.
  */
-void StoreForwardModule::sendPayload(NodeNum dest, uint32_t packetHistory_index)
+void StoreForwardModule::sendPayload(NodeNum dest, HistoryPos pos)
 {
+    PacketHistoryStruct stored;
+    if (!history.read(pos, stored)) {
+        LOG_WARN("*** S&F message was overwritten before we could send it\n");
+        return;
+    }
+
     LOG_INFO("*** Sending S&F Payload\n");
     meshtastic_MeshPacket *p = allocReply();
 
     p->to = dest;
-    p->from = this->packetHistoryTXQueue[packetHistory_index].from;
-    p->channel = this->packetHistoryTXQueue[packetHistory_index].channel;
+    p->from = stored.from;
+    p->channel = stored.channel;
 
     // Let's assume that if the router received the S&F request that the client is in range.
     //   TODO: Make this configurable.
@@ -228,10 +257,9 @@ void StoreForwardModule::sendPayload(NodeNum dest, uint32_t packetHistory_index)
 
     meshtastic_StoreAndForward sf = meshtastic_StoreAndForward_init_zero;
     sf.which_variant = meshtastic_StoreAndForward_text_tag;
-    sf.variant.text.size = this->packetHistoryTXQueue[packetHistory_index].payload_size;
-    memcpy(sf.variant.text.bytes, this->packetHistoryTXQueue[packetHistory_index].payload,
-           this->packetHistoryTXQueue[packetHistory_index].payload_size);
-    if (this->packetHistoryTXQueue[packetHistory_index].to == NODENUM_BROADCAST) {
+    sf.variant.text.size = stored.payload_size;
+    memcpy(sf.variant.text.bytes, stored.payload, stored.payload_size);
+    if (stored.to == NODENUM_BROADCAST) {
         sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_BROADCAST;
     } else {
         sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_TEXT_DIRECT;
@@ -294,8 +322,8 @@ void StoreForwardModule::statsSend(uint32_t to)
 
     sf.rr = meshtastic_StoreAndForward_RequestResponse_ROUTER_STATS;
     sf.which_variant = meshtastic_StoreAndForward_stats_tag;
-    sf.variant.stats.messages_total = this->packetHistoryMax;
-    sf.variant.stats.messages_saved = this->packetHistoryCurrent;
+    sf.variant.stats.messages_total = history.getNumTotal();
+    sf.variant.stats.messages_saved = history.getNumStored();
     sf.variant.stats.messages_max = this->records;
     sf.variant.stats.up_time = millis() / 1000;
     sf.variant.stats.requests = this->requests;
@@ -316,7 +344,7 @@ void StoreForwardModule::statsSend(uint32_t to)
  */
 ProcessMessage StoreForwardModule::handleReceived(const meshtastic_MeshPacket &mp)
 {
-#ifdef ARCH_ESP32
+#if defined(ARCH_ESP32) || defined(ARCH_PORTDUINO)
     if (moduleConfig.store_forward.enabled) {
 
         // The router node should not be sending messages as a client. Unless he is a ROUTER_CLIENT
@@ -329,7 +357,7 @@ ProcessMessage StoreForwardModule::handleReceived(const meshtastic_MeshPacket &m
                     LOG_DEBUG("*** Legacy Request to send\n");
 
                     // Send the last 60 minutes of messages.
-                    if (this->busy) {
+                    if (!replayFor(getFrom(&mp))) {
                         storeForwardModule->sendMessage(getFrom(&mp), meshtastic_StoreAndForward_RequestResponse_ROUTER_BUSY);
                         LOG_INFO("*** S&F - Busy. Try again shortly.\n");
                         meshtastic_MeshPacket *pr = allocReply();
@@ -346,7 +374,7 @@ ProcessMessage StoreForwardModule::handleReceived(const meshtastic_MeshPacket &m
                     }
                 } else {
                     storeForwardModule->historyAdd(mp);
-                    LOG_INFO("*** S&F stored. Message history contains %u records now.\n", this->packetHistoryCurrent);
+                    LOG_INFO("*** S&F stored. Message history contains %u records now.\n", history.getNumStored());
                 }
             } else if (mp.decoded.portnum == meshtastic_PortNum_STORE_FORWARD_APP) {
                 auto &p = mp.decoded;
@@ -392,10 +420,11 @@ bool StoreForwardModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp,
     case meshtastic_StoreAndForward_RequestResponse_CLIENT_ABORT:
         if (is_server) {
             // stop sending stuff, the client wants to abort or has another error
-            if ((this->busy) && (this->busyTo == getFrom(&mp))) {
-                LOG_ERROR("*** Client in ERROR or ABORT requested\n");
-                this->packetHistoryTXQueue_index = 0;
-                this->busy = false;
+            for (auto &r : replays) {
+                if (r.to == getFrom(&mp)) {
+                    LOG_ERROR("*** Client in ERROR or ABORT requested\n");
+                    r.to = 0;
+                }
             }
         }
         break;
@@ -405,7 +434,7 @@ bool StoreForwardModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp,
             requests_history++;
             LOG_INFO("*** Client Request to send HISTORY\n");
             // Send the last 60 minutes of messages.
-            if (this->busy) {
+            if (!replayFor(getFrom(&mp))) {
                 storeForwardModule->sendMessage(getFrom(&mp), meshtastic_StoreAndForward_RequestResponse_ROUTER_BUSY);
                 LOG_INFO("*** S&F - Busy. Try again shortly.\n");
             } else {
@@ -437,12 +466,8 @@ bool StoreForwardModule::handleReceivedProtobuf(const meshtastic_MeshPacket &mp,
     case meshtastic_StoreAndForward_RequestResponse_CLIENT_STATS:
         if (is_server) {
             LOG_INFO("*** Client Request to send STATS\n");
-            if (this->busy) {
-                storeForwardModule->sendMessage(getFrom(&mp), meshtastic_StoreAndForward_RequestResponse_ROUTER_BUSY);
-                LOG_INFO("*** S&F - Busy. Try again shortly.\n");
-            } else {
-                storeForwardModule->statsSend(getFrom(&mp));
-            }
+            // Just one message, which can go out between the history ones
+            storeForwardModule->statsSend(getFrom(&mp));
         }
         break;
 
@@ -516,7 +541,7 @@ StoreForwardModule::StoreForwardModule()
       ProtobufModule("StoreForward", meshtastic_PortNum_STORE_FORWARD_APP, &meshtastic_StoreAndForward_msg)
 {
 
-#ifdef ARCH_ESP32
+#if defined(ARCH_ESP32) || defined(ARCH_PORTDUINO)
 
     isPromiscuous = true; // Brown chicken brown cow
 
@@ -535,38 +560,46 @@ StoreForwardModule::StoreForwardModule()
         if ((config.device.role == meshtastic_Config_DeviceConfig_Role_ROUTER) ||
             (config.device.role == meshtastic_Config_DeviceConfig_Role_ROUTER_CLIENT)) {
             LOG_INFO("*** Initializing Store & Forward Module in Router mode\n");
-            if (memGet.getPsramSize() > 0) {
-                if (memGet.getFreePsram() >= 1024 * 1024) {
+            bool canServe = true;
+#ifdef ARCH_ESP32
+            if (memGet.getPsramSize() == 0) {
+                LOG_INFO("*** Device doesn't have PSRAM.\n");
+                canServe = false;
+            } else if (memGet.getFreePsram() < 1024 * 1024) {
+                LOG_INFO("*** Device has less than 1M of PSRAM free.\n");
+                canServe = false;
+            }
+#endif
+            if (canServe) {
 
-                    // Do the startup here
+                // Do the startup here
 
-                    // Maximum number of records to return.
-                    if (moduleConfig.store_forward.history_return_max)
-                        this->historyReturnMax = moduleConfig.store_forward.history_return_max;
+                // Maximum number of records to return.
+                if (moduleConfig.store_forward.history_return_max)
+                    this->historyReturnMax = moduleConfig.store_forward.history_return_max;
 
-                    // Maximum time window for records to return (in minutes)
-                    if (moduleConfig.store_forward.history_return_window)
-                        this->historyReturnWindow = moduleConfig.store_forward.history_return_window;
+                // Maximum time window for records to return (in minutes)
+                if (moduleConfig.store_forward.history_return_window)
+                    this->historyReturnWindow = moduleConfig.store_forward.history_return_window;
 
-                    // Maximum number of records to store in memory
-                    if (moduleConfig.store_forward.records)
-                        this->records = moduleConfig.store_forward.records;
+                // Maximum number of records to store in memory
+                if (moduleConfig.store_forward.records)
+                    this->records = moduleConfig.store_forward.records;
 
-                    // send heartbeat advertising?
-                    if (moduleConfig.store_forward.heartbeat)
-                        this->heartbeat = moduleConfig.store_forward.heartbeat;
-                    else
-                        this->heartbeat = false;
+                // send heartbeat advertising?
+                if (moduleConfig.store_forward.heartbeat)
+                    this->heartbeat = moduleConfig.store_forward.heartbeat;
+                else
+                    this->heartbeat = false;
 
-                    // Popupate PSRAM with our data structures.
-                    this->populatePSRAM();
-                    is_server = true;
-                } else {
-                    LOG_INFO("*** Device has less than 1M of PSRAM free.\n");
-                    LOG_INFO("*** Store & Forward Module - disabling server.\n");
-                }
+#ifdef ARCH_ESP32
+                // Popupate PSRAM with our data structures.
+                this->populatePSRAM();
+#else
+                this->populateHistory();
+#endif
+                is_server = true;
             } else {
-                LOG_INFO("*** Device doesn't have PSRAM.\n");
                 LOG_INFO("*** Store & Forward Module - disabling server.\n");
             }
 
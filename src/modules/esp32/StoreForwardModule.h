@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ProtobufModule.h"
+#include "StoreForwardHistory.h"
 #include "concurrency/OSThread.h"
 #include "mesh/generated/meshtastic/storeforward.pb.h"
 
@@ -9,36 +10,39 @@
 #include <functional>
 #include <unordered_map>
 
-struct PacketHistoryStruct {
-    uint32_t time;
-    uint32_t to;
-    uint32_t from;
-    uint8_t channel;
-    uint8_t payload[meshtastic_Constants_DATA_PAYLOAD_LEN];
-    pb_size_t payload_size;
+// How many clients we may be sending history to at once, taking turns message by message
+#define SF_MAX_REPLAYS 4
+
+// Fastest we send history messages, on an idle channel with an empty TX queue.  The slowest is packetTimeMax
+#define SF_REPLAY_MIN_MSEC 500
+
+/// A history dump in progress to one client
+struct StoreForwardReplay {
+    NodeNum to = 0;           // 0 while this slot is free
+    HistoryPos *queue = NULL; // where in history the messages we are sending are, historyReturnMax of them
+    uint32_t size = 0;
+    uint32_t index = 0;
 };
 
 class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<meshtastic_StoreAndForward>
 {
-    bool busy = 0;
-    uint32_t busyTo = 0;
     char routerMessage[meshtastic_Constants_DATA_PAYLOAD_LEN] = {0};
 
-    PacketHistoryStruct *packetHistory = 0;
+    StoreForwardHistory history;
+    // As reported by the router, when we are a client
     uint32_t packetHistoryCurrent = 0;
     uint32_t packetHistoryMax = 0;
 
-    PacketHistoryStruct *packetHistoryTXQueue = 0;
-    uint32_t packetHistoryTXQueue_size = 0;
-    uint32_t packetHistoryTXQueue_index = 0;
+    StoreForwardReplay replays[SF_MAX_REPLAYS];
+    uint8_t nextReplay = 0; // whose turn it is
 
     uint32_t packetTimeMax = 5000; // Interval between sending history packets as a server.
 
     bool is_client = false;
     bool is_server = false;
 
-    // Unordered_map stores the last request for each nodeNum (`to` field)
-    std::unordered_map<NodeNum, uint32_t> lastRequest;
+    // Unordered_map stores how far we got with the last request for each nodeNum (`to` field)
+    std::unordered_map<NodeNum, StoreForwardHistory::Cursor> lastRequest;
 
   public:
     StoreForwardModule();
@@ -54,12 +58,12 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
     void statsSend(uint32_t to);
     void historySend(uint32_t msAgo, uint32_t to);
 
-    uint32_t historyQueueCreate(uint32_t msAgo, uint32_t to, uint32_t *last_request_index);
+    uint32_t historyQueueCreate(uint32_t msAgo, uint32_t to, StoreForwardReplay &replay, StoreForwardHistory::Cursor &cursor);
 
     /**
      * Send our payload into the mesh
      */
-    void sendPayload(NodeNum dest = NODENUM_BROADCAST, uint32_t packetHistory_index = 0);
+    void sendPayload(NodeNum dest, HistoryPos pos);
     void sendMessage(NodeNum dest, const meshtastic_StoreAndForward &payload);
     void sendMessage(NodeNum dest, meshtastic_StoreAndForward_RequestResponse rr);
 
@@ -77,9 +81,20 @@ class StoreForwardModule : private concurrency::OSThread, public ProtobufModule<
             return false;
         }
     }
+    virtual int getDispatchPortNum() override { return ANY_PORTNUM; }
 
   private:
     void populatePSRAM();
+    void allocReplays();
+
+    /// The slot for a new history dump to this client, or NULL if we are already sending to it or to as many as we can
+    StoreForwardReplay *replayFor(NodeNum to);
+
+    /// Send the next history message to whoever's turn it is.  @return how long to wait before the next one
+    int32_t replayNextMessage();
+#ifdef ARCH_PORTDUINO
+    void populateHistory();
+#endif
 
     // S&F Defaults
     uint32_t historyReturnMax = 25;     // Return maximum of 25 records by default.
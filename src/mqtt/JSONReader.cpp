@@ -0,0 +1,277 @@
+#include "JSONReader.h"
+#include <string.h>
+#include <strings.h>
+
+bool JSONReader::skipWhitespace()
+{
+    while (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n')
+        pos++;
+    return *pos != 0;
+}
+
+JSONReader::Type JSONReader::peek()
+{
+    if (failed || !skipWhitespace())
+        return JSON_INVALID;
+
+    char c = *pos;
+    if (c == '"')
+        return JSON_STRING;
+    if (c == '{')
+        return JSON_OBJECT;
+    if (c == '[')
+        return JSON_ARRAY;
+    if (c == '-' || (c >= '0' && c <= '9'))
+        return JSON_NUMBER;
+    if (strncasecmp(pos, "true", 4) == 0 || strncasecmp(pos, "false", 5) == 0)
+        return JSON_BOOL;
+    if (strncasecmp(pos, "null", 4) == 0)
+        return JSON_NULL;
+    return JSON_INVALID;
+}
+
+bool JSONReader::beginObject()
+{
+    if (peek() != JSON_OBJECT || depth >= JSON_READER_MAX_DEPTH)
+        return fail();
+    pos++;
+    depth++;
+    first = true;
+    return true;
+}
+
+bool JSONReader::beginArray()
+{
+    if (peek() != JSON_ARRAY || depth >= JSON_READER_MAX_DEPTH)
+        return fail();
+    pos++;
+    depth++;
+    first = true;
+    return true;
+}
+
+bool JSONReader::nextMember(char close)
+{
+    if (failed || !skipWhitespace())
+        return fail();
+
+    if (*pos == close) {
+        pos++;
+        depth--;
+        first = false;
+        return false;
+    }
+
+    if (!first) {
+        if (*pos != ',')
+            return fail();
+        pos++;
+        if (!skipWhitespace())
+            return fail();
+    }
+    first = false;
+    return true;
+}
+
+bool JSONReader::nextKey(const char *&key)
+{
+    size_t len;
+    if (!nextMember('}'))
+        return false;
+
+    // Like JSONValue::Parse we take whatever character starts the key as its opening quote
+    pos++;
+    if (!readStringBody(key, len) || !skipWhitespace() || *pos != ':')
+        return fail();
+    pos++;
+    return true;
+}
+
+bool JSONReader::nextElement()
+{
+    return nextMember(']');
+}
+
+bool JSONReader::readString(const char *&str, size_t &len)
+{
+    if (peek() != JSON_STRING)
+        return fail();
+
+    pos++;
+    return readStringBody(str, len);
+}
+
+bool JSONReader::readStringBody(const char *&str, size_t &len)
+{
+    // Unescaping never makes a string longer, so we decode it over the top of itself
+    char *in = pos;
+    char *out = in;
+    str = out;
+
+    while (*in != 0) {
+        char next_char = *in;
+
+        if (next_char == '\\') {
+            in++;
+            switch (*in) {
+            case '"':
+            case '\\':
+            case '/':
+                next_char = *in;
+                break;
+            case 'b':
+                next_char = '\b';
+                break;
+            case 'f':
+                next_char = '\f';
+                break;
+            case 'n':
+                next_char = '\n';
+                break;
+            case 'r':
+                next_char = '\r';
+                break;
+            case 't':
+                next_char = '\t';
+                break;
+            case 'u':
+                // Like JSON::ExtractString we keep only the low byte of the code point
+                next_char = 0;
+                for (int i = 0; i < 4; i++) {
+                    in++;
+                    next_char <<= 4;
+                    if (*in >= '0' && *in <= '9')
+                        next_char |= (*in - '0');
+                    else if (*in >= 'A' && *in <= 'F')
+                        next_char |= (10 + (*in - 'A'));
+                    else if (*in >= 'a' && *in <= 'f')
+                        next_char |= (10 + (*in - 'a'));
+                    else
+                        return fail();
+                }
+                break;
+            default:
+                return fail();
+            }
+        } else if (next_char == '"') {
+            len = out - str;
+            *out = 0;
+            pos = in + 1;
+            return true;
+        } else if (next_char < ' ' && next_char != '\t') {
+            // SPEC Violation: Allow tabs due to real world cases (as JSON::ExtractString does)
+            return fail();
+        }
+
+        *out++ = next_char;
+        in++;
+    }
+
+    // The string was never closed
+    return fail();
+}
+
+bool JSONReader::readNumber(double &n)
+{
+    if (peek() != JSON_NUMBER)
+        return fail();
+
+    // Same arithmetic as JSONValue::Parse, so we come up with exactly the same values
+    bool neg = *pos == '-';
+    if (neg)
+        pos++;
+
+    double number = 0.0;
+    if (*pos == '0')
+        pos++;
+    else if (*pos >= '1' && *pos <= '9')
+        while (*pos >= '0' && *pos <= '9')
+            number = number * 10 + (*pos++ - '0');
+    else
+        return fail();
+
+    if (*pos == '.') {
+        pos++;
+        if (!(*pos >= '0' && *pos <= '9'))
+            return fail();
+
+        double decimal = 0.0;
+        double factor = 0.1;
+        while (*pos >= '0' && *pos <= '9') {
+            decimal = decimal + (*pos++ - '0') * factor;
+            factor *= 0.1;
+        }
+        number += decimal;
+    }
+
+    if (*pos == 'E' || *pos == 'e') {
+        pos++;
+        bool neg_expo = false;
+        if (*pos == '-' || *pos == '+') {
+            neg_expo = *pos == '-';
+            pos++;
+        }
+        if (!(*pos >= '0' && *pos <= '9'))
+            return fail();
+
+        double expo = 0;
+        while (*pos >= '0' && *pos <= '9')
+            expo = expo * 10 + (*pos++ - '0');
+        for (double i = 0.0; i < expo && i < JSON_MAX_EXPONENT; i++)
+            number = neg_expo ? (number / 10.0) : (number * 10.0);
+    }
+
+    n = neg ? -number : number;
+    return true;
+}
+
+bool JSONReader::readBool(bool &b)
+{
+    if (peek() != JSON_BOOL)
+        return fail();
+
+    b = strncasecmp(pos, "true", 4) == 0;
+    pos += b ? 4 : 5;
+    return true;
+}
+
+bool JSONReader::skipValue()
+{
+    const char *str;
+    size_t len;
+    double n;
+    bool b;
+
+    switch (peek()) {
+    case JSON_STRING:
+        return readString(str, len);
+    case JSON_NUMBER:
+        return readNumber(n);
+    case JSON_BOOL:
+        return readBool(b);
+    case JSON_NULL:
+        pos += 4;
+        return true;
+    case JSON_OBJECT:
+        if (beginObject())
+            while (nextKey(str))
+                skipValue();
+        return ok();
+    case JSON_ARRAY:
+        if (beginArray())
+            while (nextElement())
+                skipValue();
+        return ok();
+    default:
+        return fail();
+    }
+}
+
+bool JSONReader::finish()
+{
+    if (failed || depth != 0)
+        return false;
+    if (skipWhitespace())
+        return fail();
+    return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// How deeply objects and arrays may nest before we call the JSON invalid
+#define JSON_READER_MAX_DEPTH 32
+
+// Any double other than 0 overflows or underflows within this many powers of ten, so a bigger exponent gives the same value
+#define JSON_MAX_EXPONENT 700
+
+/**
+ * A pull parser for JSON text, which hands out the document one value at a time instead of building a JSONValue tree.
+ *
+ * Strings are unescaped in place, so the text must be writable and any string we return stays valid for as long as the text
+ * does.  Nothing is allocated on the heap.  What we accept (and how numbers and \u escapes are decoded) matches JSON::Parse.
+ *
+ * Typical use:
+ *     JSONReader r(text);
+ *     const char *key;
+ *     if (r.beginObject())
+ *         while (r.nextKey(key))
+ *             if (strcmp(key, "to") == 0) r.readNumber(to); else r.skipValue();
+ *     if (!r.finish()) // invalid JSON
+ *
+ * Once anything goes wrong every call fails, so callers only need to check finish() at the end.
+ */
+class JSONReader
+{
+  public:
+    enum Type { JSON_INVALID, JSON_STRING, JSON_NUMBER, JSON_BOOL, JSON_NULL, JSON_OBJECT, JSON_ARRAY };
+
+    explicit JSONReader(char *json) : pos(json) {}
+
+    /// @return the type of the next value, without consuming it
+    Type peek();
+
+    /// Step into an object, its members are then visited with nextKey()
+    bool beginObject();
+
+    /// Move to the next member of the current object, which must then be consumed with one of the read or skip calls.
+    /// @return false once the end of the object (or an error) is reached
+    bool nextKey(const char *&key);
+
+    /// Step into an array, its elements are then visited with nextElement()
+    bool beginArray();
+
+    /// Move to the next element of the current array.  @return false once the end of the array (or an error) is reached
+    bool nextElement();
+
+    /// Read a string value, len counts any embedded nulls
+    bool readString(const char *&str, size_t &len);
+    bool readNumber(double &n);
+    bool readBool(bool &b);
+
+    /// Skip over the next value, whatever its type (validating it as we go)
+    bool skipValue();
+
+    /// @return true if everything was valid and only whitespace follows what we have read
+    bool finish();
+
+    bool ok() const { return !failed; }
+
+  private:
+    char *pos;
+    bool failed = false;
+
+    /// True right after we stepped into an object or array, when the next member needs no separator
+    bool first = false;
+    uint8_t depth = 0;
+
+    /// Skip whitespace, @return false if we hit the end of the text
+    bool skipWhitespace();
+
+    /// Unescape the rest of a string whose opening quote we have already consumed
+    bool readStringBody(const char *&str, size_t &len);
+
+    /// Consume a separator (',' unless this is the first member) and look for the closing bracket
+    /// @return false if the container ended (or on error)
+    bool nextMember(char close);
+
+    bool fail()
+    {
+        failed = true;
+        return false;
+    }
+};
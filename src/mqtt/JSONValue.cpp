@@ -31,6 +31,7 @@
 #include <string>
 #include <vector>
 
+#include "JSONReader.h"
 #include "JSONValue.h"
 
 // Macros to free an array/object
@@ -134,7 +135,7 @@ JSONValue *JSONValue::Parse(const char **data)
 
             // Sort the expo out
             double expo = JSON::ParseInt(data);
-            for (double i = 0.0; i < expo; i++)
+            for (double i = 0.0; i < expo && i < JSON_MAX_EXPONENT; i++)
                 number = neg_expo ? (number / 10.0) : (number * 10.0);
         }
 
@@ -0,0 +1,155 @@
+#include "JSONWriter.h"
+#include <math.h>
+#include <stdio.h>
+
+JSONWriter::JSONWriter(char *_buf, size_t _size) : buf(_buf), size(_size)
+{
+    if (size)
+        buf[0] = 0;
+    else
+        overflowed = true;
+}
+
+void JSONWriter::put(char c)
+{
+    if (overflowed || len + 1 >= size) {
+        overflowed = true;
+        return;
+    }
+    buf[len++] = c;
+    buf[len] = 0;
+}
+
+void JSONWriter::put(const char *s)
+{
+    while (*s)
+        put(*s++);
+}
+
+/// Same escaping as JSONValue::StringifyString, including its handling of bytes outside of printable ASCII
+void JSONWriter::putEscaped(const char *s)
+{
+    put('"');
+    for (; *s; s++) {
+        char chr = *s;
+
+        if (chr == '"' || chr == '\\' || chr == '/') {
+            put('\\');
+            put(chr);
+        } else if (chr == '\b') {
+            put("\\b");
+        } else if (chr == '\f') {
+            put("\\f");
+        } else if (chr == '\n') {
+            put("\\n");
+        } else if (chr == '\r') {
+            put("\\r");
+        } else if (chr == '\t') {
+            put("\\t");
+        } else if (chr < ' ' || chr > 126) {
+            put("\\u");
+            for (int i = 0; i < 4; i++) {
+                int value = (chr >> 12) & 0xf;
+                put(value <= 9 ? (char)('0' + value) : (char)('A' + (value - 10)));
+                chr <<= 4;
+            }
+        } else {
+            put(chr);
+        }
+    }
+    put('"');
+}
+
+void JSONWriter::separate()
+{
+    if (needComma)
+        put(',');
+    needComma = true;
+}
+
+void JSONWriter::beginObject()
+{
+    separate();
+    put('{');
+    needComma = false;
+}
+
+void JSONWriter::endObject()
+{
+    put('}');
+    needComma = true;
+}
+
+void JSONWriter::beginArray()
+{
+    separate();
+    put('[');
+    needComma = false;
+}
+
+void JSONWriter::endArray()
+{
+    put(']');
+    needComma = true;
+}
+
+void JSONWriter::key(const char *k)
+{
+    separate();
+    putEscaped(k);
+    put(':');
+    needComma = false;
+}
+
+void JSONWriter::value(const char *s)
+{
+    separate();
+    putEscaped(s);
+}
+
+void JSONWriter::value(uint32_t n)
+{
+    char tmp[12];
+    snprintf(tmp, sizeof(tmp), "%lu", (unsigned long)n);
+    separate();
+    put(tmp);
+}
+
+void JSONWriter::value(int32_t n)
+{
+    char tmp[12];
+    snprintf(tmp, sizeof(tmp), "%ld", (long)n);
+    separate();
+    put(tmp);
+}
+
+void JSONWriter::value(double n)
+{
+    // JSONValue prints numbers with a std::stringstream at precision 15, which is the same as %.15g
+    if (isinf(n) || isnan(n)) {
+        null();
+        return;
+    }
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), "%.15g", n);
+    separate();
+    put(tmp);
+}
+
+void JSONWriter::value(bool b)
+{
+    separate();
+    put(b ? "true" : "false");
+}
+
+void JSONWriter::null()
+{
+    separate();
+    put("null");
+}
+
+void JSONWriter::raw(const char *json)
+{
+    separate();
+    put(json);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Writes compact JSON straight into a caller provided buffer, without building a JSONValue tree first.
+ *
+ * The output matches what JSONValue::Stringify() produces for the same values (same string escaping and number formatting),
+ * but it is up to the caller to emit object keys in sorted order, as a JSONObject (a std::map) would.
+ *
+ * If the buffer fills up we stop writing and ok() returns false, the buffer is always kept null terminated.
+ */
+class JSONWriter
+{
+    char *buf;
+    size_t size;
+    size_t len = 0;
+    bool overflowed = false;
+
+    /// True if the next value (or key) needs a separator before it
+    bool needComma = false;
+
+    void put(char c);
+    void put(const char *s);
+    void putEscaped(const char *s);
+    void separate();
+
+  public:
+    JSONWriter(char *_buf, size_t _size);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    /// Write an object key, the value must follow
+    void key(const char *k);
+
+    void value(const char *s);
+    void value(uint32_t n);
+    void value(int32_t n);
+    void value(double n);
+    void value(bool b);
+    void null();
+
+    /// Write an already serialized JSON value as is
+    void raw(const char *json);
+
+    /// @return false if we ran out of room
+    bool ok() const { return !overflowed; }
+
+    size_t length() const { return len; }
+    const char *c_str() const { return buf; }
+};
@@ -5,6 +5,7 @@
 #include "configuration.h"
 #include "main.h"
 #include "mesh/Channels.h"
+#include "mesh/DecodedPayloadCache.h"
 #include "mesh/Router.h"
 #include "mesh/generated/meshtastic/mqtt.pb.h"
 #include "mesh/generated/meshtastic/telemetry.pb.h"
@@ -13,11 +14,19 @@
 #include "../mesh/generated/meshtastic/paxcount.pb.h"
 #endif
 #include "mesh/generated/meshtastic/remote_hardware.pb.h"
+#include "mqtt/JSONReader.h"
+#include "mqtt/JSONWriter.h"
 #include "sleep.h"
 #if HAS_WIFI && !MESHTASTIC_EXCLUDE_WIFI
 #include "mesh/wifi/WiFiAPClient.h"
 #include <WiFi.h>
 #endif
+#if HAS_EPOLL_REACTOR
+#include "platform/portduino/EpollReactor.h"
+#endif
+#ifdef ARCH_PORTDUINO
+#include "platform/portduino/PortduinoGlue.h"
+#endif
 #include "Default.h"
 #include <assert.h>
 
@@ -48,12 +57,8 @@ void MQTT::onReceive(char *topic, byte *payload, size_t length)
         char payloadStr[length + 1];
         memcpy(payloadStr, payload, length);
         payloadStr[length] = 0; // null terminated string
-        JSONValue *json_value = JSON::Parse(payloadStr);
-        if (json_value != NULL) {
-            // check if it is a valid envelope
-            JSONObject json;
-            json = json_value->AsObject();
-
+        MQTTJsonEnvelope json;
+        if (parseJsonEnvelope(payloadStr, json)) {
             // parse the channel name from the topic string
             // the topic has been checked above for having jsonTopic prefix, so just move past it
             char *ptr = topic + jsonTopic.length();
@@ -64,54 +69,40 @@ void MQTT::onReceive(char *topic, byte *payload, size_t length)
                 sendChannel.settings.downlink_enabled) {
                 if (isValidJsonEnvelope(json)) {
                     // this is a valid envelope
-                    if (json["type"]->AsString().compare("sendtext") == 0 && json["payload"]->IsString()) {
-                        std::string jsonPayloadStr = json["payload"]->AsString();
-                        LOG_INFO("JSON payload %s, length %u\n", jsonPayloadStr.c_str(), jsonPayloadStr.length());
+                    if (strcmp(json.type, "sendtext") == 0 && json.payloadType == MQTTJsonEnvelope::PAYLOAD_STRING) {
+                        LOG_INFO("JSON payload %s, length %u\n", json.payloadStr, json.payloadLen);
 
                         // construct protobuf data packet using TEXT_MESSAGE, send it to the mesh
                         meshtastic_MeshPacket *p = router->allocForSending();
                         p->decoded.portnum = meshtastic_PortNum_TEXT_MESSAGE_APP;
-                        if (json.find("channel") != json.end() && json["channel"]->IsNumber() &&
-                            (json["channel"]->AsNumber() < channels.getNumChannels()))
-                            p->channel = json["channel"]->AsNumber();
-                        if (json.find("to") != json.end() && json["to"]->IsNumber())
-                            p->to = json["to"]->AsNumber();
-                        if (json.find("hopLimit") != json.end() && json["hopLimit"]->IsNumber())
-                            p->hop_limit = json["hopLimit"]->AsNumber();
-                        if (jsonPayloadStr.length() <= sizeof(p->decoded.payload.bytes)) {
-                            memcpy(p->decoded.payload.bytes, jsonPayloadStr.c_str(), jsonPayloadStr.length());
-                            p->decoded.payload.size = jsonPayloadStr.length();
+                        if (json.channelIsNumber && (json.channel < channels.getNumChannels()))
+                            p->channel = json.channel;
+                        if (json.toIsNumber)
+                            p->to = json.to;
+                        if (json.hasHopLimit)
+                            p->hop_limit = json.hopLimit;
+                        if (json.payloadLen <= sizeof(p->decoded.payload.bytes)) {
+                            memcpy(p->decoded.payload.bytes, json.payloadStr, json.payloadLen);
+                            p->decoded.payload.size = json.payloadLen;
                             service.sendToMesh(p, RX_SRC_LOCAL);
                         } else {
                             LOG_WARN("Received MQTT json payload too long, dropping\n");
+                            packetPool.release(p);
                         }
-                    } else if (json["type"]->AsString().compare("sendposition") == 0 && json["payload"]->IsObject()) {
+                    } else if (strcmp(json.type, "sendposition") == 0 && json.payloadType == MQTTJsonEnvelope::PAYLOAD_OBJECT) {
                         // invent the "sendposition" type for a valid envelope
-                        JSONObject posit;
-                        posit = json["payload"]->AsObject(); // get nested JSON Position
-                        meshtastic_Position pos = meshtastic_Position_init_default;
-                        if (posit.find("latitude_i") != posit.end() && posit["latitude_i"]->IsNumber())
-                            pos.latitude_i = posit["latitude_i"]->AsNumber();
-                        if (posit.find("longitude_i") != posit.end() && posit["longitude_i"]->IsNumber())
-                            pos.longitude_i = posit["longitude_i"]->AsNumber();
-                        if (posit.find("altitude") != posit.end() && posit["altitude"]->IsNumber())
-                            pos.altitude = posit["altitude"]->AsNumber();
-                        if (posit.find("time") != posit.end() && posit["time"]->IsNumber())
-                            pos.time = posit["time"]->AsNumber();
-
                         // construct protobuf data packet using POSITION, send it to the mesh
                         meshtastic_MeshPacket *p = router->allocForSending();
                         p->decoded.portnum = meshtastic_PortNum_POSITION_APP;
-                        if (json.find("channel") != json.end() && json["channel"]->IsNumber() &&
-                            (json["channel"]->AsNumber() < channels.getNumChannels()))
-                            p->channel = json["channel"]->AsNumber();
-                        if (json.find("to") != json.end() && json["to"]->IsNumber())
-                            p->to = json["to"]->AsNumber();
-                        if (json.find("hopLimit") != json.end() && json["hopLimit"]->IsNumber())
-                            p->hop_limit = json["hopLimit"]->AsNumber();
+                        if (json.channelIsNumber && (json.channel < channels.getNumChannels()))
+                            p->channel = json.channel;
+                        if (json.toIsNumber)
+                            p->to = json.to;
+                        if (json.hasHopLimit)
+                            p->hop_limit = json.hopLimit;
                         p->decoded.payload.size =
                             pb_encode_to_bytes(p->decoded.payload.bytes, sizeof(p->decoded.payload.bytes),
-                                               &meshtastic_Position_msg, &pos); // make the Data protobuf from position
+                                               &meshtastic_Position_msg, &json.position); // make the Data protobuf from position
                         service.sendToMesh(p, RX_SRC_LOCAL);
                     } else {
                         LOG_DEBUG("JSON Ignoring downlink message with unsupported type.\n");
@@ -126,7 +117,6 @@ void MQTT::onReceive(char *topic, byte *payload, size_t length)
             // no json, this is an invalid payload
             LOG_ERROR("JSON Received payload on MQTT but not a valid JSON\n");
         }
-        delete json_value;
     } else {
         if (length == 0) {
             LOG_WARN("Empty MQTT payload received, topic %s!\n", topic);
@@ -148,18 +138,29 @@ void MQTT::onReceive(char *topic, byte *payload, size_t length)
                 // Find channel by channel_id and check downlink_enabled
                 if (strcmp(e.channel_id, channels.getGlobalId(ch.index)) == 0 && e.packet && ch.settings.downlink_enabled) {
                     LOG_INFO("Received MQTT topic %s, len=%u\n", topic, length);
-                    meshtastic_MeshPacket *p = packetPool.allocCopy(*e.packet);
-                    p->via_mqtt = true; // Mark that the packet was received via MQTT
+                    if (router && router->isDuplicate(e.packet)) {
+                        // Already heard it over RF (or from another topic), don't bother copying and decoding it
+                        LOG_DEBUG("Ignoring MQTT downlink packet 0x%x we have already seen\n", e.packet->id);
+                        downlinkShaper.countDuplicate(ch.index);
+                    } else {
+                        meshtastic_MeshPacket *p = packetPool.allocCopy(*e.packet);
+                        p->via_mqtt = true; // Mark that the packet was received via MQTT
+                        // The next hop and relay are node number bytes of the mesh it came from, which mean nothing (or some
+                        // other node) here, so it goes out as a flood
+                        p->next_hop = 0;
+                        p->relay_node = 0;
+
+                        if (p->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
+                            p->channel = ch.index;
+                        }
 
-                    if (p->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
-                        p->channel = ch.index;
+                        // ignore messages if we don't have the channel key, and only put as much on the air as the channel
+                        // can take (packets just for us never get transmitted, so they are always fine)
+                        if (router && perhapsDecode(p) && (p->to == nodeDB->getNodeNum() || downlinkShaper.allow(p, ch.index)))
+                            router->enqueueReceivedMessage(p);
+                        else
+                            packetPool.release(p);
                     }
-
-                    // ignore messages if we don't have the channel key
-                    if (router && perhapsDecode(p))
-                        router->enqueueReceivedMessage(p);
-                    else
-                        packetPool.release(p);
                 }
             }
         }
@@ -176,9 +177,9 @@ void mqttInit()
 }
 
 #ifdef HAS_NETWORKING
-MQTT::MQTT() : concurrency::OSThread("mqtt"), pubSub(mqttClient), mqttQueue(MAX_MQTT_QUEUE)
+MQTT::MQTT() : concurrency::OSThread("mqtt"), pubSub(mqttClient)
 #else
-MQTT::MQTT() : concurrency::OSThread("mqtt"), mqttQueue(MAX_MQTT_QUEUE)
+MQTT::MQTT() : concurrency::OSThread("mqtt")
 #endif
 {
     if (moduleConfig.mqtt.enabled) {
@@ -211,6 +212,11 @@ MQTT::MQTT() : concurrency::OSThread("mqtt"), mqttQueue(MAX_MQTT_QUEUE)
             pubSub.setCallback(mqttCallback);
 #endif
 
+#ifdef ARCH_PORTDUINO
+        if (settingsStrings[mqttspoolfile] != "")
+            uplinkQueue.openSpool(settingsStrings[mqttspoolfile].c_str());
+#endif
+
         if (moduleConfig.mqtt.proxy_to_client_enabled) {
             LOG_INFO("MQTT configured to use client proxy...\n");
             enabled = true;
@@ -236,6 +242,9 @@ bool MQTT::isConnectedDirectly()
 bool MQTT::publish(const char *topic, const char *payload, bool retained)
 {
     if (moduleConfig.mqtt.proxy_to_client_enabled) {
+        // Leave it to the caller to keep it for later, instead of pushing out something the phone hasn't fetched yet
+        if (service.isMqttProxyQueueFull())
+            return false;
         meshtastic_MqttClientProxyMessage *msg = mqttClientProxyMessagePool.allocZeroed();
         msg->which_payload_variant = meshtastic_MqttClientProxyMessage_text_tag;
         strcpy(msg->topic, topic);
@@ -255,6 +264,8 @@ bool MQTT::publish(const char *topic, const char *payload, bool retained)
 bool MQTT::publish(const char *topic, const uint8_t *payload, size_t length, bool retained)
 {
     if (moduleConfig.mqtt.proxy_to_client_enabled) {
+        if (service.isMqttProxyQueueFull())
+            return false;
         meshtastic_MqttClientProxyMessage *msg = mqttClientProxyMessagePool.allocZeroed();
         msg->which_payload_variant = meshtastic_MqttClientProxyMessage_data_tag;
         strcpy(msg->topic, topic);
@@ -405,8 +416,8 @@ int32_t MQTT::runOnce()
 
     // If connected poll rapidly, otherwise only occasionally check for a wifi connection change and ability to contact server
     if (moduleConfig.mqtt.proxy_to_client_enabled) {
-        publishQueuedMessages();
-        return 200;
+        // Wait a while for the phone to catch up if it isn't fetching what we give it
+        return publishQueuedMessages() && !service.isMqttProxyQueueFull() ? 20 : 200;
     }
 #ifdef HAS_NETWORKING
     else if (!pubSub.loop()) {
@@ -414,11 +425,10 @@ int32_t MQTT::runOnce()
             return 5000; // If we don't want connection now, check again in 5 secs
         else {
             reconnect();
-            // If we succeeded, empty the queue one by one and start reading rapidly, else try again in 30 seconds (TCP
+            // If we succeeded, start emptying the queue and reading rapidly, else try again in 30 seconds (TCP
             // connections are EXPENSIVE so try rarely)
             if (isConnectedDirectly()) {
-                publishQueuedMessages();
-                return 200;
+                return publishQueuedMessages() ? 20 : 200;
             } else
                 return 30000;
         }
@@ -430,6 +440,15 @@ int32_t MQTT::runOnce()
         }
 
         powerFSM.trigger(EVENT_CONTACT_FROM_PHONE); // Suppress entering light sleep (because that would turn off bluetooth)
+
+        // Keep working through anything which queued up while the broker was unreachable
+        if (publishQueuedMessages())
+            return 20;
+#if HAS_EPOLL_REACTOR
+        // The reactor wakes us as soon as the broker sends anything, so we only need to run for keepalives
+        if (epollReactor.watch(mqttClient.fd(), EPOLLIN | EPOLLRDHUP, this))
+            return 1000;
+#endif
         return 20;
     }
 #endif
@@ -444,34 +463,70 @@ void MQTT::publishStatus()
     LOG_INFO("published online=%d\n", ok);
 }
 
-void MQTT::publishQueuedMessages()
+const MQTT::ChannelTopics &MQTT::getChannelTopics(const char *channelId)
 {
-    if (!mqttQueue.isEmpty()) {
-        LOG_DEBUG("Publishing enqueued MQTT message\n");
-        // FIXME - this size calculation is super sloppy, but it will go away once we dynamically alloc meshpackets
-        meshtastic_ServiceEnvelope *env = mqttQueue.dequeuePtr(0);
-        static uint8_t bytes[meshtastic_MeshPacket_size + 64];
-        size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_ServiceEnvelope_msg, env);
+    if (strcmp(channelTopicsOwner, owner.id) != 0) {
+        // Our node id is part of every topic, so they all have to be rebuilt
+        memset(channelTopics, 0, sizeof(channelTopics));
+        strncpy(channelTopicsOwner, owner.id, sizeof(channelTopicsOwner) - 1);
+    }
 
-        std::string topic = cryptTopic + env->channel_id + "/" + owner.id;
-        LOG_INFO("publish %s, %u bytes from queue\n", topic.c_str(), numBytes);
+    for (auto &t : channelTopics)
+        if (t.channelId[0] && strcmp(t.channelId, channelId) == 0)
+            return t;
+
+    ChannelTopics &t = channelTopics[nextChannelTopics];
+    nextChannelTopics = (nextChannelTopics + 1) % MAX_NUM_CHANNELS;
+    strncpy(t.channelId, channelId, sizeof(t.channelId) - 1);
+    t.channelId[sizeof(t.channelId) - 1] = 0;
+    snprintf(t.crypt, sizeof(t.crypt), "%s%s/%s", cryptTopic.c_str(), channelId, owner.id);
+    snprintf(t.json, sizeof(t.json), "%s%s/%s", jsonTopic.c_str(), channelId, owner.id);
+    return t;
+}
 
-        publish(topic.c_str(), bytes, numBytes, false);
+bool MQTT::publishEncoded(const char *channelId, const uint8_t *bytes, size_t numBytes, const char *json, size_t jsonLen)
+{
+    const ChannelTopics &topics = getChannelTopics(channelId);
+    LOG_DEBUG("MQTT Publish %s, %u bytes\n", topics.crypt, numBytes);
+
+    if (!publish(topics.crypt, bytes, numBytes, false))
+        return false;
 
 #ifndef ARCH_NRF52 // JSON is not supported on nRF52, see issue #2804
-        if (moduleConfig.mqtt.json_enabled) {
-            // handle json topic
-            auto jsonString = this->meshPacketToJson(env->packet);
-            if (jsonString.length() != 0) {
-                std::string topicJson = jsonTopic + env->channel_id + "/" + owner.id;
-                LOG_INFO("JSON publish message to %s, %u bytes: %s\n", topicJson.c_str(), jsonString.length(),
-                         jsonString.c_str());
-                publish(topicJson.c_str(), jsonString.c_str(), false);
-            }
-        }
+    if (jsonLen != 0) {
+        LOG_INFO("JSON publish message to %s, %u bytes: %s\n", topics.json, jsonLen, json);
+        publish(topics.json, json, false);
+    }
 #endif // ARCH_NRF52
-        mqttPool.release(env);
+    return true;
+}
+
+bool MQTT::publishQueuedMessages()
+{
+    if (uplinkQueue.isEmpty())
+        return false;
+
+    LOG_DEBUG("Publishing %u enqueued MQTT messages\n", uplinkQueue.depth());
+    size_t budget = MQTT_UPLINK_BUDGET_BYTES;
+    MQTTUplinkQueue::Header h;
+    while (budget > 0 && uplinkQueue.front(h, envelopeBuf, sizeof(envelopeBuf), jsonBuf, sizeof(jsonBuf))) {
+        if (publishEncoded(h.channelId, envelopeBuf, h.protoLen, jsonBuf, h.jsonLen)) {
+            uplinkQueue.pop(true);
+        } else if (isConnectedDirectly()) {
+            // Still connected, so it's this message the broker doesn't like, don't let it hold up the rest
+            LOG_WARN("MQTT broker refused a queued message, discarding it\n");
+            uplinkQueue.pop(false);
+        } else {
+            break; // Lost the broker, keep what's left for when we are back
+        }
+        budget -= min(budget, sizeof(h) + h.protoLen + h.jsonLen);
     }
+
+    const MQTTUplinkStats &stats = uplinkQueue.stats;
+    if (uplinkQueue.isEmpty())
+        LOG_INFO("MQTT queue drained, %u published, %u dropped, max latency %u ms\n", stats.published, stats.dropped,
+                 stats.maxLatencyMsec);
+    return !uplinkQueue.isEmpty();
 }
 
 void MQTT::onSend(const meshtastic_MeshPacket &mp, const meshtastic_MeshPacket &mp_decoded, ChannelIndex chIndex)
@@ -497,48 +552,41 @@ void MQTT::onSend(const meshtastic_MeshPacket &mp, const meshtastic_MeshPacket &
 
         LOG_DEBUG("MQTT onSend - Publishing ");
         if (moduleConfig.mqtt.encryption_enabled) {
-            env->packet = (meshtastic_MeshPacket *)&mp;
+            env->packet = packetPool.allocCopy(mp);
             LOG_DEBUG("encrypted message\n");
         } else {
-            env->packet = (meshtastic_MeshPacket *)&mp_decoded;
+            env->packet = packetPool.allocCopy(mp_decoded);
             LOG_DEBUG("portnum %i message\n", env->packet->decoded.portnum);
         }
-
-        if (moduleConfig.mqtt.proxy_to_client_enabled || this->isConnectedDirectly()) {
-            // FIXME - this size calculation is super sloppy, but it will go away once we dynamically alloc meshpackets
-            static uint8_t bytes[meshtastic_MeshPacket_size + 64];
-            size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_ServiceEnvelope_msg, env);
-
-            std::string topic = cryptTopic + channelId + "/" + owner.id;
-            LOG_DEBUG("MQTT Publish %s, %u bytes\n", topic.c_str(), numBytes);
-
-            publish(topic.c_str(), bytes, numBytes, false);
-
+        // Our next hop and relay bytes are only meaningful on our own mesh
+        env->packet->next_hop = 0;
+        env->packet->relay_node = 0;
+
+        // Encode it right away, so if it has to wait in the queue nothing there refers to the packet
+        size_t numBytes = pb_encode_to_bytes(envelopeBuf, sizeof(envelopeBuf), &meshtastic_ServiceEnvelope_msg, env);
+        packetPool.release(env->packet);
+        size_t jsonLen = 0;
 #ifndef ARCH_NRF52 // JSON is not supported on nRF52, see issue #2804
-            if (moduleConfig.mqtt.json_enabled) {
-                // handle json topic
-                auto jsonString = this->meshPacketToJson((meshtastic_MeshPacket *)&mp_decoded);
-                if (jsonString.length() != 0) {
-                    std::string topicJson = jsonTopic + channelId + "/" + owner.id;
-                    LOG_INFO("JSON publish message to %s, %u bytes: %s\n", topicJson.c_str(), jsonString.length(),
-                             jsonString.c_str());
-                    publish(topicJson.c_str(), jsonString.c_str(), false);
-                }
-            }
+        if (moduleConfig.mqtt.json_enabled)
+            jsonLen = this->meshPacketToJson((meshtastic_MeshPacket *)&mp_decoded, jsonBuf, sizeof(jsonBuf));
 #endif // ARCH_NRF52
-        } else {
-            LOG_INFO("MQTT not connected, queueing packet\n");
-            if (mqttQueue.numFree() == 0) {
-                LOG_WARN("NOTE: MQTT queue is full, discarding oldest\n");
-                meshtastic_ServiceEnvelope *d = mqttQueue.dequeuePtr(0);
-                if (d)
-                    mqttPool.release(d);
+        mqttPool.release(env);
+
+        // Anything already queued has to go out first
+        bool canPublish = moduleConfig.mqtt.proxy_to_client_enabled || this->isConnectedDirectly();
+        if (canPublish && uplinkQueue.isEmpty()) {
+            if (publishEncoded(channelId, envelopeBuf, numBytes, jsonBuf, jsonLen))
+                return;
+            if (this->isConnectedDirectly()) {
+                LOG_WARN("MQTT broker refused message, discarding it\n");
+                return;
             }
-            // make a copy of serviceEnvelope and queue it
-            meshtastic_ServiceEnvelope *copied = mqttPool.allocCopy(*env);
-            assert(mqttQueue.enqueue(copied, 0));
         }
-        mqttPool.release(env);
+
+        LOG_INFO("MQTT not ready, queueing packet\n");
+        uplinkQueue.push(channelId, envelopeBuf, numBytes, jsonBuf, jsonLen);
+        if (canPublish)
+            setIntervalFromNow(0);
     }
 }
 
@@ -602,12 +650,10 @@ void MQTT::perhapsReportToMap()
                                                       &meshtastic_MapReport_msg, &mapReport);
         se->packet = mp;
 
-        // FIXME - this size calculation is super sloppy, but it will go away once we dynamically alloc meshpackets
-        static uint8_t bytes[meshtastic_MeshPacket_size + 64];
-        size_t numBytes = pb_encode_to_bytes(bytes, sizeof(bytes), &meshtastic_ServiceEnvelope_msg, se);
+        size_t numBytes = pb_encode_to_bytes(envelopeBuf, sizeof(envelopeBuf), &meshtastic_ServiceEnvelope_msg, se);
 
         LOG_INFO("MQTT Publish map report to %s\n", mapTopic.c_str());
-        publish(mapTopic.c_str(), bytes, numBytes, false);
+        publish(mapTopic.c_str(), envelopeBuf, numBytes, false);
 
         // Release the allocated memory for ServiceEnvelope and MeshPacket
         mqttPool.release(se);
@@ -618,16 +664,27 @@ void MQTT::perhapsReportToMap()
     }
 }
 
-// converts a downstream packet into a json message
-std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
+// converts a downstream packet into a json message, written into buf.  Returns the length of the message, or 0 on failure
+size_t MQTT::meshPacketToJson(meshtastic_MeshPacket *mp, char *buf, size_t bufSize)
 {
-    // the created jsonObj is immutable after creation, so
-    // we need to do the heavy lifting before assembling it.
-    std::string msgType;
-    JSONObject jsonObj;
+    // JSONWriter streams straight into buf, so the keys of every object must be written in sorted order to match the
+    // std::map based JSONObject we used to build
+    JSONWriter json(buf, bufSize);
+    const char *msgType = "";
+
+    json.beginObject();
+    json.key("channel");
+    json.value((uint32_t)mp->channel);
+    json.key("from");
+    json.value((uint32_t)mp->from);
+    if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start) {
+        json.key("hops_away");
+        json.value((uint32_t)(mp->hop_start - mp->hop_limit));
+    }
+    json.key("id");
+    json.value((uint32_t)mp->id);
 
     if (mp->which_payload_variant == meshtastic_MeshPacket_decoded_tag) {
-        JSONObject msgPayload;
         switch (mp->decoded.portnum) {
         case meshtastic_PortNum_TEXT_MESSAGE_APP: {
             msgType = "text";
@@ -636,53 +693,82 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
             char payloadStr[(mp->decoded.payload.size) + 1];
             memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
             payloadStr[mp->decoded.payload.size] = 0; // null terminated string
-            // check if this is a JSON payload
-            JSONValue *json_value = JSON::Parse(payloadStr);
+            // check if this is a JSON payload, only bother parsing it if it starts like a JSON value
+            const char *start = payloadStr;
+            while (*start == ' ' || *start == '\t' || *start == '\r' || *start == '\n')
+                start++;
+            JSONValue *json_value = NULL;
+            if (*start && strchr("{[\"-0123456789tTfFnN", *start))
+                json_value = JSON::Parse(payloadStr);
+            json.key("payload");
             if (json_value != NULL) {
                 LOG_INFO("text message payload is of type json\n");
                 // if it is, then we can just use the json object
-                jsonObj["payload"] = json_value;
+                json.raw(json_value->Stringify().c_str());
+                delete json_value;
             } else {
                 // if it isn't, then we need to create a json object
                 // with the string as the value
                 LOG_INFO("text message payload is of type plaintext\n");
-                msgPayload["text"] = new JSONValue(payloadStr);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                json.beginObject();
+                json.key("text");
+                json.value(payloadStr);
+                json.endObject();
             }
             break;
         }
         case meshtastic_PortNum_TELEMETRY_APP: {
             msgType = "telemetry";
             meshtastic_Telemetry scratch;
-            meshtastic_Telemetry *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Telemetry_msg, &scratch)) {
-                decoded = &scratch;
+            meshtastic_Telemetry *decoded = DecodedPayloadCache::decode(*mp, &meshtastic_Telemetry_msg, scratch);
+            if (decoded) {
+                json.key("payload");
+                json.beginObject();
                 if (decoded->which_variant == meshtastic_Telemetry_device_metrics_tag) {
-                    msgPayload["battery_level"] = new JSONValue((unsigned int)decoded->variant.device_metrics.battery_level);
-                    msgPayload["voltage"] = new JSONValue(decoded->variant.device_metrics.voltage);
-                    msgPayload["channel_utilization"] = new JSONValue(decoded->variant.device_metrics.channel_utilization);
-                    msgPayload["air_util_tx"] = new JSONValue(decoded->variant.device_metrics.air_util_tx);
-                    msgPayload["uptime_seconds"] = new JSONValue((unsigned int)decoded->variant.device_metrics.uptime_seconds);
+                    json.key("air_util_tx");
+                    json.value((double)decoded->variant.device_metrics.air_util_tx);
+                    json.key("battery_level");
+                    json.value((uint32_t)decoded->variant.device_metrics.battery_level);
+                    json.key("channel_utilization");
+                    json.value((double)decoded->variant.device_metrics.channel_utilization);
+                    json.key("uptime_seconds");
+                    json.value((uint32_t)decoded->variant.device_metrics.uptime_seconds);
+                    json.key("voltage");
+                    json.value((double)decoded->variant.device_metrics.voltage);
                 } else if (decoded->which_variant == meshtastic_Telemetry_environment_metrics_tag) {
-                    msgPayload["temperature"] = new JSONValue(decoded->variant.environment_metrics.temperature);
-                    msgPayload["relative_humidity"] = new JSONValue(decoded->variant.environment_metrics.relative_humidity);
-                    msgPayload["barometric_pressure"] = new JSONValue(decoded->variant.environment_metrics.barometric_pressure);
-                    msgPayload["gas_resistance"] = new JSONValue(decoded->variant.environment_metrics.gas_resistance);
-                    msgPayload["voltage"] = new JSONValue(decoded->variant.environment_metrics.voltage);
-                    msgPayload["current"] = new JSONValue(decoded->variant.environment_metrics.current);
-                    msgPayload["lux"] = new JSONValue(decoded->variant.environment_metrics.lux);
-                    msgPayload["white_lux"] = new JSONValue(decoded->variant.environment_metrics.white_lux);
-                    msgPayload["iaq"] = new JSONValue((uint)decoded->variant.environment_metrics.iaq);
+                    json.key("barometric_pressure");
+                    json.value((double)decoded->variant.environment_metrics.barometric_pressure);
+                    json.key("current");
+                    json.value((double)decoded->variant.environment_metrics.current);
+                    json.key("gas_resistance");
+                    json.value((double)decoded->variant.environment_metrics.gas_resistance);
+                    json.key("iaq");
+                    json.value((uint32_t)decoded->variant.environment_metrics.iaq);
+                    json.key("lux");
+                    json.value((double)decoded->variant.environment_metrics.lux);
+                    json.key("relative_humidity");
+                    json.value((double)decoded->variant.environment_metrics.relative_humidity);
+                    json.key("temperature");
+                    json.value((double)decoded->variant.environment_metrics.temperature);
+                    json.key("voltage");
+                    json.value((double)decoded->variant.environment_metrics.voltage);
+                    json.key("white_lux");
+                    json.value((double)decoded->variant.environment_metrics.white_lux);
                 } else if (decoded->which_variant == meshtastic_Telemetry_power_metrics_tag) {
-                    msgPayload["voltage_ch1"] = new JSONValue(decoded->variant.power_metrics.ch1_voltage);
-                    msgPayload["current_ch1"] = new JSONValue(decoded->variant.power_metrics.ch1_current);
-                    msgPayload["voltage_ch2"] = new JSONValue(decoded->variant.power_metrics.ch2_voltage);
-                    msgPayload["current_ch2"] = new JSONValue(decoded->variant.power_metrics.ch2_current);
-                    msgPayload["voltage_ch3"] = new JSONValue(decoded->variant.power_metrics.ch3_voltage);
-                    msgPayload["current_ch3"] = new JSONValue(decoded->variant.power_metrics.ch3_current);
+                    json.key("current_ch1");
+                    json.value((double)decoded->variant.power_metrics.ch1_current);
+                    json.key("current_ch2");
+                    json.value((double)decoded->variant.power_metrics.ch2_current);
+                    json.key("current_ch3");
+                    json.value((double)decoded->variant.power_metrics.ch3_current);
+                    json.key("voltage_ch1");
+                    json.value((double)decoded->variant.power_metrics.ch1_voltage);
+                    json.key("voltage_ch2");
+                    json.value((double)decoded->variant.power_metrics.ch2_voltage);
+                    json.key("voltage_ch3");
+                    json.value((double)decoded->variant.power_metrics.ch3_voltage);
                 }
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                json.endObject();
             } else {
                 LOG_ERROR("Error decoding protobuf for telemetry message!\n");
             }
@@ -691,15 +777,19 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
         case meshtastic_PortNum_NODEINFO_APP: {
             msgType = "nodeinfo";
             meshtastic_User scratch;
-            meshtastic_User *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_User_msg, &scratch)) {
-                decoded = &scratch;
-                msgPayload["id"] = new JSONValue(decoded->id);
-                msgPayload["longname"] = new JSONValue(decoded->long_name);
-                msgPayload["shortname"] = new JSONValue(decoded->short_name);
-                msgPayload["hardware"] = new JSONValue(decoded->hw_model);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+            meshtastic_User *decoded = DecodedPayloadCache::decode(*mp, &meshtastic_User_msg, scratch);
+            if (decoded) {
+                json.key("payload");
+                json.beginObject();
+                json.key("hardware");
+                json.value((int32_t)decoded->hw_model);
+                json.key("id");
+                json.value(decoded->id);
+                json.key("longname");
+                json.value(decoded->long_name);
+                json.key("shortname");
+                json.value(decoded->short_name);
+                json.endObject();
             } else {
                 LOG_ERROR("Error decoding protobuf for nodeinfo message!\n");
             }
@@ -708,43 +798,55 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
         case meshtastic_PortNum_POSITION_APP: {
             msgType = "position";
             meshtastic_Position scratch;
-            meshtastic_Position *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Position_msg, &scratch)) {
-                decoded = &scratch;
-                if ((int)decoded->time) {
-                    msgPayload["time"] = new JSONValue((unsigned int)decoded->time);
+            meshtastic_Position *decoded = DecodedPayloadCache::decode(*mp, &meshtastic_Position_msg, scratch);
+            if (decoded) {
+                json.key("payload");
+                json.beginObject();
+                if ((int)decoded->HDOP) {
+                    json.key("HDOP");
+                    json.value((int32_t)decoded->HDOP);
                 }
-                if ((int)decoded->timestamp) {
-                    msgPayload["timestamp"] = new JSONValue((unsigned int)decoded->timestamp);
+                if ((int)decoded->PDOP) {
+                    json.key("PDOP");
+                    json.value((int32_t)decoded->PDOP);
+                }
+                if ((int)decoded->VDOP) {
+                    json.key("VDOP");
+                    json.value((int32_t)decoded->VDOP);
                 }
-                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
-                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
                 if ((int)decoded->altitude) {
-                    msgPayload["altitude"] = new JSONValue((int)decoded->altitude);
+                    json.key("altitude");
+                    json.value((int32_t)decoded->altitude);
                 }
                 if ((int)decoded->ground_speed) {
-                    msgPayload["ground_speed"] = new JSONValue((unsigned int)decoded->ground_speed);
+                    json.key("ground_speed");
+                    json.value((uint32_t)decoded->ground_speed);
                 }
                 if (int(decoded->ground_track)) {
-                    msgPayload["ground_track"] = new JSONValue((unsigned int)decoded->ground_track);
-                }
-                if (int(decoded->sats_in_view)) {
-                    msgPayload["sats_in_view"] = new JSONValue((unsigned int)decoded->sats_in_view);
+                    json.key("ground_track");
+                    json.value((uint32_t)decoded->ground_track);
                 }
-                if ((int)decoded->PDOP) {
-                    msgPayload["PDOP"] = new JSONValue((int)decoded->PDOP);
+                json.key("latitude_i");
+                json.value((int32_t)decoded->latitude_i);
+                json.key("longitude_i");
+                json.value((int32_t)decoded->longitude_i);
+                if ((int)decoded->precision_bits) {
+                    json.key("precision_bits");
+                    json.value((int32_t)decoded->precision_bits);
                 }
-                if ((int)decoded->HDOP) {
-                    msgPayload["HDOP"] = new JSONValue((int)decoded->HDOP);
+                if (int(decoded->sats_in_view)) {
+                    json.key("sats_in_view");
+                    json.value((uint32_t)decoded->sats_in_view);
                 }
-                if ((int)decoded->VDOP) {
-                    msgPayload["VDOP"] = new JSONValue((int)decoded->VDOP);
+                if ((int)decoded->time) {
+                    json.key("time");
+                    json.value((uint32_t)decoded->time);
                 }
-                if ((int)decoded->precision_bits) {
-                    msgPayload["precision_bits"] = new JSONValue((int)decoded->precision_bits);
+                if ((int)decoded->timestamp) {
+                    json.key("timestamp");
+                    json.value((uint32_t)decoded->timestamp);
                 }
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                json.endObject();
             } else {
                 LOG_ERROR("Error decoding protobuf for position message!\n");
             }
@@ -753,18 +855,25 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
         case meshtastic_PortNum_WAYPOINT_APP: {
             msgType = "position";
             meshtastic_Waypoint scratch;
-            meshtastic_Waypoint *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Waypoint_msg, &scratch)) {
-                decoded = &scratch;
-                msgPayload["id"] = new JSONValue((unsigned int)decoded->id);
-                msgPayload["name"] = new JSONValue(decoded->name);
-                msgPayload["description"] = new JSONValue(decoded->description);
-                msgPayload["expire"] = new JSONValue((unsigned int)decoded->expire);
-                msgPayload["locked_to"] = new JSONValue((unsigned int)decoded->locked_to);
-                msgPayload["latitude_i"] = new JSONValue((int)decoded->latitude_i);
-                msgPayload["longitude_i"] = new JSONValue((int)decoded->longitude_i);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+            meshtastic_Waypoint *decoded = DecodedPayloadCache::decode(*mp, &meshtastic_Waypoint_msg, scratch);
+            if (decoded) {
+                json.key("payload");
+                json.beginObject();
+                json.key("description");
+                json.value(decoded->description);
+                json.key("expire");
+                json.value((uint32_t)decoded->expire);
+                json.key("id");
+                json.value((uint32_t)decoded->id);
+                json.key("latitude_i");
+                json.value((int32_t)decoded->latitude_i);
+                json.key("locked_to");
+                json.value((uint32_t)decoded->locked_to);
+                json.key("longitude_i");
+                json.value((int32_t)decoded->longitude_i);
+                json.key("name");
+                json.value(decoded->name);
+                json.endObject();
             } else {
                 LOG_ERROR("Error decoding protobuf for position message!\n");
             }
@@ -773,24 +882,30 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
         case meshtastic_PortNum_NEIGHBORINFO_APP: {
             msgType = "neighborinfo";
             meshtastic_NeighborInfo scratch;
-            meshtastic_NeighborInfo *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_NeighborInfo_msg,
-                                     &scratch)) {
-                decoded = &scratch;
-                msgPayload["node_id"] = new JSONValue((unsigned int)decoded->node_id);
-                msgPayload["node_broadcast_interval_secs"] = new JSONValue((unsigned int)decoded->node_broadcast_interval_secs);
-                msgPayload["last_sent_by_id"] = new JSONValue((unsigned int)decoded->last_sent_by_id);
-                msgPayload["neighbors_count"] = new JSONValue(decoded->neighbors_count);
-                JSONArray neighbors;
+            meshtastic_NeighborInfo *decoded = DecodedPayloadCache::decode(*mp, &meshtastic_NeighborInfo_msg, scratch);
+            if (decoded) {
+                json.key("payload");
+                json.beginObject();
+                json.key("last_sent_by_id");
+                json.value((uint32_t)decoded->last_sent_by_id);
+                json.key("neighbors");
+                json.beginArray();
                 for (uint8_t i = 0; i < decoded->neighbors_count; i++) {
-                    JSONObject neighborObj;
-                    neighborObj["node_id"] = new JSONValue((unsigned int)decoded->neighbors[i].node_id);
-                    neighborObj["snr"] = new JSONValue((int)decoded->neighbors[i].snr);
-                    neighbors.push_back(new JSONValue(neighborObj));
+                    json.beginObject();
+                    json.key("node_id");
+                    json.value((uint32_t)decoded->neighbors[i].node_id);
+                    json.key("snr");
+                    json.value((int32_t)decoded->neighbors[i].snr);
+                    json.endObject();
                 }
-                msgPayload["neighbors"] = new JSONValue(neighbors);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+                json.endArray();
+                json.key("neighbors_count");
+                json.value((uint32_t)decoded->neighbors_count);
+                json.key("node_broadcast_interval_secs");
+                json.value((uint32_t)decoded->node_broadcast_interval_secs);
+                json.key("node_id");
+                json.value((uint32_t)decoded->node_id);
+                json.endObject();
             } else {
                 LOG_ERROR("Error decoding protobuf for neighborinfo message!\n");
             }
@@ -800,29 +915,28 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
             if (mp->decoded.request_id) { // Only report the traceroute response
                 msgType = "traceroute";
                 meshtastic_RouteDiscovery scratch;
-                meshtastic_RouteDiscovery *decoded = NULL;
-                memset(&scratch, 0, sizeof(scratch));
-                if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_RouteDiscovery_msg,
-                                         &scratch)) {
-                    decoded = &scratch;
-                    JSONArray route; // Route this message took
+                meshtastic_RouteDiscovery *decoded = DecodedPayloadCache::decode(*mp, &meshtastic_RouteDiscovery_msg, scratch);
+                if (decoded) {
                     // Lambda function for adding a long name to the route
-                    auto addToRoute = [](JSONArray *route, NodeNum num) {
+                    auto addToRoute = [](JSONWriter &json, NodeNum num) {
                         char long_name[40] = "Unknown";
                         meshtastic_NodeInfoLite *node = nodeDB->getMeshNode(num);
                         bool name_known = node ? node->has_user : false;
                         if (name_known)
                             memcpy(long_name, node->user.long_name, sizeof(long_name));
-                        route->push_back(new JSONValue(long_name));
+                        json.value(long_name);
                     };
-                    addToRoute(&route, mp->to); // Started at the original transmitter (destination of response)
+                    json.key("payload");
+                    json.beginObject();
+                    json.key("route"); // Route this message took
+                    json.beginArray();
+                    addToRoute(json, mp->to); // Started at the original transmitter (destination of response)
                     for (uint8_t i = 0; i < decoded->route_count; i++) {
-                        addToRoute(&route, decoded->route[i]);
+                        addToRoute(json, decoded->route[i]);
                     }
-                    addToRoute(&route, mp->from); // Ended at the original destination (source of response)
-
-                    msgPayload["route"] = new JSONValue(route);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
+                    addToRoute(json, mp->from); // Ended at the original destination (source of response)
+                    json.endArray();
+                    json.endObject();
                 } else {
                     LOG_ERROR("Error decoding protobuf for traceroute message!\n");
                 }
@@ -834,22 +948,28 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
             char payloadStr[(mp->decoded.payload.size) + 1];
             memcpy(payloadStr, mp->decoded.payload.bytes, mp->decoded.payload.size);
             payloadStr[mp->decoded.payload.size] = 0; // null terminated string
-            msgPayload["text"] = new JSONValue(payloadStr);
-            jsonObj["payload"] = new JSONValue(msgPayload);
+            json.key("payload");
+            json.beginObject();
+            json.key("text");
+            json.value(payloadStr);
+            json.endObject();
             break;
         }
 #ifdef ARCH_ESP32
         case meshtastic_PortNum_PAXCOUNTER_APP: {
             msgType = "paxcounter";
             meshtastic_Paxcount scratch;
-            meshtastic_Paxcount *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_Paxcount_msg, &scratch)) {
-                decoded = &scratch;
-                msgPayload["wifi_count"] = new JSONValue((unsigned int)decoded->wifi);
-                msgPayload["ble_count"] = new JSONValue((unsigned int)decoded->ble);
-                msgPayload["uptime"] = new JSONValue((unsigned int)decoded->uptime);
-                jsonObj["payload"] = new JSONValue(msgPayload);
+            meshtastic_Paxcount *decoded = DecodedPayloadCache::decode(*mp, &meshtastic_Paxcount_msg, scratch);
+            if (decoded) {
+                json.key("payload");
+                json.beginObject();
+                json.key("ble_count");
+                json.value((uint32_t)decoded->ble);
+                json.key("uptime");
+                json.value((uint32_t)decoded->uptime);
+                json.key("wifi_count");
+                json.value((uint32_t)decoded->wifi);
+                json.endObject();
             } else {
                 LOG_ERROR("Error decoding protobuf for Paxcount message!\n");
             }
@@ -858,20 +978,24 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
 #endif
         case meshtastic_PortNum_REMOTE_HARDWARE_APP: {
             meshtastic_HardwareMessage scratch;
-            meshtastic_HardwareMessage *decoded = NULL;
-            memset(&scratch, 0, sizeof(scratch));
-            if (pb_decode_from_bytes(mp->decoded.payload.bytes, mp->decoded.payload.size, &meshtastic_HardwareMessage_msg,
-                                     &scratch)) {
-                decoded = &scratch;
+            meshtastic_HardwareMessage *decoded = DecodedPayloadCache::decode(*mp, &meshtastic_HardwareMessage_msg, scratch);
+            if (decoded) {
                 if (decoded->type == meshtastic_HardwareMessage_Type_GPIOS_CHANGED) {
                     msgType = "gpios_changed";
-                    msgPayload["gpio_value"] = new JSONValue((unsigned int)decoded->gpio_value);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
+                    json.key("payload");
+                    json.beginObject();
+                    json.key("gpio_value");
+                    json.value((uint32_t)decoded->gpio_value);
+                    json.endObject();
                 } else if (decoded->type == meshtastic_HardwareMessage_Type_READ_GPIOS_REPLY) {
                     msgType = "gpios_read_reply";
-                    msgPayload["gpio_value"] = new JSONValue((unsigned int)decoded->gpio_value);
-                    msgPayload["gpio_mask"] = new JSONValue((unsigned int)decoded->gpio_mask);
-                    jsonObj["payload"] = new JSONValue(msgPayload);
+                    json.key("payload");
+                    json.beginObject();
+                    json.key("gpio_mask");
+                    json.value((uint32_t)decoded->gpio_mask);
+                    json.key("gpio_value");
+                    json.value((uint32_t)decoded->gpio_value);
+                    json.endObject();
                 }
             } else {
                 LOG_ERROR("Error decoding protobuf for RemoteHardware message!\n");
@@ -886,37 +1010,122 @@ std::string MQTT::meshPacketToJson(meshtastic_MeshPacket *mp)
         LOG_WARN("Couldn't convert encrypted payload of MeshPacket to JSON\n");
     }
 
-    jsonObj["id"] = new JSONValue((unsigned int)mp->id);
-    jsonObj["timestamp"] = new JSONValue((unsigned int)mp->rx_time);
-    jsonObj["to"] = new JSONValue((unsigned int)mp->to);
-    jsonObj["from"] = new JSONValue((unsigned int)mp->from);
-    jsonObj["channel"] = new JSONValue((unsigned int)mp->channel);
-    jsonObj["type"] = new JSONValue(msgType.c_str());
-    jsonObj["sender"] = new JSONValue(owner.id);
-    if (mp->rx_rssi != 0)
-        jsonObj["rssi"] = new JSONValue((int)mp->rx_rssi);
-    if (mp->rx_snr != 0)
-        jsonObj["snr"] = new JSONValue((float)mp->rx_snr);
-    if (mp->hop_start != 0 && mp->hop_limit <= mp->hop_start)
-        jsonObj["hops_away"] = new JSONValue((unsigned int)(mp->hop_start - mp->hop_limit));
-
-    // serialize and write it to the stream
-    JSONValue *value = new JSONValue(jsonObj);
-    std::string jsonStr = value->Stringify();
-
-    LOG_INFO("serialized json message: %s\n", jsonStr.c_str());
-
-    delete value;
-    return jsonStr;
+    if (mp->rx_rssi != 0) {
+        json.key("rssi");
+        json.value((int32_t)mp->rx_rssi);
+    }
+    json.key("sender");
+    json.value(owner.id);
+    if (mp->rx_snr != 0) {
+        json.key("snr");
+        json.value((double)mp->rx_snr);
+    }
+    json.key("timestamp");
+    json.value((uint32_t)mp->rx_time);
+    json.key("to");
+    json.value((uint32_t)mp->to);
+    json.key("type");
+    json.value(msgType);
+    json.endObject();
+
+    if (!json.ok()) {
+        LOG_ERROR("JSON message doesn't fit in %u bytes, not sending it\n", bufSize);
+        return 0;
+    }
+
+    LOG_INFO("serialized json message: %s\n", json.c_str());
+    return json.length();
+}
+
+bool MQTT::parseJsonEnvelope(char *text, MQTTJsonEnvelope &env)
+{
+    JSONReader json(text);
+
+    // Anything other than an object is still valid JSON, it just won't make a valid envelope
+    if (json.peek() != JSONReader::JSON_OBJECT) {
+        json.skipValue();
+        return json.finish();
+    }
+
+    // If a key is repeated the last one wins, as it did when we built a JSONObject
+    const char *key;
+    json.beginObject();
+    while (json.nextKey(key)) {
+        JSONReader::Type type = json.peek();
+        bool isNumber = type == JSONReader::JSON_NUMBER;
+        size_t len;
+
+        if (strcmp(key, "sender") == 0) {
+            env.hasSender = true;
+            env.sender = NULL;
+            if (type == JSONReader::JSON_STRING)
+                json.readString(env.sender, len);
+            else
+                json.skipValue();
+        } else if (strcmp(key, "type") == 0) {
+            env.type = NULL;
+            if (type == JSONReader::JSON_STRING)
+                json.readString(env.type, len);
+            else
+                json.skipValue();
+        } else if (strcmp(key, "from") == 0) {
+            env.hasFrom = true;
+            env.fromIsNumber = isNumber;
+            isNumber ? json.readNumber(env.from) : json.skipValue();
+        } else if (strcmp(key, "hopLimit") == 0) {
+            env.hasHopLimit = true;
+            env.hopLimitIsNumber = isNumber;
+            isNumber ? json.readNumber(env.hopLimit) : json.skipValue();
+        } else if (strcmp(key, "to") == 0) {
+            env.toIsNumber = isNumber;
+            isNumber ? json.readNumber(env.to) : json.skipValue();
+        } else if (strcmp(key, "channel") == 0) {
+            env.channelIsNumber = isNumber;
+            isNumber ? json.readNumber(env.channel) : json.skipValue();
+        } else if (strcmp(key, "payload") == 0) {
+            env.position = meshtastic_Position_init_default;
+            if (type == JSONReader::JSON_STRING) {
+                env.payloadType = MQTTJsonEnvelope::PAYLOAD_STRING;
+                json.readString(env.payloadStr, env.payloadLen);
+            } else if (type == JSONReader::JSON_OBJECT) {
+                // get nested JSON Position
+                env.payloadType = MQTTJsonEnvelope::PAYLOAD_OBJECT;
+                const char *positKey;
+                double n;
+                json.beginObject();
+                while (json.nextKey(positKey)) {
+                    if (json.peek() != JSONReader::JSON_NUMBER) {
+                        json.skipValue();
+                        continue;
+                    }
+                    json.readNumber(n);
+                    if (strcmp(positKey, "latitude_i") == 0)
+                        env.position.latitude_i = n;
+                    else if (strcmp(positKey, "longitude_i") == 0)
+                        env.position.longitude_i = n;
+                    else if (strcmp(positKey, "altitude") == 0)
+                        env.position.altitude = n;
+                    else if (strcmp(positKey, "time") == 0)
+                        env.position.time = n;
+                }
+            } else {
+                env.payloadType = MQTTJsonEnvelope::PAYLOAD_OTHER;
+                json.skipValue();
+            }
+        } else {
+            json.skipValue();
+        }
+    }
+
+    return json.finish();
 }
 
-bool MQTT::isValidJsonEnvelope(JSONObject &json)
+bool MQTT::isValidJsonEnvelope(const MQTTJsonEnvelope &env)
 {
     // if "sender" is provided, avoid processing packets we uplinked
-    return (json.find("sender") != json.end() ? (json["sender"]->AsString().compare(owner.id) != 0) : true) &&
-           (json.find("hopLimit") != json.end() ? json["hopLimit"]->IsNumber() : true) && // hop limit should be a number
-           (json.find("from") != json.end()) && json["from"]->IsNumber() &&
-           (json["from"]->AsNumber() == nodeDB->getNodeNum()) &&            // only accept message if the "from" is us
-           (json.find("type") != json.end()) && json["type"]->IsString() && // should specify a type
-           (json.find("payload") != json.end());                            // should have a payload
+    return (env.hasSender ? (!env.sender || strcmp(env.sender, owner.id) != 0) : true) &&
+           (env.hasHopLimit ? env.hopLimitIsNumber : true) &&                     // hop limit should be a number
+           env.hasFrom && env.fromIsNumber && (env.from == nodeDB->getNodeNum()) && // only accept message if the "from" is us
+           env.type &&                                                            // should specify a type
+           env.payloadType != MQTTJsonEnvelope::PAYLOAD_NONE;                     // should have a payload
 }
\ No newline at end of file
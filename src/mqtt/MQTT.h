@@ -6,6 +6,8 @@
 #include "mesh/Channels.h"
 #include "mesh/generated/meshtastic/mqtt.pb.h"
 #include "mqtt/JSON.h"
+#include "mqtt/MQTTDownlinkShaper.h"
+#include "mqtt/MQTTUplinkQueue.h"
 #if HAS_WIFI
 #include <WiFiClient.h>
 #define HAS_NETWORKING 1
@@ -22,7 +24,42 @@
 #include <PubSubClient.h>
 #endif
 
-#define MAX_MQTT_QUEUE 16
+// Room for our longest publish topic: root (up to 31 chars) + "/2/json/" + channel id + "/" + node id
+#define MQTT_TOPIC_MAX_LEN 80
+
+// How many bytes of queued messages we publish each time we run, so a big backlog doesn't hog the main loop
+#define MQTT_UPLINK_BUDGET_BYTES 8192
+
+/**
+ * The fields of a downlink JSON envelope which we act on, pulled straight out of the JSON text by MQTT::parseJsonEnvelope().
+ * The has* flags say whether the key was present at all, the *IsNumber flags whether its value was a number.
+ */
+struct MQTTJsonEnvelope {
+    const char *sender = NULL; // NULL if missing or not a string
+    bool hasSender = false;
+
+    double from = 0;
+    bool hasFrom = false, fromIsNumber = false;
+
+    double hopLimit = 0;
+    bool hasHopLimit = false, hopLimitIsNumber = false;
+
+    double to = 0;
+    bool toIsNumber = false;
+
+    double channel = 0;
+    bool channelIsNumber = false;
+
+    const char *type = NULL; // NULL if missing or not a string
+
+    enum { PAYLOAD_NONE, PAYLOAD_STRING, PAYLOAD_OBJECT, PAYLOAD_OTHER } payloadType = PAYLOAD_NONE;
+    const char *payloadStr = NULL; // for PAYLOAD_STRING, may contain nulls
+    size_t payloadLen = 0;
+    meshtastic_Position position = meshtastic_Position_init_default; // for PAYLOAD_OBJECT, as used by "sendposition"
+};
+
+// Big enough for a traceroute through the longest route, with every character of every long name escaped
+#define MQTT_JSON_BUF_SIZE 3072
 
 /**
  * Our wrapper/singleton for sending/receiving MQTT "udp" packets.  This object isolates the MQTT protocol implementation from
@@ -75,8 +112,19 @@ class MQTT : private concurrency::OSThread
 
     void start() { setIntervalFromNow(0); };
 
+    const MQTTUplinkStats &getUplinkStats() const { return uplinkQueue.stats; }
+
+    /// @return how many messages are waiting for the broker
+    uint32_t getUplinkQueueDepth() const { return uplinkQueue.depth(); }
+
+    const MQTTDownlinkCounters &getDownlinkCounters(ChannelIndex chIndex) const { return downlinkShaper.getCounters(chIndex); }
+
   protected:
-    PointerQueue<meshtastic_ServiceEnvelope> mqttQueue;
+    /// Messages waiting for the broker (or client proxy) to take them, in order
+    MQTTUplinkQueue uplinkQueue;
+
+    /// Decides how much of what the broker sends us we put on the air
+    MQTTDownlinkShaper downlinkShaper;
 
     int reconnectCount = 0;
 
@@ -109,17 +157,49 @@ class MQTT : private concurrency::OSThread
     /// Called when a new publish arrives from the MQTT server
     void onReceive(char *topic, byte *payload, size_t length);
 
-    /// Called when a new publish arrives from the MQTT server
-    std::string meshPacketToJson(meshtastic_MeshPacket *mp);
+    /// Where meshPacketToJson writes the JSON we publish
+#ifndef ARCH_NRF52 // JSON is not supported on nRF52, see issue #2804
+    char jsonBuf[MQTT_JSON_BUF_SIZE];
+#else
+    char jsonBuf[1]; // always empty
+#endif
+
+    /// Where we encode the ServiceEnvelope we publish.  All our encoding happens on the MQTT object, which only the main loop
+    /// uses, so these buffers belong to it rather than being function statics
+    uint8_t envelopeBuf[meshtastic_MeshPacket_size + 64];
+
+    /// The topics we publish a channel's messages on, built once instead of for every message
+    struct ChannelTopics {
+        char channelId[12]; // empty if this entry is unused
+        char crypt[MQTT_TOPIC_MAX_LEN];
+        char json[MQTT_TOPIC_MAX_LEN];
+    };
+    ChannelTopics channelTopics[MAX_NUM_CHANNELS] = {};
+    uint8_t nextChannelTopics = 0; // the entry we reuse when we see a channel we have no topics for
+    char channelTopicsOwner[sizeof(meshtastic_User::id)] = {}; // the node id our topics were built with
+
+    /// @return the publish topics for a channel id, building them if the channel is new to us or our node id changed
+    const ChannelTopics &getChannelTopics(const char *channelId);
+
+    /// Serialize a packet as JSON into buf, @return the length of the JSON or 0 if the packet couldn't be converted
+    size_t meshPacketToJson(meshtastic_MeshPacket *mp, char *buf, size_t bufSize);
 
     void publishStatus();
-    void publishQueuedMessages();
+
+    /// Publish an already encoded message on the topics for its channel, @return false if it wasn't accepted
+    bool publishEncoded(const char *channelId, const uint8_t *bytes, size_t numBytes, const char *json, size_t jsonLen);
+
+    /// Publish queued messages until we run out of budget or the broker stops taking them, @return true if more are waiting
+    bool publishQueuedMessages();
 
     // Check if we should report unencrypted information about our node for consumption by a map
     void perhapsReportToMap();
 
+    /// Pull the envelope fields out of downlink JSON (which is unescaped in place), returns false if it isn't valid JSON
+    bool parseJsonEnvelope(char *json, MQTTJsonEnvelope &env);
+
     // returns true if this is a valid JSON envelope which we accept on downlink
-    bool isValidJsonEnvelope(JSONObject &json);
+    bool isValidJsonEnvelope(const MQTTJsonEnvelope &env);
 
     /// Return 0 if sleep is okay, veto sleep if we are connected to pubsub server
     // int preflightSleepCb(void *unused = NULL) { return pubSub.connected() ? 1 : 0; }
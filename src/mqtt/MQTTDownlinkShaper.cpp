@@ -0,0 +1,67 @@
+#include "MQTTDownlinkShaper.h"
+#include "airtime.h"
+#include "configuration.h"
+
+/// @return true for packets someone is waiting on, which get to use the whole token bucket
+static bool isUrgent(const meshtastic_MeshPacket *p)
+{
+    if (p->priority >= meshtastic_MeshPacket_Priority_RELIABLE)
+        return true;
+
+    if (p->which_payload_variant != meshtastic_MeshPacket_decoded_tag)
+        return false; // can't tell what it is, treat it like background traffic
+
+    switch (p->decoded.portnum) {
+    case meshtastic_PortNum_TEXT_MESSAGE_APP:
+    case meshtastic_PortNum_TEXT_MESSAGE_COMPRESSED_APP:
+    case meshtastic_PortNum_ROUTING_APP:
+    case meshtastic_PortNum_ADMIN_APP:
+    case meshtastic_PortNum_WAYPOINT_APP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void MQTTDownlinkShaper::refill()
+{
+    uint32_t now = millis();
+    uint32_t elapsed = now - lastRefillMsec;
+    lastRefillMsec = now;
+
+    // The closer the channel is to its utilization cap, the less of it we hand to the broker
+    float headroom = 1.0;
+    if (airTime) {
+        float cap = airTime->getMaxChannelUtilPercent();
+        headroom = (cap - airTime->channelUtilizationPercent()) / cap;
+        if (headroom < 0)
+            headroom = 0;
+    }
+
+    tokens += headroom * MQTT_DOWNLINK_PACKETS_PER_MIN * elapsed / 60000.0;
+    if (tokens > MQTT_DOWNLINK_BURST)
+        tokens = MQTT_DOWNLINK_BURST;
+}
+
+bool MQTTDownlinkShaper::allow(const meshtastic_MeshPacket *p, ChannelIndex chIndex)
+{
+    MQTTDownlinkCounters &c = counters[chIndex % MAX_NUM_CHANNELS];
+
+    refill();
+    float reserve = isUrgent(p) ? 0 : MQTT_DOWNLINK_BURST / 2;
+    if (tokens - 1 < reserve) {
+        c.shaped++;
+        LOG_DEBUG("Dropping MQTT downlink packet 0x%x (portnum %d), over our airtime budget\n", p->id,
+                  p->which_payload_variant == meshtastic_MeshPacket_decoded_tag ? p->decoded.portnum : -1);
+        return false;
+    }
+
+    tokens -= 1;
+    c.injected++;
+    return true;
+}
+
+void MQTTDownlinkShaper::countDuplicate(ChannelIndex chIndex)
+{
+    counters[chIndex % MAX_NUM_CHANNELS].duplicates++;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Channels.h"
+#include "mesh-pb-constants.h"
+
+// How many downlinked packets we may inject back to back
+#define MQTT_DOWNLINK_BURST 10
+
+// How many downlinked packets per minute we inject while the channel is idle, this shrinks as channel utilization rises and
+// reaches zero at AirTime's channel utilization cap
+#define MQTT_DOWNLINK_PACKETS_PER_MIN 30
+
+/// Per channel (and so per downlink topic) counts of what we did with downlinked packets
+struct MQTTDownlinkCounters {
+    uint32_t injected;   // handed to the router
+    uint32_t duplicates; // already seen, over RF or from another topic
+    uint32_t shaped;     // dropped because we were over our airtime budget
+};
+
+/**
+ * Decides which packets arriving from the MQTT broker we can afford to put on the air.
+ *
+ * A busy public broker can deliver far more than the LoRa channel can carry, so downlinked packets must take a token from a
+ * bucket which refills more slowly the busier the channel is, and stops refilling at the channel utilization cap.  Packets
+ * people are waiting for (text, acks, admin) may use the whole bucket, everything else (position, telemetry, ...) only its top
+ * half, so the background chatter is what gets dropped first.
+ */
+class MQTTDownlinkShaper
+{
+    float tokens = MQTT_DOWNLINK_BURST;
+    uint32_t lastRefillMsec = 0;
+
+    MQTTDownlinkCounters counters[MAX_NUM_CHANNELS] = {};
+
+    void refill();
+
+  public:
+    /// Take a token for this packet (decoded if we have its key) if we can.  @return false if it must be dropped
+    bool allow(const meshtastic_MeshPacket *p, ChannelIndex chIndex);
+
+    /// Note that we dropped a downlinked packet because we had already seen it
+    void countDuplicate(ChannelIndex chIndex);
+
+    const MQTTDownlinkCounters &getCounters(ChannelIndex chIndex) const { return counters[chIndex % MAX_NUM_CHANNELS]; }
+};
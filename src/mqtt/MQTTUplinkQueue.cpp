@@ -0,0 +1,222 @@
+#include "MQTTUplinkQueue.h"
+#include <Arduino.h>
+#include <string.h>
+#ifdef ARCH_PORTDUINO
+#include <unistd.h>
+#endif
+
+#define SPOOL_MAGIC 0x5155514d // "MQUQ"
+#define SPOOL_DATA_START (2 * sizeof(uint32_t))
+
+MQTTUplinkQueue::~MQTTUplinkQueue()
+{
+    delete[] ring;
+#ifdef ARCH_PORTDUINO
+    if (spool)
+        fclose(spool);
+#endif
+}
+
+bool MQTTUplinkQueue::push(const char *channelId, const uint8_t *proto, size_t protoLen, const char *json, size_t jsonLen)
+{
+    Header h;
+    memset(&h, 0, sizeof(h));
+    h.queuedMsec = millis();
+    strncpy(h.channelId, channelId, sizeof(h.channelId) - 1);
+    h.protoLen = protoLen;
+    h.jsonLen = jsonLen;
+
+#ifdef ARCH_PORTDUINO
+    if (spool)
+        return spoolPush(h, proto, json);
+#endif
+
+    size_t needed = sizeof(h) + protoLen + jsonLen;
+    if (needed > MQTT_UPLINK_QUEUE_BYTES) {
+        stats.dropped++;
+        return false;
+    }
+
+    if (!ring)
+        ring = new uint8_t[MQTT_UPLINK_QUEUE_BYTES];
+
+    while (MQTT_UPLINK_QUEUE_BYTES - (head - tail) < needed) {
+        LOG_WARN("NOTE: MQTT queue is full, discarding oldest\n");
+        pop(false);
+    }
+
+    ringWrite(&h, sizeof(h));
+    ringWrite(proto, protoLen);
+    ringWrite(json, jsonLen);
+    count++;
+    stats.queued++;
+    return true;
+}
+
+bool MQTTUplinkQueue::front(Header &h, uint8_t *proto, size_t protoSize, char *json, size_t jsonSize)
+{
+    if (isEmpty())
+        return false;
+
+#ifdef ARCH_PORTDUINO
+    if (spool) {
+        if (fseek(spool, spoolReadPos, SEEK_SET) != 0 || fread(&h, sizeof(h), 1, spool) != 1 || h.protoLen > protoSize ||
+            h.jsonLen >= jsonSize || fread(proto, 1, h.protoLen, spool) != h.protoLen ||
+            fread(json, 1, h.jsonLen, spool) != h.jsonLen) {
+            LOG_ERROR("MQTT spool is corrupt, discarding it\n");
+            count = 0;
+            spoolReadPos = SPOOL_DATA_START;
+            ftruncate(fileno(spool), SPOOL_DATA_START);
+            spoolSaveReadPos();
+            return false;
+        }
+        json[h.jsonLen] = 0;
+        return true;
+    }
+#endif
+
+    ringRead(tail, &h, sizeof(h));
+    if (h.protoLen > protoSize || h.jsonLen >= jsonSize)
+        return false; // can't happen, our callers queue from buffers of the same size
+    ringRead(tail + sizeof(h), proto, h.protoLen);
+    ringRead(tail + sizeof(h) + h.protoLen, json, h.jsonLen);
+    json[h.jsonLen] = 0;
+    return true;
+}
+
+void MQTTUplinkQueue::pop(bool published)
+{
+    if (isEmpty())
+        return;
+
+    Header h;
+    bool restored = false;
+#ifdef ARCH_PORTDUINO
+    if (spool) {
+        fseek(spool, spoolReadPos, SEEK_SET);
+        if (fread(&h, sizeof(h), 1, spool) != 1)
+            memset(&h, 0, sizeof(h));
+        restored = spoolReadPos < spoolRestoredEnd;
+        spoolReadPos += sizeof(h) + h.protoLen + h.jsonLen;
+        if (--count == 0) {
+            // Everything has been sent, start the file over so it doesn't grow forever
+            spoolReadPos = SPOOL_DATA_START;
+            spoolRestoredEnd = 0;
+            ftruncate(fileno(spool), SPOOL_DATA_START);
+        }
+        spoolSaveReadPos();
+    } else
+#endif
+    {
+        ringRead(tail, &h, sizeof(h));
+        tail += sizeof(h) + h.protoLen + h.jsonLen;
+        count--;
+    }
+
+    if (!published) {
+        stats.dropped++;
+    } else {
+        stats.published++;
+        if (!restored) {
+            stats.lastLatencyMsec = millis() - h.queuedMsec;
+            if (stats.lastLatencyMsec > stats.maxLatencyMsec)
+                stats.maxLatencyMsec = stats.lastLatencyMsec;
+        }
+    }
+}
+
+void MQTTUplinkQueue::ringWrite(const void *data, size_t len)
+{
+    size_t offset = head % MQTT_UPLINK_QUEUE_BYTES;
+    size_t first = min(len, (size_t)MQTT_UPLINK_QUEUE_BYTES - offset);
+    memcpy(ring + offset, data, first);
+    memcpy(ring, (const uint8_t *)data + first, len - first);
+    head += len;
+}
+
+void MQTTUplinkQueue::ringRead(uint32_t offset, void *data, size_t len) const
+{
+    offset %= MQTT_UPLINK_QUEUE_BYTES;
+    size_t first = min(len, (size_t)MQTT_UPLINK_QUEUE_BYTES - offset);
+    memcpy(data, ring + offset, first);
+    memcpy((uint8_t *)data + first, ring, len - first);
+}
+
+#ifdef ARCH_PORTDUINO
+void MQTTUplinkQueue::openSpool(const char *path)
+{
+    FILE *f = fopen(path, "r+b");
+    if (!f)
+        f = fopen(path, "w+b");
+    if (!f) {
+        LOG_ERROR("Can't open MQTT spool %s, queueing in RAM instead\n", path);
+        return;
+    }
+
+    uint32_t magic = 0, readPos = 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < (long)SPOOL_DATA_START || fread(&magic, sizeof(magic), 1, f) != 1 || magic != SPOOL_MAGIC ||
+        fread(&readPos, sizeof(readPos), 1, f) != 1 || readPos < SPOOL_DATA_START || (long)readPos > size) {
+        // New (or unusable) spool, start it over
+        magic = SPOOL_MAGIC;
+        readPos = SPOOL_DATA_START;
+        ftruncate(fileno(f), 0);
+        fseek(f, 0, SEEK_SET);
+        fwrite(&magic, sizeof(magic), 1, f);
+        fwrite(&readPos, sizeof(readPos), 1, f);
+        fflush(f);
+        size = SPOOL_DATA_START;
+    }
+
+    // Count what the last run left for us, cutting off any message which was only partly written when we stopped
+    count = 0;
+    long pos = readPos;
+    Header h;
+    while (fseek(f, pos, SEEK_SET) == 0 && fread(&h, sizeof(h), 1, f) == 1 &&
+           pos + (long)(sizeof(h) + h.protoLen + h.jsonLen) <= size) {
+        pos += sizeof(h) + h.protoLen + h.jsonLen;
+        count++;
+    }
+    if (pos != size)
+        ftruncate(fileno(f), pos);
+
+    spool = f;
+    spoolReadPos = readPos;
+    spoolRestoredEnd = pos;
+    if (count)
+        LOG_INFO("MQTT spool %s holds %u messages from before we restarted\n", path, count);
+}
+
+bool MQTTUplinkQueue::spoolPush(const Header &h, const uint8_t *proto, const char *json)
+{
+    fseek(spool, 0, SEEK_END);
+    long size = ftell(spool);
+    if (size + (long)(sizeof(h) + h.protoLen + h.jsonLen) > MQTT_UPLINK_SPOOL_MAX_BYTES) {
+        LOG_WARN("NOTE: MQTT spool is full, discarding message\n");
+        stats.dropped++;
+        return false;
+    }
+
+    if (fwrite(&h, sizeof(h), 1, spool) != 1 || fwrite(proto, 1, h.protoLen, spool) != h.protoLen ||
+        fwrite(json, 1, h.jsonLen, spool) != h.jsonLen || fflush(spool) != 0) {
+        LOG_ERROR("Can't write MQTT spool, discarding message\n");
+        ftruncate(fileno(spool), size);
+        stats.dropped++;
+        return false;
+    }
+
+    count++;
+    stats.queued++;
+    return true;
+}
+
+void MQTTUplinkQueue::spoolSaveReadPos()
+{
+    uint32_t readPos = spoolReadPos;
+    fseek(spool, sizeof(uint32_t), SEEK_SET);
+    fwrite(&readPos, sizeof(readPos), 1, spool);
+    fflush(spool);
+}
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "configuration.h"
+#include <stddef.h>
+#include <stdint.h>
+#ifdef ARCH_PORTDUINO
+#include <stdio.h>
+#endif
+
+// How many bytes of encoded messages we hold in RAM while the broker can't take them, beyond that the oldest are dropped
+#ifndef MQTT_UPLINK_QUEUE_BYTES
+#ifdef ARCH_PORTDUINO
+#define MQTT_UPLINK_QUEUE_BYTES (64 * 1024)
+#else
+#define MQTT_UPLINK_QUEUE_BYTES (8 * 1024)
+#endif
+#endif
+
+// The most a spool file may grow to, beyond that new messages are dropped
+#define MQTT_UPLINK_SPOOL_MAX_BYTES (16 * 1024 * 1024)
+
+/// Counters for the uplink queue, for logging and metrics
+struct MQTTUplinkStats {
+    uint32_t queued = 0;    // messages which had to wait in the queue
+    uint32_t published = 0; // messages published from the queue
+    uint32_t dropped = 0;   // messages lost because the queue was full (or the broker refused them)
+    uint32_t lastLatencyMsec = 0; // how long the last message published from the queue had waited
+    uint32_t maxLatencyMsec = 0;
+};
+
+/**
+ * Messages waiting to be published to the MQTT broker.
+ *
+ * Messages are encoded when they are queued (the ServiceEnvelope protobuf, and the JSON version if enabled), so nothing in
+ * the queue points at packets which may since have gone back to their pool, and draining the queue is only a matter of
+ * copying bytes to the broker.  Messages live in a byte ring in RAM, or on portduino optionally in a spool file, which survives
+ * restarts.
+ */
+class MQTTUplinkQueue
+{
+  public:
+    struct Header {
+        uint32_t queuedMsec; // millis() when this message was queued
+        char channelId[12];  // same size as meshtastic_ChannelSettings.name
+        uint16_t protoLen;
+        uint16_t jsonLen;
+    };
+
+    MQTTUplinkStats stats;
+
+    ~MQTTUplinkQueue();
+
+#ifdef ARCH_PORTDUINO
+    /// Keep the queue in this file rather than in RAM, picking up whatever a previous run left there
+    void openSpool(const char *path);
+#endif
+
+    /// Queue a message, dropping the oldest ones if we run out of room.  @return false if the message was dropped instead
+    bool push(const char *channelId, const uint8_t *proto, size_t protoLen, const char *json, size_t jsonLen);
+
+    /// Copy out the oldest message without removing it, json is null terminated
+    bool front(Header &h, uint8_t *proto, size_t protoSize, char *json, size_t jsonSize);
+
+    /// Remove the oldest message.  @param published false if it is being dropped rather than published
+    void pop(bool published);
+
+    uint32_t depth() const { return count; }
+    bool isEmpty() const { return count == 0; }
+
+  private:
+    uint8_t *ring = NULL; // allocated the first time we need it
+    uint32_t head = 0, tail = 0; // byte offsets (modulo MQTT_UPLINK_QUEUE_BYTES) of the next free byte and the oldest message
+    uint32_t count = 0;
+
+    void ringWrite(const void *data, size_t len);
+    void ringRead(uint32_t offset, void *data, size_t len) const;
+
+#ifdef ARCH_PORTDUINO
+    FILE *spool = NULL;
+    long spoolReadPos = 0; // where the oldest message in the spool starts
+    long spoolRestoredEnd = 0; // messages before this offset were queued by an earlier run, so their latency is meaningless
+
+    bool spoolPush(const Header &h, const uint8_t *proto, const char *json);
+    void spoolSaveReadPos();
+#endif
+};
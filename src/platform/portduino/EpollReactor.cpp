@@ -0,0 +1,83 @@
+#include "EpollReactor.h"
+
+#if HAS_EPOLL_REACTOR
+#include "concurrency/OSThread.h"
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+// How many ready fds we handle per wakeup, any others are simply reported again on the next wait()
+#define MAX_REACTOR_EVENTS 16
+
+EpollReactor epollReactor;
+
+EpollReactor::EpollReactor()
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd >= 0 && wakeFd >= 0) {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL; // a NULL thread marks our own wakeFd
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    }
+}
+
+EpollReactor::~EpollReactor()
+{
+    if (wakeFd >= 0)
+        close(wakeFd);
+    if (epollFd >= 0)
+        close(epollFd);
+}
+
+bool EpollReactor::watch(int fd, uint32_t events, concurrency::OSThread *thread)
+{
+    if (epollFd < 0 || fd < 0)
+        return false;
+
+    struct epoll_event ev = {};
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = thread;
+    // Rearm if we already know this fd, otherwise add it
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == 0)
+        return true;
+    return errno == ENOENT && epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+void EpollReactor::unwatch(int fd)
+{
+    if (epollFd >= 0 && fd >= 0)
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+bool EpollReactor::wait(uint32_t msec)
+{
+    if (epollFd < 0) {
+        delay(msec);
+        return false;
+    }
+
+    struct epoll_event events[MAX_REACTOR_EVENTS];
+    int n = epoll_wait(epollFd, events, MAX_REACTOR_EVENTS, msec > INT32_MAX ? -1 : (int)msec);
+    for (int i = 0; i < n; i++) {
+        auto thread = (concurrency::OSThread *)events[i].data.ptr;
+        if (thread) {
+            thread->setInterval(0); // run it on this pass through the main loop
+        } else {
+            uint64_t count;
+            read(wakeFd, &count, sizeof(count)); // reset the eventfd
+        }
+    }
+    return n > 0;
+}
+
+void EpollReactor::interrupt()
+{
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        write(wakeFd, &one, sizeof(one));
+    }
+}
+
+#endif
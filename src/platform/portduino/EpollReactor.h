@@ -0,0 +1,48 @@
+#pragma once
+
+#include "configuration.h"
+
+#if HAS_EPOLL_REACTOR
+#include <stdint.h>
+#include <sys/epoll.h>
+
+namespace concurrency
+{
+class OSThread;
+}
+
+/**
+ * A tiny epoll based reactor for portduino.
+ *
+ * mainDelay sleeps in wait() instead of a plain delay(), so rather than polling their sockets every few msec from runOnce(),
+ * threads can ask to be run as soon as a socket becomes readable or writable.  interrupt() is safe to call from other
+ * (real) threads, such as the ulfius web server callbacks.
+ */
+class EpollReactor
+{
+    int epollFd = -1;
+    int wakeFd = -1; // eventfd poked by interrupt()
+
+  public:
+    EpollReactor();
+    ~EpollReactor();
+
+    /**
+     * Run thread as soon as fd has any of the requested events (EPOLLIN/EPOLLOUT).  Watches are one-shot, so the thread
+     * should call watch() again once it has drained the socket.
+     * @return false if the fd could not be watched, in which case the caller should keep polling
+     */
+    bool watch(int fd, uint32_t events, concurrency::OSThread *thread);
+
+    /// Stop watching fd, must be called before the thread is deleted
+    void unwatch(int fd);
+
+    /// Sleep for up to msec.  @return true if we were woken early by a watched fd or interrupt()
+    bool wait(uint32_t msec);
+
+    void interrupt();
+};
+
+extern EpollReactor epollReactor;
+
+#endif
@@ -96,6 +96,12 @@ void portduinoSetup()
     settingsStrings[webserverrootpath] = "";
     settingsStrings[spidev] = "";
     settingsStrings[displayspidev] = "";
+    settingsStrings[localapisocket] = "";
+    settingsStrings[localapishm] = "";
+    settingsMap[localapigroup] = -1;
+    settingsStrings[mqttspoolfile] = "";
+    settingsStrings[sfhistoryfile] = "";
+    settingsMap[sfhistoryrecords] = 10000;
 
     YAML::Node yamlConfig;
 
@@ -275,6 +281,21 @@ void portduinoSetup()
             settingsStrings[webserverrootpath] = (yamlConfig["Webserver"]["RootPath"]).as<std::string>("");
         }
 
+        if (yamlConfig["LocalAPI"]) {
+            settingsStrings[localapisocket] = (yamlConfig["LocalAPI"]["SocketPath"]).as<std::string>("");
+            settingsMap[localapigroup] = (yamlConfig["LocalAPI"]["Group"]).as<int>(-1);
+            settingsStrings[localapishm] = (yamlConfig["LocalAPI"]["SharedMemory"]).as<std::string>("");
+        }
+
+        if (yamlConfig["MQTT"]) {
+            settingsStrings[mqttspoolfile] = (yamlConfig["MQTT"]["SpoolFile"]).as<std::string>("");
+        }
+
+        if (yamlConfig["StoreForward"]) {
+            settingsStrings[sfhistoryfile] = (yamlConfig["StoreForward"]["HistoryFile"]).as<std::string>("");
+            settingsMap[sfhistoryrecords] = (yamlConfig["StoreForward"]["HistoryRecords"]).as<int>(10000);
+        }
+
         settingsMap[maxnodes] = (yamlConfig["General"]["MaxNodes"]).as<int>(200);
 
     } catch (YAML::Exception &e) {
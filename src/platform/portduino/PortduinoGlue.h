@@ -49,6 +49,12 @@ enum configNames {
     webserver,
     webserverport,
     webserverrootpath,
+    localapisocket,
+    localapigroup,
+    localapishm,
+    mqttspoolfile,
+    sfhistoryfile,
+    sfhistoryrecords,
     maxnodes
 };
 enum { no_screen, x11, st7789, st7735, st7735s, st7796, ili9341, ili9488, hx8357d };
@@ -0,0 +1,73 @@
+#include "SharedPacketRing.h"
+
+#if HAS_UNIX_SOCKET_API
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SharedPacketRing *sharedPacketRing;
+
+SharedPacketRing::~SharedPacketRing()
+{
+    if (header) {
+        munmap(header, mapSize);
+        shm_unlink(name);
+    }
+}
+
+bool SharedPacketRing::init(int allowedGid)
+{
+    mapSize = sizeof(SharedPacketRingHeader) + SHARED_PACKET_RING_SLOTS * sizeof(SharedPacketRingSlot);
+
+    shm_unlink(name); // Start from scratch, a stale segment might have a different layout
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, allowedGid >= 0 ? 0640 : 0600);
+    if (fd < 0) {
+        LOG_ERROR("Could not create shared packet ring %s: %s\n", name, strerror(errno));
+        return false;
+    }
+    if (allowedGid >= 0 && fchown(fd, -1, allowedGid) != 0)
+        LOG_WARN("Could not give group %d access to shared packet ring: %s\n", allowedGid, strerror(errno));
+
+    void *mem = MAP_FAILED;
+    if (ftruncate(fd, mapSize) == 0)
+        mem = mmap(NULL, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        LOG_ERROR("Could not map shared packet ring %s: %s\n", name, strerror(errno));
+        shm_unlink(name);
+        return false;
+    }
+
+    // ftruncate gave us zeroed memory, so every slot starts out with seq 0 (empty)
+    header = (SharedPacketRingHeader *)mem;
+    slots = (SharedPacketRingSlot *)(header + 1);
+    header->version = SHARED_PACKET_RING_VERSION;
+    header->slotSize = sizeof(SharedPacketRingSlot);
+    header->numSlots = SHARED_PACKET_RING_SLOTS;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHARED_PACKET_RING_MAGIC; // last, so readers never see a half initialized header
+
+    LOG_INFO("Publishing packets to shared memory ring %s (%u bytes)\n", name, (uint32_t)mapSize);
+    return true;
+}
+
+void SharedPacketRing::publish(const meshtastic_MeshPacket &p)
+{
+    if (!header)
+        return;
+
+    uint32_t seq = header->writeSeq.load(std::memory_order_relaxed);
+    SharedPacketRingSlot &slot = slots[seq % SHARED_PACKET_RING_SLOTS];
+
+    // Mark the slot as busy before touching the packet, so readers can tell their copy might be torn
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.packet, &p, sizeof(p));
+    slot.seq.store(seq + 1, std::memory_order_release);
+    header->writeSeq.store(seq + 1, std::memory_order_release);
+}
+
+#endif
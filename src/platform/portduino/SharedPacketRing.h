@@ -0,0 +1,60 @@
+#pragma once
+
+#include "configuration.h"
+
+#if HAS_UNIX_SOCKET_API
+#include "mesh-pb-constants.h"
+#include <atomic>
+#include <stdint.h>
+
+#define SHARED_PACKET_RING_MAGIC 0x4d505254 // "MPRT"
+#define SHARED_PACKET_RING_VERSION 1
+#define SHARED_PACKET_RING_SLOTS 256
+
+/**
+ * Layout of our shared memory packet ring.  The segment is a SharedPacketRingHeader followed by numSlots SharedPacketRingSlots.
+ *
+ * Packets are stored as raw nanopb meshtastic_MeshPacket structs (which contain no pointers), so readers built against the
+ * same protobufs can use them without decoding.  Readers should check magic, version and slotSize first.
+ *
+ * To read packet n (counting from 0): wait for writeSeq > n, copy slots[n % numSlots] and accept the copy only if the slot's
+ * seq was n + 1 both before and after copying (otherwise the writer lapped us and the packet is gone).
+ */
+struct SharedPacketRingSlot {
+    std::atomic<uint32_t> seq; // packet number + 1, or 0 while the slot is being written
+    meshtastic_MeshPacket packet;
+};
+
+struct SharedPacketRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotSize;
+    uint32_t numSlots;
+    std::atomic<uint32_t> writeSeq; // the number of packets written so far
+};
+
+/**
+ * Publishes every packet destined for the phone into a POSIX shared memory ring, so that local consumers (loggers, bridges)
+ * can get them without a protobuf encode and socket copy per packet.  There is a single writer (us) and any number of readers,
+ * a reader which falls behind simply misses packets, it can never slow us down.
+ */
+class SharedPacketRing
+{
+    const char *name;
+    SharedPacketRingHeader *header = NULL;
+    SharedPacketRingSlot *slots = NULL;
+    size_t mapSize = 0;
+
+  public:
+    explicit SharedPacketRing(const char *_name) : name(_name) {}
+    ~SharedPacketRing();
+
+    /// Create and map our shared memory segment, readable by the given group (or only by our own user if allowedGid < 0)
+    bool init(int allowedGid);
+
+    void publish(const meshtastic_MeshPacket &p);
+};
+
+extern SharedPacketRing *sharedPacketRing;
+
+#endif
@@ -0,0 +1,243 @@
+#include "UnixSocketAPI.h"
+
+#if HAS_UNIX_SOCKET_API
+#include "PortduinoGlue.h"
+#include "SharedPacketRing.h"
+#include <errno.h>
+#include <grp.h>
+#include <pwd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// If a local client falls this far behind reading we give up on it
+#define UNIX_CLIENT_MAX_PENDING_TX (16 * 1024)
+
+// getgrouplist() gives up on users in more groups than this
+#define UNIX_CLIENT_MAX_GROUPS 64
+
+static UnixServerPort *localApiPort;
+
+/// @return true if the process with the credentials cred is in group gid, as its primary group or a supplementary one
+static bool peerInGroup(const struct ucred &cred, gid_t gid)
+{
+    if (cred.gid == gid)
+        return true;
+
+    // The groups the process actually has, which may differ from its user's if it changed them
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/status", (int)cred.pid);
+    FILE *f = fopen(path, "r");
+    if (f) {
+        char line[512];
+        bool found = false;
+        while (!found && fgets(line, sizeof(line), f)) {
+            if (strncmp(line, "Groups:", 7) != 0)
+                continue;
+            char *end;
+            for (char *pos = line + 7;; pos = end) {
+                unsigned long g = strtoul(pos, &end, 10);
+                if (end == pos)
+                    break;
+                if (g == gid) {
+                    found = true;
+                    break;
+                }
+            }
+            break;
+        }
+        fclose(f);
+        return found;
+    }
+
+    // No /proc, so go by the groups its user is in
+    struct passwd pw, *result = NULL;
+    char buf[1024];
+    if (getpwuid_r(cred.uid, &pw, buf, sizeof(buf), &result) != 0 || !result)
+        return false;
+    gid_t groups[UNIX_CLIENT_MAX_GROUPS];
+    int n = UNIX_CLIENT_MAX_GROUPS;
+    if (getgrouplist(pw.pw_name, pw.pw_gid, groups, &n) < 0)
+        return false;
+    for (int i = 0; i < n; i++)
+        if (groups[i] == gid)
+            return true;
+    return false;
+}
+
+bool UnixClient::fillRxBuf()
+{
+    if (rxHead < rxLen)
+        return true;
+    if (sock < 0)
+        return false;
+
+    ssize_t n = recv(sock, rxBuf, sizeof(rxBuf), MSG_DONTWAIT);
+    if (n <= 0)
+        return false;
+    rxHead = 0;
+    rxLen = n;
+    return true;
+}
+
+bool UnixClient::connected()
+{
+    if (sock < 0 || !flushTx())
+        return false;
+    if (rxHead < rxLen)
+        return true;
+
+    // A zero length peek means the other side hung up
+    uint8_t c;
+    ssize_t n = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR));
+}
+
+void UnixClient::stop()
+{
+    if (sock >= 0) {
+        close(sock);
+        sock = -1;
+    }
+    rxHead = rxLen = 0;
+    txPending.clear();
+}
+
+int UnixClient::available()
+{
+    int queued = 0;
+    if (sock >= 0 && ioctl(sock, FIONREAD, &queued) != 0)
+        queued = 0;
+    return (rxLen - rxHead) + queued;
+}
+
+int UnixClient::read()
+{
+    return fillRxBuf() ? rxBuf[rxHead++] : -1;
+}
+
+int UnixClient::peek()
+{
+    return fillRxBuf() ? rxBuf[rxHead] : -1;
+}
+
+bool UnixClient::flushTx()
+{
+    size_t sent = 0;
+    while (sock >= 0 && sent < txPending.size()) {
+        ssize_t n = send(sock, txPending.data() + sent, txPending.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break; // the socket is full, try again next time
+        if (n <= 0) {
+            LOG_WARN("Local API client went away: %s\n", strerror(errno));
+            stop();
+            return false;
+        }
+        sent += n;
+    }
+    txPending.erase(txPending.begin(), txPending.begin() + sent);
+    return sock >= 0;
+}
+
+size_t UnixClient::write(const uint8_t *buf, size_t size)
+{
+    // Keep the framing intact: whatever the socket doesn't take now is queued behind what it didn't take before
+    if (!flushTx())
+        return 0;
+    if (txPending.size() + size > UNIX_CLIENT_MAX_PENDING_TX) {
+        LOG_WARN("Local API client is not reading, disconnecting\n");
+        stop();
+        return 0;
+    }
+    txPending.insert(txPending.end(), buf, buf + size);
+    flushTx();
+    return size;
+}
+
+UnixServer::~UnixServer()
+{
+    if (listenSock >= 0) {
+        close(listenSock);
+        unlink(path);
+    }
+}
+
+void UnixServer::begin()
+{
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Local API socket path %s is too long\n", path);
+        return;
+    }
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    listenSock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path); // remove any stale socket left by a previous run
+    if (listenSock < 0 || bind(listenSock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenSock, 4) != 0) {
+        LOG_ERROR("Could not listen on local API socket %s: %s\n", path, strerror(errno));
+        if (listenSock >= 0)
+            close(listenSock);
+        listenSock = -1;
+        return;
+    }
+
+    // The socket permissions are a first line of defense, SO_PEERCRED in available() is the real check
+    chmod(path, allowedGid >= 0 ? 0660 : 0600);
+    if (allowedGid >= 0 && chown(path, -1, allowedGid) != 0)
+        LOG_WARN("Could not give group %d access to %s: %s\n", allowedGid, path, strerror(errno));
+}
+
+UnixClient UnixServer::available()
+{
+    while (listenSock >= 0) {
+        int sock = accept4(listenSock, NULL, NULL, SOCK_CLOEXEC);
+        if (sock < 0)
+            break; // no more pending connections
+
+        struct ucred cred = {};
+        socklen_t len = sizeof(cred);
+        if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 ||
+            !(cred.uid == 0 || cred.uid == getuid() || (allowedGid >= 0 && peerInGroup(cred, (gid_t)allowedGid)))) {
+            LOG_WARN("Rejecting local API connection from pid %d uid %d gid %d\n", cred.pid, cred.uid, cred.gid);
+            close(sock);
+            continue;
+        }
+
+        LOG_INFO("Local API connection from pid %d uid %d\n", cred.pid, cred.uid);
+        return UnixClient(sock);
+    }
+    return UnixClient();
+}
+
+UnixServerAPI::UnixServerAPI(UnixClient &_client) : ServerAPI(_client) {}
+
+UnixServerPort::UnixServerPort(const char *path, int allowedGid) : APIServerPort(path, allowedGid) {}
+
+void initLocalApi()
+{
+    int allowedGid = settingsMap[localapigroup];
+
+    if (!settingsStrings[localapisocket].empty() && !localApiPort) {
+        localApiPort = new UnixServerPort(settingsStrings[localapisocket].c_str(), allowedGid);
+        LOG_INFO("API server listening on local socket %s\n", settingsStrings[localapisocket].c_str());
+        localApiPort->init();
+    }
+
+    if (!settingsStrings[localapishm].empty() && !sharedPacketRing) {
+        sharedPacketRing = new SharedPacketRing(settingsStrings[localapishm].c_str());
+        if (!sharedPacketRing->init(allowedGid)) {
+            delete sharedPacketRing;
+            sharedPacketRing = NULL;
+        }
+    }
+}
+
+#endif
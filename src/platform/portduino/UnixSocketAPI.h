@@ -0,0 +1,88 @@
+#pragma once
+
+#include "configuration.h"
+
+#if HAS_UNIX_SOCKET_API
+#include "mesh/api/ServerAPI.h"
+#include <Stream.h>
+#include <vector>
+
+/**
+ * One connection to our local Unix domain socket, looks like a WiFiClient to ServerAPI.
+ *
+ * Copies share the same socket (like WiFiClient), so the socket is only closed by stop(), never by the destructor.
+ */
+class UnixClient : public Stream
+{
+    int sock = -1;
+
+    /// We pull bytes from the socket in chunks, so that Stream's byte at a time reads don't each cost a syscall
+    uint8_t rxBuf[256];
+    size_t rxHead = 0, rxLen = 0;
+
+    /// Make sure rxBuf has something in it, returns false if the socket has nothing for us right now
+    bool fillRxBuf();
+
+    /// What the socket wouldn't take yet, we never block the main loop waiting for a slow client
+    std::vector<uint8_t> txPending;
+
+    /// Send as much of txPending as the socket takes now.  @return false if the client went away
+    bool flushTx();
+
+  public:
+    UnixClient() {}
+    explicit UnixClient(int _sock) : sock(_sock) {}
+
+    int fd() const { return sock; }
+
+    /// Also sends on whatever an earlier write() couldn't, as ServerAPI asks this every time it runs
+    bool connected();
+
+    void stop();
+
+    explicit operator bool() const { return sock >= 0; }
+
+    virtual int available() override;
+    virtual int read() override;
+    virtual int peek() override;
+    virtual size_t write(uint8_t c) override { return write(&c, 1); }
+    virtual size_t write(const uint8_t *buf, size_t size) override;
+    virtual void flush() override {}
+};
+
+/**
+ * Listens on our Unix domain socket.  Only lets in clients running as root, as our own user, or with the configured group
+ * (checked with SO_PEERCRED), everyone else is disconnected right away.
+ */
+class UnixServer
+{
+    const char *path;
+    int listenSock = -1;
+    int allowedGid;
+
+  public:
+    UnixServer(const char *_path, int _allowedGid) : path(_path), allowedGid(_allowedGid) {}
+    ~UnixServer();
+
+    void begin();
+
+    /// @return the next authorized incoming connection, or a UnixClient which is false if there is none
+    UnixClient available();
+};
+
+class UnixServerAPI : public ServerAPI<UnixClient>
+{
+  public:
+    explicit UnixServerAPI(UnixClient &_client);
+};
+
+class UnixServerPort : public APIServerPort<UnixServerAPI, UnixServer>
+{
+  public:
+    UnixServerPort(const char *path, int allowedGid);
+};
+
+/// Start the local API (Unix domain socket and shared memory packet ring) if it is configured
+void initLocalApi();
+
+#endif
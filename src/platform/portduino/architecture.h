@@ -16,4 +16,14 @@
 #endif
 #ifndef HAS_TELEMETRY
 #define HAS_TELEMETRY 1
+#endif
+#ifndef HAS_EPOLL_REACTOR
+#ifdef __linux__
+#define HAS_EPOLL_REACTOR 1
+#endif
+#endif
+#ifndef HAS_UNIX_SOCKET_API
+#ifdef __linux__
+#define HAS_UNIX_SOCKET_API 1
+#endif
 #endif
\ No newline at end of file